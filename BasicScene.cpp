@@ -0,0 +1,15 @@
+#include "BasicScene.h"
+
+/*
+ * The makefile compiles this file with -mgeneral-regs-only on x86-64 and
+ * AArch64, which leaves the compiler no register to hold a float in:
+ * anything below that used floating point would fail to build.
+ */
+template class BasicScene<Fixed16>;
+template std::ostream& operator<<(std::ostream& out, const BasicScene<Fixed16>& s);
+
+#if (defined(__x86_64__) && !defined(__SSE__)) || (defined(__aarch64__) && !defined(__ARM_FP))
+const bool FIXED_SCENE_INTEGER_ONLY = true;
+#else
+const bool FIXED_SCENE_INTEGER_ONLY = false;
+#endif
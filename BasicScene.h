@@ -0,0 +1,312 @@
+#ifndef BASICSCENE_H_
+#define BASICSCENE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+#include "BoundingBox.h"
+#include "Raster.h"
+#include "Scalar.h"
+#include "ShapeValue.h"
+
+/*
+ * A scene of shapes held by value in co-ordinates of type T: shapes are
+ * added, tested against points and drawn as Scene draws them, with none
+ * of Scene's shared shapes, compositing, threads or kept frames. Every
+ * step is done in T and int, so a FixedScene never touches floating
+ * point: its code is compiled once, in BasicScene.cpp, where the makefile
+ * turns the floating point registers off so that any float in it fails
+ * the build. Scene stays the float scene with everything else.
+ *
+ * Shapes are bucketed into a grid of INDEX_CELL square cells over the
+ * drawing area, the edge cells also holding whatever lies beyond that
+ * edge, so a point query only tests the shapes of one cell.
+ */
+template <class T>
+class BasicScene {
+
+    public:
+        // Constructor for a width * height drawing area.
+        // If either is zero or negative, throw a std::invalid_argument exception.
+        BasicScene(int width, int height);
+
+        // Add a shape and return its slot, which stays valid for the life
+        // of the scene
+        int add(const BasicShapeValue<T>& v);
+
+        // Add the n shapes of shapes in order, as add() would one at a
+        // time, and return the slot of the first
+        int add(const BasicShapeValue<T>* shapes, size_t n);
+
+        // As above, for the whole of the array shapes
+        template <size_t N>
+        int add(const BasicShapeValue<T> (&shapes)[N]);
+
+        // Return the number of shapes in the scene
+        int size() const;
+
+        // Return the shape in slot.
+        // If slot is out of range, throw a std::out_of_range exception.
+        const BasicShapeValue<T>& value(int slot) const;
+
+        // Replace the shape in slot with v.
+        // If slot is out of range, throw a std::out_of_range exception.
+        void setValue(int slot, const BasicShapeValue<T>& v);
+
+        // Set the drawing depth to d: only shapes of depth at most d are
+        // drawn, or every shape if d is 0
+        void setDrawDepth(int d);
+
+        // Append to slots the slot of every shape containing (x, y),
+        // whatever its depth and in no particular order
+        void querySlots(T x, T y, std::vector<int>& slots) const;
+
+        // Return true if any shape contains (x, y), whatever its depth
+        bool contains(T x, T y) const;
+
+        // Clear page and mark the cells of every shape drawn at the drawing
+        // depth. Cells of page are the cells of the scene with the same
+        // co-ordinates; any outside the drawing area stay blank.
+        void render(FrameBuffer& page) const;
+
+        // As above, setting the cells of canvas
+        void render(BitCanvas& canvas) const;
+
+        // Return the number of columns of the drawing area
+        int width() const;
+
+        // Return the number of rows of the drawing area
+        int height() const;
+
+        // Side of the grid cells shapes are bucketed into
+        static constexpr int INDEX_CELL = 8;
+
+    private:
+        // Return the column or row of the grid cell holding co-ordinate v,
+        // out of n
+        static int cell_(T v, int n);
+
+        // Return the grid cells the bounds of v overlap
+        CellRect cells_(const BasicShapeValue<T>& v) const;
+
+        // Draw every shape at the drawing depth on target
+        template <class Target>
+        void draw_(Target& target) const;
+
+        // Size of the drawing area
+        int width_;
+        int height_;
+
+        // Depth of the drawing
+        int sceneDepth_;
+
+        // Shapes, by slot
+        std::vector<BasicShapeValue<T>> values_;
+
+        // Size of the grid, in cells
+        int columns_;
+        int rows_;
+
+        // Slots of the shapes overlapping each grid cell, row by row
+        std::vector<std::vector<int>> grid_;
+};
+
+// Scene in fixed point, using integers only
+using FixedScene = BasicScene<Fixed16>;
+
+// Write the drawing area as operator<< writes a Scene
+template <class T>
+std::ostream& operator<<(std::ostream& out, const BasicScene<T>& s);
+
+// True if BasicScene.cpp was compiled with no floating point registers to
+// use, as the makefile does where the compiler allows it
+extern const bool FIXED_SCENE_INTEGER_ONLY;
+
+// ============== BasicScene class ================
+
+/*
+ * Members are not inline, so that the explicit instantiations are the
+ * code every caller runs: FixedScene in BasicScene.cpp, float and double
+ * in BasicSceneFloat.cpp.
+ */
+
+template <class T>
+constexpr int BasicScene<T>::INDEX_CELL;
+
+template <class T>
+BasicScene<T>::BasicScene(int width, int height) : width_(width), height_(height),
+    sceneDepth_(0), columns_(0), rows_(0) {
+
+    if (width <= 0 || height <= 0) {
+        throw std::invalid_argument("zero or negative drawing area.");
+    }
+    columns_ = (width + INDEX_CELL - 1) / INDEX_CELL;
+    rows_ = (height + INDEX_CELL - 1) / INDEX_CELL;
+    grid_.resize(static_cast<size_t>(columns_) * rows_);
+}
+
+template <class T>
+int BasicScene<T>::add(const BasicShapeValue<T>& v) {
+    int slot = size();
+    values_.push_back(v);
+    CellRect r = cells_(v);
+    for (int row = r.y0; row <= r.y1; row++) {
+        for (int column = r.x0; column <= r.x1; column++) {
+            grid_[static_cast<size_t>(row) * columns_ + column].push_back(slot);
+        }
+    }
+    return slot;
+}
+
+template <class T>
+int BasicScene<T>::add(const BasicShapeValue<T>* shapes, size_t n) {
+    int first = size();
+    values_.reserve(values_.size() + n);
+    for (size_t i = 0; i < n; i++) {
+        add(shapes[i]);
+    }
+    return first;
+}
+
+template <class T>
+template <size_t N>
+int BasicScene<T>::add(const BasicShapeValue<T> (&shapes)[N]) {
+    return add(shapes, N);
+}
+
+template <class T>
+int BasicScene<T>::size() const {
+    return static_cast<int>(values_.size());
+}
+
+template <class T>
+const BasicShapeValue<T>& BasicScene<T>::value(int slot) const {
+    if (slot < 0 || slot >= size()) {
+        throw std::out_of_range("no shape in slot.");
+    }
+    return values_[slot];
+}
+
+template <class T>
+void BasicScene<T>::setValue(int slot, const BasicShapeValue<T>& v) {
+
+    if (slot < 0 || slot >= size()) {
+        throw std::out_of_range("no shape in slot.");
+    }
+    CellRect r = cells_(values_[slot]);
+    for (int row = r.y0; row <= r.y1; row++) {
+        for (int column = r.x0; column <= r.x1; column++) {
+            std::vector<int>& cell = grid_[static_cast<size_t>(row) * columns_ + column];
+            cell.erase(std::find(cell.begin(), cell.end(), slot));
+        }
+    }
+    values_[slot] = v;
+    r = cells_(v);
+    for (int row = r.y0; row <= r.y1; row++) {
+        for (int column = r.x0; column <= r.x1; column++) {
+            grid_[static_cast<size_t>(row) * columns_ + column].push_back(slot);
+        }
+    }
+    return;
+}
+
+template <class T>
+void BasicScene<T>::setDrawDepth(int d) {
+    sceneDepth_ = d;
+    return;
+}
+
+template <class T>
+void BasicScene<T>::querySlots(T x, T y, std::vector<int>& slots) const {
+    const std::vector<int>& cell = grid_[static_cast<size_t>(cell_(y, rows_)) * columns_ + cell_(x, columns_)];
+    for (int slot : cell) {
+        if (values_[slot].contains(x, y)) {
+            slots.push_back(slot);
+        }
+    }
+    return;
+}
+
+template <class T>
+bool BasicScene<T>::contains(T x, T y) const {
+    const std::vector<int>& cell = grid_[static_cast<size_t>(cell_(y, rows_)) * columns_ + cell_(x, columns_)];
+    for (int slot : cell) {
+        if (values_[slot].contains(x, y)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <class T>
+void BasicScene<T>::render(FrameBuffer& page) const {
+    page.clear();
+    draw_(page);
+    return;
+}
+
+template <class T>
+void BasicScene<T>::render(BitCanvas& canvas) const {
+    canvas.clear();
+    draw_(canvas);
+    return;
+}
+
+template <class T>
+int BasicScene<T>::width() const {
+    return width_;
+}
+
+template <class T>
+int BasicScene<T>::height() const {
+    return height_;
+}
+
+template <class T>
+int BasicScene<T>::cell_(T v, int n) {
+    /* Clamped, so the edge cells take everything beyond their edge */
+    int c = scalar::floorInt(v);
+    return (c < 0) ? 0 : std::min(c / INDEX_CELL, n - 1);
+}
+
+template <class T>
+CellRect BasicScene<T>::cells_(const BasicShapeValue<T>& v) const {
+    BasicBoundingBox<T> b = v.bounds();
+    return CellRect { cell_(b.xMin, columns_), cell_(b.yMin, rows_), cell_(b.xMax, columns_),
+        cell_(b.yMax, rows_) };
+}
+
+template <class T>
+template <class Target>
+void BasicScene<T>::draw_(Target& target) const {
+    target.setClip(CellRect { 0, 0, width_ - 1, height_ - 1 });
+    for (const BasicShapeValue<T>& v : values_) {
+        if (sceneDepth_ == 0 || v.depth() <= sceneDepth_) {
+            v.draw(target);
+        }
+    }
+    target.resetClip();
+    return;
+}
+
+template <class T>
+std::ostream& operator<<(std::ostream& out, const BasicScene<T>& s) {
+    FrameBuffer page(s.width(), s.height());
+    s.render(page);
+    page.write(out);
+    return out;
+}
+
+// FixedScene is compiled in BasicScene.cpp only
+extern template class BasicScene<Fixed16>;
+extern template std::ostream& operator<<(std::ostream& out, const BasicScene<Fixed16>& s);
+
+// Float and double scenes are compiled in BasicSceneFloat.cpp
+extern template class BasicScene<float>;
+extern template std::ostream& operator<<(std::ostream& out, const BasicScene<float>& s);
+extern template class BasicScene<double>;
+extern template std::ostream& operator<<(std::ostream& out, const BasicScene<double>& s);
+
+#endif /* BASICSCENE_H_ */
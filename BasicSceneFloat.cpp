@@ -0,0 +1,10 @@
+#include "BasicScene.h"
+
+/*
+ * The floating point scenes, apart from BasicScene.cpp so that it can be
+ * compiled without floating point registers
+ */
+template class BasicScene<float>;
+template std::ostream& operator<<(std::ostream& out, const BasicScene<float>& s);
+template class BasicScene<double>;
+template std::ostream& operator<<(std::ostream& out, const BasicScene<double>& s);
@@ -0,0 +1,53 @@
+#ifndef BOUNDINGBOX_H_
+#define BOUNDINGBOX_H_
+
+#include "Scalar.h"
+
+/*
+ * Axis-aligned bounds of a shape in scene co-ordinates of type T: float,
+ * double or Fixed16. Both edges are inclusive, so a Point has
+ * xMin == xMax and yMin == yMax.
+ */
+template <class T>
+struct BasicBoundingBox {
+    T xMin;
+    T yMin;
+    T xMax;
+    T yMax;
+
+    // Return true if (x, y) lies inside the box, edges included
+    constexpr bool contains(T x, T y) const {
+        return xMin <= x && x <= xMax && yMin <= y && y <= yMax;
+    }
+
+    // Return true if the two boxes share at least one point
+    constexpr bool intersects(const BasicBoundingBox& b) const {
+        return xMin <= b.xMax && b.xMin <= xMax &&
+            yMin <= b.yMax && b.yMin <= yMax;
+    }
+
+    // Return the distance from (x, y) to the nearest point of the box, or
+    // zero if the box contains it
+    T distance(T x, T y) const {
+        T xDiff = (x < xMin) ? xMin - x : (x > xMax) ? x - xMax : T(0);
+        T yDiff = (y < yMin) ? yMin - y : (y > yMax) ? y - yMax : T(0);
+        return scalar::root(scalar::square(xDiff) + scalar::square(yDiff));
+    }
+
+    // Return the smallest box holding both boxes
+    constexpr BasicBoundingBox united(const BasicBoundingBox& b) const {
+        return BasicBoundingBox { xMin < b.xMin ? xMin : b.xMin, yMin < b.yMin ? yMin : b.yMin,
+            xMax > b.xMax ? xMax : b.xMax, yMax > b.yMax ? yMax : b.yMax };
+    }
+
+    // Return the box shared by both boxes, which must intersect
+    constexpr BasicBoundingBox intersected(const BasicBoundingBox& b) const {
+        return BasicBoundingBox { xMin > b.xMin ? xMin : b.xMin, yMin > b.yMin ? yMin : b.yMin,
+            xMax < b.xMax ? xMax : b.xMax, yMax < b.yMax ? yMax : b.yMax };
+    }
+};
+
+// The bounds the shape classes and Scene work in
+using BoundingBox = BasicBoundingBox<float>;
+
+#endif /* BOUNDINGBOX_H_ */
@@ -0,0 +1,996 @@
+/*
+ * Microbenchmarks for the geometry library. Run through "make bench",
+ * which builds this file together with the library sources at -O2.
+ *
+ *     GeometryBench [json-file] [name-filter]
+ *
+ * Every benchmark reports the time and the number of heap allocations
+ * per operation, on stdout and as JSON in json-file (bench.json by
+ * default). Only benchmarks whose name contains name-filter are run.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <string>
+#include <vector>
+#include "BasicScene.h"
+#include "Geometry.h"
+#include "Kernels.h"
+#include "SceneFile.h"
+#include "SceneReader.h"
+#include "ShapeFactory.h"
+#include "StaticPage.h"
+
+using namespace std;
+
+// ============ Allocation counting =================
+
+namespace {
+
+atomic<long long> allocCount(0);
+
+}
+
+void* operator new(size_t size) {
+    allocCount.fetch_add(1, memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+// ============ Harness =================
+
+namespace {
+
+struct Result {
+    string name;
+    long long ops;
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+// Keeps results alive so the optimiser cannot drop the measured work
+volatile float sink;
+
+// Stream that throws away everything written to it
+class NullBuffer : public streambuf {
+    protected:
+        streamsize xsputn(const char*, streamsize n) override {
+            return n;
+        }
+        int overflow(int c) override {
+            return c;
+        }
+};
+
+class Bench {
+
+    public:
+        Bench(const string& filter) : filter_(filter) {
+        }
+
+        // Time body, which performs opsPerCall operations per call. The
+        // number of calls grows until a run takes at least minTime.
+        void run(const string& name, long long opsPerCall,
+                const function<void()>& body) {
+
+            if (name.find(filter_) == string::npos) {
+                return;
+            }
+            const double minTime = 0.2;
+            long long calls = 1;
+            for (;;) {
+                long long allocsBefore = allocCount.load();
+                auto start = chrono::steady_clock::now();
+                for (long long call = 0; call < calls; call++) {
+                    body();
+                }
+                chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+                long long allocs = allocCount.load() - allocsBefore;
+
+                if (elapsed.count() >= minTime || calls >= (1LL << 40)) {
+                    long long ops = calls * opsPerCall;
+                    Result r { name, ops, elapsed.count() * 1e9 / ops,
+                        static_cast<double>(allocs) / ops };
+                    printf("%-36s %14.2f ns/op %10.3f allocs/op\n",
+                            r.name.c_str(), r.nsPerOp, r.allocsPerOp);
+                    fflush(stdout);
+                    results_.push_back(r);
+                    return;
+                }
+                calls *= (elapsed.count() < minTime / 100) ? 10 : 2;
+            }
+        }
+
+        // Write every result as JSON to path
+        void writeJson(const string& path) const {
+            ofstream out(path);
+            out << "{\n  \"kernels\": \"" << batch::kernelName() << "\",\n";
+            out << "  \"benchmarks\": [\n";
+            for (size_t index = 0; index < results_.size(); index++) {
+                const Result& r = results_[index];
+                out << "    { \"name\": \"" << r.name << "\", \"ops\": " << r.ops
+                    << ", \"ns_per_op\": " << r.nsPerOp
+                    << ", \"allocs_per_op\": " << r.allocsPerOp << " }"
+                    << (index + 1 < results_.size() ? ",\n" : "\n");
+            }
+            out << "  ]\n}\n";
+        }
+
+    private:
+        string filter_;
+        vector<Result> results_;
+};
+
+// Random shapes roughly covering a width * height page
+vector<shared_ptr<Shape>> randomShapes(int count, unsigned seed,
+        int width = Scene::WIDTH, int height = Scene::HEIGHT, int maxExtent = 8) {
+
+    mt19937 gen(seed);
+    uniform_int_distribution<int> kind(0, 3);
+    uniform_int_distribution<int> xPos(-5, width + 5);
+    uniform_int_distribution<int> yPos(-5, height + 5);
+    uniform_int_distribution<int> extent(1, maxExtent);
+
+    vector<shared_ptr<Shape>> shapes;
+    for (int index = 0; index < count; index++) {
+        int x = xPos(gen), y = yPos(gen), e = extent(gen);
+        switch (kind(gen)) {
+            case 0:
+                shapes.push_back(make_shared<Point>(x, y));
+                break;
+            case 1:
+                shapes.push_back(make_shared<LineSegment>(Point(x, y), Point(x + e, y)));
+                break;
+            case 2:
+                shapes.push_back(make_shared<Rectangle>(Point(x, y), Point(x + e, y + e / 2 + 1)));
+                break;
+            default:
+                shapes.push_back(make_shared<Circle>(Point(x, y), e / 2.0f));
+                break;
+        }
+    }
+    return shapes;
+}
+
+// ============ Benchmarks =================
+
+void constructors(Bench& b) {
+
+    int i = 0;
+    b.run("ctor/Point", 1, [&]() {
+        Point p(i & 63, 3);
+        sink = p.getX();
+        i++;
+    });
+    b.run("ctor/LineSegment", 1, [&]() {
+        LineSegment l(Point(0, i & 63), Point(5, i & 63));
+        sink = l.length();
+        i++;
+    });
+    b.run("ctor/Rectangle", 1, [&]() {
+        Rectangle r(Point(0, 0), Point(1 + (i & 63), 4));
+        sink = r.area();
+        i++;
+    });
+    b.run("ctor/Circle", 1, [&]() {
+        Circle c(Point(i & 63, 0), 3);
+        sink = c.area();
+        i++;
+    });
+    b.run("make_shared/Circle", 1, [&]() {
+        auto c = make_shared<Circle>(Point(i & 63, 0), 3);
+        sink = c->area();
+        i++;
+    });
+}
+
+/* Rasterizing single shapes onto a page large enough to hold them */
+void rasterizing(Bench& b) {
+
+    FrameBuffer fb(256, 256);
+    const int radii[3] = { 4, 32, 120 };
+    for (int r : radii) {
+        ShapeValue circle(CircleValue { 128.5f, 127.25f, r + 0.3f });
+        b.run("draw/Circle/r:" + to_string(r), 1, [&]() {
+            circle.draw(fb);
+        });
+    }
+    ShapeValue rectangle(RectangleValue { 10, 10, 240, 240 });
+    b.run("draw/Rectangle/230x230", 1, [&]() {
+        rectangle.draw(fb);
+    });
+}
+
+/* Scenes built and torn down whole, with shared and with arena shapes,
+ * and loaded from a scene file */
+void building(Bench& b) {
+
+    const int count = 10000;
+    b.run("build/" + to_string(count) + "/shared", count, [&]() {
+        Scene s;
+        for (int i = 0; i < count; i++) {
+            s.addObject(make_shared<Rectangle>(Point(i % 60, i % 20), Point(i % 60 + 2, i % 20 + 1)));
+        }
+    });
+    b.run("build/" + to_string(count) + "/arena", count, [&]() {
+        Scene s;
+        for (int i = 0; i < count; i++) {
+            s.emplace<Rectangle>(Point(i % 60, i % 20), Point(i % 60 + 2, i % 20 + 1));
+        }
+    });
+
+    /* The same scene loaded from a scene file instead */
+    const char* path = "GeometryBench.scene";
+    {
+        Scene s;
+        for (int i = 0; i < count; i++) {
+            s.add(ShapeValue(RectangleValue { float(i % 60), float(i % 20),
+                    float(i % 60 + 2), float(i % 20 + 1) }));
+        }
+        SceneFile::write(s, path);
+    }
+    b.run("load/" + to_string(count) + "/map", count, [&]() {
+        SceneFile file(path);
+        sink = file.size();
+    });
+    b.run("load/" + to_string(count) + "/scene", count, [&]() {
+        SceneFile file(path);
+        Scene s(file);
+        sink = s.size();
+    });
+    /* One point test after loading: on the mapping, and on a scene */
+    vector<int> hits;
+    b.run("load/" + to_string(count) + "/map+containing", count, [&]() {
+        SceneFile file(path);
+        hits.clear();
+        file.containing(30, 10, hits);
+        sink = hits.size();
+    });
+    b.run("load/" + to_string(count) + "/scene+containing", count, [&]() {
+        SceneFile file(path);
+        Scene s(file);
+        hits.clear();
+        s.querySlots(30, 10, hits);
+        sink = hits.size();
+    });
+    remove(path);
+}
+
+/* Text shape lists read through SceneReader and through iostreams and
+ * the shape constructors */
+void ingesting(Bench& b) {
+
+    const int count = 100000;
+    string text;
+    for (int i = 0; i < count; i++) {
+        char line[80];
+        int x = i % 600, y = (i / 600) % 200;
+        switch (i % 3) {
+            case 0:
+                snprintf(line, sizeof(line), "circle %d.5 %d 3.25 %d\n", x, y, i % 4);
+                break;
+            case 1:
+                snprintf(line, sizeof(line), "rect %d %d %d.75 %d 1\n", x, y, x + 6, y + 2);
+                break;
+            default:
+                snprintf(line, sizeof(line), "point %d %d 0\n", x, y);
+                break;
+        }
+        text += line;
+    }
+
+    b.run("ingest/" + to_string(count) + "/reader", count, [&]() {
+        Scene s;
+        SceneReader reader(s);
+        istringstream in(text);
+        sink = reader.read(in);
+    });
+    b.run("ingest/" + to_string(count) + "/iostream", count, [&]() {
+        Scene s;
+        istringstream in(text);
+        string kind;
+        float x, y, a, c;
+        int d;
+        while (in >> kind) {
+            if (kind == "circle") {
+                in >> x >> y >> a >> d;
+                s.addObject(make_shared<Circle>(Point(x, y, d), a));
+            } else if (kind == "rect") {
+                in >> x >> y >> a >> c >> d;
+                s.addObject(make_shared<Rectangle>(Point(x, y, d), Point(a, c, d)));
+            } else {
+                in >> x >> y >> d;
+                s.addObject(make_shared<Point>(x, y, d));
+            }
+        }
+        sink = s.size();
+    });
+}
+
+/* Shapes made from arguments of which one in twenty is bad, through the
+ * throwing constructors, the factories and the batch factory */
+void creating(Bench& b) {
+
+    const int count = 10000;
+    vector<ShapeArgs> args;
+    for (int i = 0; i < count; i++) {
+        float r = (i % 20 == 7) ? 0 : 1 + i % 9;
+        if (i % 2) {
+            args.push_back(ShapeArgs { ShapeValue::CIRCLE, i % 4, float(i % 600), float(i % 200), 0, 0, r });
+        } else {
+            args.push_back(ShapeArgs { ShapeValue::RECTANGLE, 1, float(i % 600), float(i % 200),
+                    float(i % 600) + r, float(i % 200) + 2, 0 });
+        }
+    }
+    vector<ShapeValue> made;
+    made.reserve(count);
+    vector<ShapeError> errors(count);
+
+    b.run("create/" + to_string(count) + "/constructors", count, [&]() {
+        made.clear();
+        for (const ShapeArgs& a : args) {
+            try {
+                if (a.kind == ShapeValue::CIRCLE) {
+                    made.push_back(Circle(Point(a.x0, a.y0, a.depth), a.r).value());
+                } else {
+                    made.push_back(Rectangle(Point(a.x0, a.y0, a.depth), Point(a.x1, a.y1, a.depth)).value());
+                }
+            }
+            catch (const invalid_argument&) {
+            }
+        }
+    });
+    b.run("create/" + to_string(count) + "/factories", count, [&]() {
+        made.clear();
+        for (const ShapeArgs& a : args) {
+            ShapeResult r = (a.kind == ShapeValue::CIRCLE) ? makeCircle(a.x0, a.y0, a.r, a.depth)
+                : makeRectangle(a.x0, a.y0, a.x1, a.y1, a.depth);
+            if (r) {
+                made.push_back(r.value());
+            }
+        }
+    });
+    b.run("create/" + to_string(count) + "/batch", count, [&]() {
+        made.clear();
+        sink = makeShapes(args.data(), count, errors.data(), made);
+    });
+}
+
+/* Every overlapping pair of a scene: testing all pairs, sweeping shapes
+ * that stay put, and sweeping after the whole scene has moved a little */
+void colliding(Bench& b) {
+
+    const int small = 2000;
+    vector<shared_ptr<Shape>> few = randomShapes(small, 21, 1000, 1000);
+    vector<ShapeValue> values;
+    for (const auto& shape : few) {
+        values.push_back(shape->value());
+    }
+    b.run("overlaps/" + to_string(small) + "/all-pairs", small, [&]() {
+        int found = 0;
+        for (int i = 0; i < small; i++) {
+            for (int j = i + 1; j < small; j++) {
+                found += values[i].intersects(values[j]);
+            }
+        }
+        sink = found;
+    });
+
+    const int sizes[2] = { small, 100000 };
+    for (int size : sizes) {
+        vector<shared_ptr<Shape>> shapes = randomShapes(size, 21, 1000, 1000);
+        Scene s(1000, 1000);
+        vector<int> slots;
+        for (const auto& shape : shapes) {
+            slots.push_back(s.add(shape->value()));
+        }
+        vector<pair<int, int>> pairs;
+        b.run("overlaps/" + to_string(size) + "/sweep", size, [&]() {
+            pairs.clear();
+            s.overlaps(pairs);
+            sink = pairs.size();
+        });
+        float step = 0.5f;
+        b.run("overlaps/" + to_string(size) + "/sweep-after-move", size, [&]() {
+            s.translate(slots, step, 0);
+            step = -step;
+            pairs.clear();
+            s.overlaps(pairs);
+            sink = pairs.size();
+        });
+        /* Fewer than an eighth of the shapes jump across the whole order */
+        vector<int> jumping(slots.begin(), slots.begin() + size * 12 / 100);
+        float jump = 500;
+        b.run("overlaps/" + to_string(size) + "/sweep-after-far-move", size, [&]() {
+            s.translate(jumping, jump, 0);
+            jump = -jump;
+            pairs.clear();
+            s.overlaps(pairs);
+            sink = pairs.size();
+        });
+    }
+}
+
+/* Shapes meeting 100 x 100 viewports of a scene: scanning every shape,
+ * asking the R-tree, and asking it again after the scene has moved and
+ * the tree has been refitted */
+void querying(Bench& b) {
+
+    const int size = 100000;
+    const int windows = 64;
+    vector<shared_ptr<Shape>> shapes = randomShapes(size, 23, 1000, 1000);
+    Scene s(1000, 1000);
+    vector<int> slots;
+    for (const auto& shape : shapes) {
+        slots.push_back(s.add(shape->value()));
+    }
+    mt19937 gen(29);
+    uniform_real_distribution<float> corner(0, 900);
+    vector<RectangleValue> views;
+    for (int w = 0; w < windows; w++) {
+        float x = corner(gen), y = corner(gen);
+        views.push_back(RectangleValue { x, y, x + 100, y + 100 });
+    }
+
+    b.run("range/" + to_string(size) + "/linear", windows, [&]() {
+        size_t found = 0;
+        for (const RectangleValue& view : views) {
+            ShapeValue window(view);
+            for (const auto& shape : shapes) {
+                found += shape->value().intersects(window);
+            }
+        }
+        sink = found;
+    });
+    vector<int> hits;
+    b.run("range/" + to_string(size) + "/rtree", windows, [&]() {
+        size_t found = 0;
+        for (const RectangleValue& view : views) {
+            hits.clear();
+            s.queryRange(view.xMin, view.yMin, view.xMax, view.yMax, hits);
+            found += hits.size();
+        }
+        sink = found;
+    });
+    float step = 0.5f;
+    b.run("range/" + to_string(size) + "/rtree-after-move", windows, [&]() {
+        s.translate(slots, step, 0);
+        step = -step;
+        size_t found = 0;
+        for (const RectangleValue& view : views) {
+            hits.clear();
+            s.queryRange(view.xMin, view.yMin, view.xMax, view.yMax, hits);
+            found += hits.size();
+        }
+        sink = found;
+    });
+
+    /* The shapes nearest single points and batches of points, against
+     * measuring every shape, on a scene of a million shapes */
+    const int many = 1000000;
+    const int k = 8;
+    vector<shared_ptr<Shape>> more = randomShapes(many, 31, 1000, 1000);
+    Scene big(1000, 1000);
+    for (const auto& shape : more) {
+        big.add(shape->value());
+    }
+    uniform_real_distribution<float> coord(0, 1000);
+    const int points = 4096;
+    vector<float> xs, ys;
+    for (int q = 0; q < points; q++) {
+        xs.push_back(coord(gen));
+        ys.push_back(coord(gen));
+    }
+    b.run("nearest/" + to_string(many) + "/k8/linear", 1, [&]() {
+        float x = xs[0], y = ys[0];
+        vector<pair<float, int>> best;
+        for (int slot = 0; slot < many; slot++) {
+            best.push_back(make_pair(big.value(slot).distance(x, y), slot));
+        }
+        partial_sort(best.begin(), best.begin() + k, best.end());
+        sink = best[0].second;
+    });
+    int next = 0;
+    vector<int> nearSlots;
+    big.nearest(0, 0, k, nearSlots);
+    b.run("nearest/" + to_string(many) + "/k8/rtree", 1, [&]() {
+        nearSlots.clear();
+        big.nearest(xs[next], ys[next], k, nearSlots);
+        next = (next + 1) % points;
+        sink = nearSlots[0];
+    });
+    const int threadCounts[2] = { 1, 4 };
+    for (int threads : threadCounts) {
+        big.setRenderThreads(threads);
+        b.run("nearest/" + to_string(many) + "/k8/batch/threads" + to_string(threads), points, [&]() {
+            big.nearest(xs.data(), ys.data(), points, k, nearSlots);
+            sink = nearSlots[0];
+        });
+    }
+}
+
+void transforms(Bench& b) {
+
+    Point p(1, 2);
+    LineSegment l(Point(0, 0), Point(8, 0));
+    Rectangle r(Point(0, 0), Point(8, 4));
+    Circle c(Point(0, 0), 4);
+    Shape* shapes[4] = { &p, &l, &r, &c };
+    const char* names[4] = { "Point", "LineSegment", "Rectangle", "Circle" };
+
+    for (int k = 0; k < 4; k++) {
+        Shape* s = shapes[k];
+        b.run(string("translate/") + names[k], 2, [&]() {
+            s->translate(1, -1);
+            s->translate(-1, 1);
+        });
+        b.run(string("rotate/") + names[k], 2, [&]() {
+            s->rotate();
+            s->rotate();
+        });
+        b.run(string("scale/") + names[k], 2, [&]() {
+            s->scale(2);
+            s->scale(0.5);
+        });
+    }
+    sink = r.getXmin() + l.getXmin() + c.getR() + p.getX();
+
+    /* A chain of 64 calls on one rectangle before its bounds are read */
+    const int chain = 64;
+    Rectangle eager(Point(0, 0), Point(8, 4));
+    b.run("chain/" + to_string(chain) + "/Rectangle/eager", chain, [&]() {
+        for (int i = 0; i < chain / 4; i++) {
+            eager.translate(1, -1);
+            eager.rotate();
+            eager.scale(2);
+            eager.scale(0.5);
+        }
+        sink = eager.bounds().xMin;
+    });
+    LazyShape lazy(ShapeValue(RectangleValue { 0, 0, 8, 4 }));
+    b.run("chain/" + to_string(chain) + "/Rectangle/lazy", chain, [&]() {
+        for (int i = 0; i < chain / 4; i++) {
+            lazy.translate(1, -1);
+            lazy.rotate();
+            lazy.scale(2);
+            lazy.scale(0.5);
+        }
+        sink = lazy.bounds().xMin;
+    });
+}
+
+/* The same mixed shapes as objects behind pointers and as contiguous values */
+void values(Bench& b) {
+
+    const int count = 100000;
+    vector<shared_ptr<Shape>> shapes = randomShapes(count, 11);
+    vector<ShapeValue> values;
+    for (const auto& shape : shapes) {
+        values.push_back(shape->value());
+    }
+
+    b.run("bulk/translate/shapes", count, [&]() {
+        for (const auto& shape : shapes) {
+            shape->translate(1, -1);
+        }
+    });
+    b.run("bulk/translate/values", count, [&]() {
+        for (ShapeValue& v : values) {
+            v.translate(1, -1);
+        }
+    });
+    b.run("bulk/contains/shapes", count, [&]() {
+        Point q(30, 10);
+        int hits = 0;
+        for (const auto& shape : shapes) {
+            hits += shape->contains(q);
+        }
+        sink = hits;
+    });
+    b.run("bulk/contains/values", count, [&]() {
+        int hits = 0;
+        for (const ShapeValue& v : values) {
+            hits += v.contains(30, 10);
+        }
+        sink = hits;
+    });
+
+    /* Moving a set of shapes in a scene one by one and as one batch.
+     * Moves alternate in direction so the shapes stay on the page. */
+    const int moved = 50000;
+    Scene pointers(1000, 1000), held(1000, 1000);
+    vector<shared_ptr<Shape>> sceneShapes = randomShapes(moved, 12, 1000, 1000);
+    vector<int> slots;
+    for (const auto& shape : sceneShapes) {
+        pointers.addObject(shape);
+        slots.push_back(held.add(shape->value()));
+    }
+    float step = 1;
+    b.run("bulk/translate/" + to_string(moved) + "/scene/shapes", moved, [&]() {
+        for (const auto& shape : sceneShapes) {
+            shape->translate(step, -step);
+        }
+        step = -step;
+    });
+    b.run("bulk/translate/" + to_string(moved) + "/scene/batch", moved, [&]() {
+        held.translate(slots, step, -step);
+        step = -step;
+    });
+    for (int threads : { 2, 4 }) {
+        held.setRenderThreads(threads);
+        b.run("bulk/translate/" + to_string(moved) + "/scene/batch/threads:" + to_string(threads), moved, [&]() {
+            held.translate(slots, step, -step);
+            step = -step;
+        });
+    }
+    held.setRenderThreads(1);
+}
+
+void containment(Bench& b) {
+
+    Point p(1, 2);
+    LineSegment l(Point(0, 0), Point(8, 0));
+    Rectangle r(Point(0, 0), Point(8, 4));
+    Circle c(Point(0, 0), 4);
+    Shape* shapes[4] = { &p, &l, &r, &c };
+    const char* names[4] = { "Point", "LineSegment", "Rectangle", "Circle" };
+
+    const int count = 4096;
+    mt19937 gen(7);
+    uniform_real_distribution<float> coord(-6, 10);
+    vector<Point> points;
+    vector<float> xs, ys;
+    for (int index = 0; index < count; index++) {
+        points.push_back(Point(coord(gen), coord(gen)));
+        xs.push_back(points.back().getX());
+        ys.push_back(points.back().getY());
+    }
+    vector<uint64_t> mask((count + 63) / 64);
+
+    for (int k = 0; k < 4; k++) {
+        Shape* s = shapes[k];
+        b.run(string("contains/") + names[k], count, [&]() {
+            int hits = 0;
+            for (const Point& q : points) {
+                hits += s->contains(q);
+            }
+            sink = hits;
+        });
+        b.run(string("containsMany/") + names[k], count, [&]() {
+            s->containsMany(&xs[0], &ys[0], count, &mask[0]);
+            sink = mask[0];
+        });
+    }
+}
+
+/* Containment and drawing of the same shapes in each scalar type, alone
+ * and through a BasicScene, all on whole and half co-ordinates so that
+ * each type holds them exactly */
+template <class T>
+void scalarCase(Bench& b, const string& name) {
+
+    const int count = 4096;
+    mt19937 gen(13);
+    uniform_int_distribution<int> halves(0, 400);
+    uniform_int_distribution<int> kind(0, 3);
+    auto coord = [&]() { return T(halves(gen) / 2.0); };
+    vector<BasicShapeValue<T>> shapes;
+    vector<T> xs, ys;
+    for (int index = 0; index < count; index++) {
+        T x = coord(), y = coord(), e = T(1 + halves(gen) % 16);
+        switch (kind(gen)) {
+            case 0:
+                shapes.push_back(BasicShapeValue<T>(BasicPointValue<T> { x, y }));
+                break;
+            case 1:
+                shapes.push_back(BasicShapeValue<T>(BasicSegmentValue<T> { x, y, x + e, y }));
+                break;
+            case 2:
+                shapes.push_back(BasicShapeValue<T>(BasicRectangleValue<T> { x, y, x + e, y + e }));
+                break;
+            default:
+                shapes.push_back(BasicShapeValue<T>(BasicCircleValue<T> { x, y, e }));
+                break;
+        }
+        xs.push_back(x + T(halves(gen) % 16 / 2.0));
+        ys.push_back(y + T(halves(gen) % 16 / 2.0));
+    }
+
+    b.run("scalar/contains/" + name, count, [&]() {
+        int hits = 0;
+        for (int index = 0; index < count; index++) {
+            hits += shapes[index].contains(xs[index], ys[index]);
+        }
+        sink = hits;
+    });
+    FrameBuffer fb(256, 256);
+    BasicShapeValue<T> circle(BasicCircleValue<T> { T(128.5), T(127.5), T(32.5) });
+    b.run("scalar/draw/Circle/r:32/" + name, 1, [&]() {
+        circle.draw(fb);
+    });
+    b.run("scalar/draw/mixed/" + name, count, [&]() {
+        for (const auto& shape : shapes) {
+            shape.draw(fb);
+        }
+    });
+    BasicScene<T> scene(256, 256);
+    scene.add(&shapes[0], shapes.size());
+    vector<int> slots;
+    b.run("scalar/scene/querySlots/" + name, count, [&]() {
+        for (int index = 0; index < count; index++) {
+            slots.clear();
+            scene.querySlots(xs[index], ys[index], slots);
+        }
+        sink = slots.size();
+    });
+    b.run("scalar/scene/render/" + name, count, [&]() {
+        scene.render(fb);
+    });
+}
+
+void scalars(Bench& b) {
+    scalarCase<float>(b, "float");
+    scalarCase<double>(b, "double");
+    scalarCase<Fixed16>(b, "fixed16");
+}
+
+/* The still part of a HUD: a frame, rulers, a sight and two panels */
+constexpr ShapeValue hudShapes[] = {
+    ShapeValue(SegmentValue { 0, 0, 59, 0 }),
+    ShapeValue(SegmentValue { 0, 19, 59, 19 }),
+    ShapeValue(SegmentValue { 0, 0, 0, 19 }),
+    ShapeValue(SegmentValue { 59, 0, 59, 19 }),
+    ShapeValue(SegmentValue { 10, 1, 10, 3 }),
+    ShapeValue(SegmentValue { 20, 1, 20, 3 }),
+    ShapeValue(SegmentValue { 40, 1, 40, 3 }),
+    ShapeValue(SegmentValue { 50, 1, 50, 3 }),
+    ShapeValue(SegmentValue { 1, 5, 3, 5 }),
+    ShapeValue(SegmentValue { 1, 10, 3, 10 }),
+    ShapeValue(SegmentValue { 1, 15, 3, 15 }),
+    ShapeValue(CircleValue { 30, 10, 6 }),
+    ShapeValue(CircleValue { 30, 10, 2.5f }),
+    ShapeValue(SegmentValue { 22, 10, 38, 10 }),
+    ShapeValue(SegmentValue { 30, 2, 30, 18 }),
+    ShapeValue(RectangleValue { 44, 13, 57, 17 }),
+    ShapeValue(RectangleValue { 44, 5, 57, 8 })
+};
+static_assert(validShapes(hudShapes, sizeof(hudShapes) / sizeof(hudShapes[0])), "bad HUD shape");
+constexpr StaticPage<60, 20> hudPage = rasterize<60, 20>(hudShapes);
+
+/* A HUD drawn over by a few moving shapes: built from shared shapes, from
+ * a constant table, and from a page drawn while compiling */
+void overlaying(Bench& b) {
+
+    NullBuffer nothing;
+    ostream out(&nothing);
+    const ShapeValue moving[3] = { ShapeValue(CircleValue { 12, 12, 3 }),
+        ShapeValue(RectangleValue { 24, 4, 28, 7 }), ShapeValue(PointValue { 48, 11 }) };
+
+    b.run("overlay/build/shared", 1, [&]() {
+        Scene s;
+        for (const ShapeValue& v : hudShapes) {
+            BoundingBox box = v.bounds();
+            switch (v.kind()) {
+                case ShapeValue::CIRCLE:
+                    s.addObject(make_shared<Circle>(Point((box.xMin + box.xMax) / 2,
+                            (box.yMin + box.yMax) / 2), (box.xMax - box.xMin) / 2));
+                    break;
+                case ShapeValue::RECTANGLE:
+                    s.addObject(make_shared<Rectangle>(Point(box.xMin, box.yMin), Point(box.xMax, box.yMax)));
+                    break;
+                default:
+                    s.addObject(make_shared<LineSegment>(Point(box.xMin, box.yMin), Point(box.xMax, box.yMax)));
+                    break;
+            }
+        }
+        s.add(moving);
+        out << s;
+    });
+    b.run("overlay/build/table", 1, [&]() {
+        Scene s;
+        s.add(hudShapes);
+        s.add(moving);
+        out << s;
+    });
+    FrameBuffer page = hudPage.frameBuffer();
+    b.run("overlay/build/background", 1, [&]() {
+        Scene s;
+        s.setBackground(page);
+        s.add(moving);
+        out << s;
+    });
+
+    /* Frames after the first, with the moving shapes going back and forth */
+    Scene table, background;
+    table.add(hudShapes);
+    background.setBackground(page);
+    vector<int> tableMoving, backgroundMoving;
+    for (const ShapeValue& v : moving) {
+        tableMoving.push_back(table.add(v));
+        backgroundMoving.push_back(background.add(v));
+    }
+    float step = 1;
+    b.run("overlay/frame/table", 1, [&]() {
+        table.translate(tableMoving, step, 0);
+        step = -step;
+        out << table;
+    });
+    b.run("overlay/frame/background", 1, [&]() {
+        background.translate(backgroundMoving, step, 0);
+        step = -step;
+        out << background;
+    });
+}
+
+void rendering(Bench& b) {
+
+    NullBuffer nothing;
+    ostream out(&nothing);
+    const int sizes[3] = { 10, 1000, 100000 };
+
+    for (int size : sizes) {
+        vector<shared_ptr<Shape>> shapes = randomShapes(size, size);
+        Scene s;
+        for (const auto& shape : shapes) {
+            s.addObject(shape);
+        }
+        b.run("render/" + to_string(size), 1, [&]() {
+            s.invalidate();
+            out << s;
+        });
+        /* One shape moves per frame, so only its regions are redrawn */
+        float step = 1;
+        b.run("rerender/" + to_string(size), 1, [&]() {
+            shapes[0]->translate(step, 0);
+            step = -step;
+            out << s;
+        });
+        b.run("query/" + to_string(size), 1, [&]() {
+            sink = s.query(Point(30, 10)).size();
+        });
+        b.run("pick/" + to_string(size), 1, [&]() {
+            sink = s.pick(30, 10);
+        });
+    }
+
+    /* A large canvas, drawn whole and streamed in bands of tiles */
+    const int side = 4096;
+    vector<shared_ptr<Shape>> shapes = randomShapes(100000, 4096, side, side, 64);
+    Scene big(side, side);
+    for (const auto& shape : shapes) {
+        big.addObject(shape);
+    }
+    b.run("render/4096x4096", 1, [&]() {
+        big.invalidate();
+        out << big;
+    });
+    /* Depth compositing: the nearest of the overlapping shapes shows */
+    Scene composited;
+    composited.setDepthCompositing(true);
+    vector<shared_ptr<Shape>> compositedShapes = randomShapes(100000, 3);
+    for (size_t index = 0; index < compositedShapes.size(); index++) {
+        compositedShapes[index]->setDepth(index % 10);
+        composited.setGlyph(composited.addObject(compositedShapes[index]), 'a' + index % 26);
+    }
+    b.run("renderDepth/100000", 1, [&]() {
+        composited.invalidate();
+        out << composited;
+    });
+    float step = 1;
+    b.run("rerenderDepth/100000", 1, [&]() {
+        compositedShapes[0]->translate(step, 0);
+        step = -step;
+        out << composited;
+    });
+
+    /* Show and hide one of 100 layers; the other 99 are never touched */
+    Scene layered;
+    vector<shared_ptr<Shape>> layerShapes = randomShapes(100000, 5);
+    for (size_t index = 0; index < layerShapes.size(); index++) {
+        layerShapes[index]->setDepth(1 + index % 100);
+        layered.addObject(layerShapes[index]);
+    }
+    int depth = 50;
+    b.run("toggleDepth/100000", 1, [&]() {
+        depth = (depth == 50) ? 51 : 50;
+        layered.setDrawDepth(depth);
+        out << layered;
+    });
+
+    b.run("renderTiled/4096x4096", 1, [&]() {
+        big.renderTiled(out);
+    });
+
+    /* Covered area, counted from the text page and from a bit canvas */
+    b.run("coverage/4096x4096/text", 1, [&]() {
+        stringstream page;
+        big.invalidate();
+        page << big;
+        const string& cells = page.str();
+        sink = count(cells.begin(), cells.end(), FrameBuffer::ink);
+    });
+    BitCanvas canvas(side, side);
+    b.run("coverage/4096x4096/bits", 1, [&]() {
+        big.render(canvas);
+        sink = canvas.count();
+    });
+    /* The same with a background holding the first 1000 shapes */
+    FrameBuffer backdrop(side, side);
+    for (size_t index = 0; index < 1000; index++) {
+        shapes[index]->value().draw(backdrop);
+    }
+    big.setBackground(backdrop);
+    b.run("coverage/4096x4096/bits/background", 1, [&]() {
+        big.render(canvas);
+        sink = canvas.count();
+    });
+    big.clearBackground();
+
+    /* The same full redraw spread over worker threads */
+    unsigned cores = max(2u, thread::hardware_concurrency());
+    for (unsigned threads = 2; threads <= cores; threads *= 2) {
+        big.setRenderThreads(threads);
+        b.run("render/4096x4096/threads:" + to_string(threads), 1, [&]() {
+            big.invalidate();
+            out << big;
+        });
+    }
+    big.setRenderThreads(1);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+
+    string json = (argc > 1) ? argv[1] : "bench.json";
+    Bench b((argc > 2) ? argv[2] : "");
+
+    printf("kernels: %s\n", batch::kernelName());
+    constructors(b);
+    building(b);
+    ingesting(b);
+    creating(b);
+    rasterizing(b);
+    transforms(b);
+    values(b);
+    containment(b);
+    scalars(b);
+    colliding(b);
+    querying(b);
+    overlaying(b);
+    rendering(b);
+
+    b.writeJson(json);
+    return 0;
+}
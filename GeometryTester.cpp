@@ -1,8 +1,21 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <type_traits>
+#include "BasicScene.h"
 #include "Geometry.h"
 #include "GeometryTester.h"
+#include "SceneFile.h"
+#include "SceneReader.h"
+#include "ShapeFactory.h"
+#include "ShapeStore.h"
+#include "StaticPage.h"
 
 using namespace std;
 
@@ -978,10 +991,2261 @@ void GeometryTester::testy() {
 	passOut_();
 }
 
-// reserved for new test cases
+// scene draw vertical line, shapes partly off the page
 void GeometryTester::testz() {
 	funcname_ = "GeometryTester::testz";
 
+	{
+	// vertical line covers only its own rows
+	Scene s;
+	auto l = make_shared<LineSegment>(Point(3,2), Point(3,5));
+	s.addObject(l);
+	stringstream ss;
+	ss << s;
+
+	string page = blankpage_;
+	for(int j=14;j<=17;j++) page[j*(Scene::WIDTH+1)+3] = '*';
+	if (ss.str() != page) {
+		errorOut_("vertical line drawn wrongly",1);
+		cout << "Expected output:\n" << page;
+		cout << "Your output:\n" << ss.str();
+	}
+
+	// clipped rect and circle
+	Scene s2;
+	auto r = make_shared<Rectangle>(Point(-5,-5), Point(2,1));
+	auto c = make_shared<Circle>(Point(62,10), 3);
+	s2.addObject(r);
+	s2.addObject(c);
+	stringstream ss2;
+	ss2 << s2;
+
+	string page2 = blankpage_;
+	for(int j=18;j<=19;j++)
+		for(int i=0;i<=2;i++)
+			page2[j*(Scene::WIDTH+1)+i] = '*';
+	page2[9*(Scene::WIDTH+1)+59] = '*';
+	if (ss2.str() != page2) {
+		errorOut_("clipped shapes drawn wrongly",2);
+		cout << "Expected output:\n" << page2;
+		cout << "Your output:\n" << ss2.str();
+	}
+
+	}
+
+	passOut_();
+}
+
+// scene point query, index follows transforms
+void GeometryTester::testA() {
+	funcname_ = "GeometryTester::testA";
+
+	{
+	auto p = make_shared<Point>(5,5);
+	auto l = make_shared<LineSegment>(Point(0,5), Point(10,5));
+	auto r = make_shared<Rectangle>(Point(4,4), Point(6,6));
+	auto c = make_shared<Circle>(Point(40,40), 3);
+	auto big = make_shared<Rectangle>(Point(-500,-500), Point(500,500));
+
+	Scene s;
+	s.addObject(p);
+	s.addObject(l);
+	s.addObject(r);
+	s.addObject(c);
+
+	if (s.query(Point(5,5)).size() != 3)
+		errorOut_("shapes at (5,5) reported as ", s.query(Point(5,5)).size(), 1);
+	if (s.query(Point(9,5)).size() != 1)
+		errorOut_("shapes at (9,5) reported as ", s.query(Point(9,5)).size(), 1);
+	if (s.query(Point(42,40)).size() != 1)
+		errorOut_("shapes at (42,40) reported as ", s.query(Point(42,40)).size(), 1);
+	if (!s.query(Point(20,20)).empty())
+		errorOut_("shapes at (20,20) reported as ", s.query(Point(20,20)).size(), 1);
+
+	// moved shapes are found at their new place only
+	c->translate(-20,-20);
+	r->rotate();
+	r->scale(2);
+	l->rotate();
+	vector<Shape*> hits = s.query(Point(20,20));
+	if (hits.size() != 1 || hits[0] != c.get())
+		errorOut_("translated circle not found", 2);
+	if (!s.query(Point(42,40)).empty())
+		errorOut_("circle still found at old place", 2);
+	if (s.query(Point(5,8)).size() != 1)
+		errorOut_("shapes at (5,8) reported as ", s.query(Point(5,8)).size(), 2);
+	c->scale(4);
+	if (s.query(Point(31,20)).size() != 1)
+		errorOut_("scaled circle not found", 2);
+
+	// shapes spanning many cells, smaller cells
+	s.addObject(big);
+	s.setIndexCellSize(1);
+	if (s.query(Point(5,5)).size() != 4)
+		errorOut_("shapes at (5,5) reported as ", s.query(Point(5,5)).size(), 2);
+	if (s.query(Point(-300,200)).size() != 1)
+		errorOut_("shapes at (-300,200) reported as ", s.query(Point(-300,200)).size(), 2);
+
+	}
+
+	passOut_();
+}
+
+// shape store batch kernels agree with contains
+void GeometryTester::testB() {
+	funcname_ = "GeometryTester::testB";
+
+	{
+	vector<shared_ptr<Shape>> shapes;
+	for(int i=0;i<203;i++) {
+		float x = (i*7)%23, y = (i*11)%17;
+		switch (i%4) {
+		case 0: shapes.push_back(make_shared<Point>(x,y)); break;
+		case 1: shapes.push_back(make_shared<LineSegment>(Point(x,y), Point(x,y+i%5+1))); break;
+		case 2: shapes.push_back(make_shared<Rectangle>(Point(x,y), Point(x+i%6+1,y-i%3-1))); break;
+		case 3: shapes.push_back(make_shared<Circle>(Point(x,y), i%7+0.5)); break;
+		}
+	}
+
+	ShapeStore store;
+	for(int i=0;i<(int)shapes.size();i++) store.add(*shapes[i], i);
+	if (store.size() != shapes.size())
+		errorOut_("store size reported as ", store.size(), 1);
+	if (store.circles().id.size() != 50)
+		errorOut_("circle count reported as ", store.circles().id.size(), 1);
+
+	for(float y=-2;y<20;y+=0.5) {
+		for(float x=-2;x<30;x+=0.5) {
+			vector<int> ids;
+			store.containing(x, y, ids);
+			sort(ids.begin(), ids.end());
+			vector<int> expected;
+			for(int i=0;i<(int)shapes.size();i++)
+				if (shapes[i]->contains(Point(x,y))) expected.push_back(i);
+			if (ids != expected)
+				errorOut_("containing wrong at x = " + std::to_string(x) + ", y = ", y, 2);
+		}
+	}
+
+	// raw kernel on an odd count
+	const ShapeStore::CircleGroup& c = store.circles();
+	uint64_t mask[1];
+	ShapeStore::circlesContaining(&c.x[0], &c.y[0], &c.r[0], 37, 5, 5, mask);
+	for(int i=0;i<37;i++) {
+		bool in = shapes[c.id[i]]->contains(Point(5,5));
+		if (in != (((mask[0] >> i) & 1) != 0))
+			errorOut_(string("circle kernel (") + ShapeStore::kernelName() + ") wrong for ", i, 2);
+	}
+	if ((mask[0] >> 37) != 0)
+		errorOut_("circle kernel set bits past n", 2);
+
+	}
+
+	passOut_();
+}
+
+// batch containsMany agrees with contains
+void GeometryTester::testC() {
+	funcname_ = "GeometryTester::testC";
+
+	{
+	Point p(2,3);
+	LineSegment l(Point(2,-1), Point(2,6));
+	Rectangle r(Point(-1.5,0), Point(4,3.5));
+	Circle c(Point(1,2), 3);
+	Shape* sp[4] = { &p, &l, &r, &c };
+
+	// a 2501 point grid, more than one block and not a multiple of 8
+	vector<float> xs, ys;
+	for(int j=0;j<41;j++)
+		for(int i=0;i<61;i++) {
+			xs.push_back(-5 + i*0.25);
+			ys.push_back(-3 + j*0.25);
+		}
+	size_t n = xs.size();
+
+	for(int k=0;k<4;k++) {
+		vector<uint64_t> mask((n+63)/64);
+		sp[k]->containsMany(&xs[0], &ys[0], n, &mask[0]);
+		vector<size_t> indices;
+		sp[k]->containsMany(&xs[0], &ys[0], n, indices);
+
+		vector<size_t> expected;
+		for(size_t i=0;i<n;i++) {
+			bool in = sp[k]->contains(Point(xs[i],ys[i]));
+			if (in) expected.push_back(i);
+			if (in != (((mask[i/64] >> (i%64)) & 1) != 0))
+				errorOut_("containsMany mask wrong for sp", k, 1);
+		}
+		if (indices != expected)
+			errorOut_("containsMany indices wrong for sp", k, 2);
+		if (expected.empty())
+			errorOut_("no points inside sp", k, 2);
+	}
+
+	}
+
+	passOut_();
+}
+
+// incremental redraw matches a scene drawn from scratch
+void GeometryTester::testD() {
+	funcname_ = "GeometryTester::testD";
+
+	{
+	vector<shared_ptr<Shape>> shapes;
+	for(int i=0;i<40;i++) {
+		float x = (i*13)%64 - 2, y = (i*7)%22 - 1;
+		switch (i%4) {
+		case 0: shapes.push_back(make_shared<Point>(x,y,i%3)); break;
+		case 1: shapes.push_back(make_shared<LineSegment>(Point(x,y,i%3), Point(x+i%9+1,y,i%3))); break;
+		case 2: shapes.push_back(make_shared<Rectangle>(Point(x,y,i%3), Point(x+i%5+1,y+i%4+1,i%3))); break;
+		case 3: shapes.push_back(make_shared<Circle>(Point(x,y,i%3), i%5+1)); break;
+		}
+	}
+
+	Scene s;
+	for(auto& sp : shapes) s.addObject(sp);
+	stringstream first;
+	first << s;
+
+	int drawDepth = 0;
+	for(int step=0;step<60;step++) {
+		Shape& sh = *shapes[(step*17)%shapes.size()];
+		switch (step%6) {
+		case 0: sh.translate(3,-2); break;
+		case 1: sh.rotate(); break;
+		case 2: sh.scale(step%4 ? 0.5 : 2); break;
+		case 3: sh.translate(-4,1); break;
+		case 4: sh.setDepth(step%3); break;
+		case 5: drawDepth = (step%12 == 5) ? 1 : 0; s.setDrawDepth(drawDepth); break;
+		}
+		if (step == 30) {
+			shapes.push_back(make_shared<Circle>(Point(20,10), 4));
+			s.addObject(shapes.back());
+		}
+
+		stringstream incremental;
+		incremental << s;
+
+		// a fresh scene holding the same shapes is drawn from scratch
+		Scene fresh;
+		for(auto& sp : shapes) fresh.addObject(sp);
+		fresh.setDrawDepth(drawDepth);
+		stringstream full;
+		full << fresh;
+
+		if (incremental.str() != full.str()) {
+			errorOut_("incremental frame differs at step ", step, 1);
+			cout << "Expected output:\n" << full.str();
+			cout << "Your output:\n" << incremental.str();
+		}
+	}
+
+	}
+
+	{
+	// regions far beyond the page are clipped before they are redrawn
+	Scene s;
+	s.add(ShapeValue(RectangleValue { 2, 2, 6, 5 }));
+	s.add(ShapeValue(CircleValue { 30, 10, 4 }));
+	stringstream first;
+	first << s;
+	s.setValue(0, ShapeValue(RectangleValue { -1e10f, 2, 10, 5 }));
+	s.setValue(1, ShapeValue(SegmentValue { 40, -1e30f, 40, 1e30f }));
+	stringstream incremental;
+	incremental << s;
+	Scene fresh;
+	fresh.add(ShapeValue(RectangleValue { -1, 2, 10, 5 }));
+	fresh.add(ShapeValue(SegmentValue { 40, -1, 40, Scene::HEIGHT }));
+	stringstream full;
+	full << fresh;
+	if (incremental.str() != full.str())
+		errorOut_("huge regions redrawn as ", "\n" + incremental.str(), 2);
+	}
+
+	passOut_();
+}
+
+// canvas size, tiled rendering
+void GeometryTester::testE() {
+	funcname_ = "GeometryTester::testE";
+
+	{
+	// a page spanning several tiles each way
+	Scene s(150, 90);
+	if (s.width() != 150 || s.height() != 90)
+		errorOut_("scene size reported wrongly", 1);
+	s.addObject(make_shared<Rectangle>(Point(-3,60), Point(140,70)));
+	s.addObject(make_shared<Circle>(Point(64,64), 20));
+	s.addObject(make_shared<LineSegment>(Point(63,0), Point(63,89)));
+	s.addObject(make_shared<LineSegment>(Point(0,64), Point(149,64)));
+	s.addObject(make_shared<Point>(149,89));
+	s.addObject(make_shared<Point>(0,0));
+
+	stringstream whole, tiled;
+	whole << s;
+	s.renderTiled(tiled);
+	if (whole.str() != tiled.str())
+		errorOut_("tiled output differs from whole page", 1);
+	if (whole.str().size() != 90*151)
+		errorOut_("page size reported as ", whole.str().size(), 1);
+
+	// cell (x,y) sits on line 89-y, column x
+	string page = whole.str();
+	if (page[0*151+149] != '*' || page[89*151+0] != '*')
+		errorOut_("corner points not drawn", 1);
+	if (page[(89-44)*151+64] != '*' || page[(89-43)*151+64] != ' ')
+		errorOut_("circle bottom drawn wrongly", 1);
+	if (page[(89-30)*151+63] != '*' || page[(89-30)*151+62] != ' ')
+		errorOut_("vertical line drawn wrongly", 1);
+
+	// depth cut off applies to tiles too
+	s.addObject(make_shared<Point>(5,5,3));
+	s.addObject(make_shared<Point>(6,5));
+	s.setDrawDepth(2);
+	stringstream whole2, tiled2;
+	whole2 << s;
+	s.renderTiled(tiled2);
+	page[(89-5)*151+6] = '*';
+	if (whole2.str() != tiled2.str() || whole2.str() != page)
+		errorOut_("depth limit wrong in tiled output", 2);
+
+	try {
+		Scene bad(0, 10);
+		errorOut_("zero width should throw exception", 2);
+	}
+	catch(const std::invalid_argument& e) {}
+
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testF() {
+	funcname_ = "GeometryTester::testF";
+
+	{
+	// same shapes drawn serially and on several threads
+	Scene serial(300, 200), parallel(300, 200);
+	for (int i = 0; i < 400; i++) {
+		int x = (i*37) % 320 - 10, y = (i*53) % 220 - 10;
+		shared_ptr<Shape> shape;
+		switch (i % 4) {
+			case 0: shape = make_shared<Point>(x, y, i % 3); break;
+			case 1: shape = make_shared<LineSegment>(Point(x,y), i%8 == 1 ? Point(x+i%17+1,y) : Point(x,y+i%17+1)); break;
+			case 2: shape = make_shared<Rectangle>(Point(x,y), Point(x+i%9+1,y+i%11+1)); break;
+			default: shape = make_shared<Circle>(Point(x,y), i%13+1); break;
+		}
+		serial.addObject(shape);
+		parallel.addObject(shape);
+	}
+	parallel.setRenderThreads(4);
+	if (parallel.renderThreads() != 4)
+		errorOut_("thread count reported wrongly", 1);
+
+	stringstream one, many;
+	one << serial;
+	many << parallel;
+	if (one.str() != many.str())
+		errorOut_("parallel output differs from serial", 1);
+
+	// 5 by 4 tiles, in order, each drawn by some worker
+	const vector<TileTiming>& t = parallel.tileTimings();
+	if (t.size() != 20)
+		errorOut_("tile timings count ", int(t.size()), 2);
+	for (size_t i = 0; i < t.size(); i++) {
+		if (t[i].tile.x0 != int(i%5)*64 || t[i].tile.y0 != int(i/5)*64
+				|| t[i].thread < 0 || t[i].thread >= 4 || t[i].seconds < 0)
+			errorOut_("bad timing for tile ", int(i), 2);
+	}
+	if (t.back().tile.x1 != 299 || t.back().tile.y1 != 199)
+		errorOut_("last tile not clipped to page", 2);
+
+	// a depth change forces a full redraw on the workers again
+	serial.setDrawDepth(1);
+	parallel.setDrawDepth(1);
+	stringstream one2, many2;
+	one2 << serial;
+	many2 << parallel;
+	if (one2.str() != many2.str() || one2.str() == one.str())
+		errorOut_("parallel output wrong after depth change", 3);
+
+	try {
+		parallel.setRenderThreads(0);
+		errorOut_("zero threads should throw exception", 4);
+	}
+	catch(const std::invalid_argument& e) {}
+
+	}
+
+	passOut_();
+}
+
+namespace {
+
+// A point that counts the instances alive, to see arenas release them
+class CountedPoint : public Point {
+public:
+	CountedPoint(float x, float y) : Point(x, y) { live++; }
+	~CountedPoint() { live--; }
+	static int live;
+};
+
+int CountedPoint::live = 0;
+
+}
+
+void GeometryTester::testG() {
+	funcname_ = "GeometryTester::testG";
+
+	{
+	// arena shapes draw like shared ones
+	Scene shared, pooled;
+	shared.addObject(make_shared<Rectangle>(Point(2,2), Point(12,6)));
+	shared.addObject(make_shared<Circle>(Point(30,10), 5));
+	shared.addObject(make_shared<LineSegment>(Point(40,1), Point(40,18)));
+	shared.addObject(make_shared<Point>(55,15));
+	pooled.emplace<Rectangle>(Point(2,2), Point(12,6));
+	Circle* c = pooled.emplace<Circle>(Point(30,10), 5);
+	pooled.emplace<LineSegment>(Point(40,1), Point(40,18));
+	pooled.emplace<Point>(55,15);
+	stringstream one, two;
+	one << shared;
+	two << pooled;
+	if (one.str() != two.str())
+		errorOut_("arena shapes drawn differently", 1);
+
+	// handles still drive the scene
+	c->translate(-20, 0);
+	stringstream three;
+	three << pooled;
+	vector<Shape*> hits = pooled.query(Point(10,10));
+	if (three.str() == two.str() || hits.size() != 1 || hits[0] != c)
+		errorOut_("scene missed a change made through a handle", 2);
+	}
+
+	{
+	// shapes are released with the scene, across several blocks
+	{
+		Scene s;
+		for (int i = 0; i < 10000; i++)
+			s.emplace<CountedPoint>(i % 60, i % 20);
+		if (CountedPoint::live != 10000)
+			errorOut_("live points ", CountedPoint::live, 3);
+		CountedPoint* first = static_cast<CountedPoint*>(s.query(Point(0,0))[0]);
+		if (first->getX() != 0 || first->getY() != 0)
+			errorOut_("arena shape moved", 3);
+	}
+	if (CountedPoint::live != 0)
+		errorOut_("points left after scene destroyed ", CountedPoint::live, 3);
+
+	// a failed constructor leaves nothing behind
+	ShapeArena arena;
+	try {
+		arena.make<LineSegment>(Point(1,1), Point(2,2));
+		errorOut_("non orthogonal line should throw exception", 4);
+	}
+	catch(const std::invalid_argument& e) {}
+	if (arena.size() != 0)
+		errorOut_("arena kept a failed shape", 4);
+	arena.make<Point>(1, 2);
+	if (arena.size() != 1)
+		errorOut_("arena size reported wrongly", 4);
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testH() {
+	funcname_ = "GeometryTester::testH";
+
+	{
+	// values answer as the shape classes do, before and after transforms
+	vector<shared_ptr<Shape>> shapes;
+	shapes.push_back(make_shared<Point>(3, 4, 2));
+	shapes.push_back(make_shared<LineSegment>(Point(1,5), Point(9,5)));
+	shapes.push_back(make_shared<LineSegment>(Point(2,1), Point(2,8)));
+	shapes.push_back(make_shared<Rectangle>(Point(1,1), Point(8,5)));
+	shapes.push_back(make_shared<Circle>(Point(5,5), 3.5));
+	ShapeValue::Kind kinds[5] = { ShapeValue::POINT, ShapeValue::SEGMENT,
+		ShapeValue::SEGMENT, ShapeValue::RECTANGLE, ShapeValue::CIRCLE };
+
+	for (int step = 0; step < 4; step++) {
+		for (size_t i = 0; i < shapes.size(); i++) {
+			ShapeValue v = shapes[i]->value();
+			if (step == 0 && (v.kind() != kinds[i] || v.depth() != shapes[i]->getDepth()))
+				errorOut_("value of wrong kind or depth for shape ", int(i), 1);
+			for (float x = -1; x <= 11; x += 0.5)
+				for (float y = -1; y <= 11; y += 0.5)
+					if (v.contains(x, y) != shapes[i]->contains(Point(x, y)))
+						errorOut_("value contains() differs for shape ", int(i), 2);
+			BoundingBox a = v.bounds(), b = shapes[i]->bounds();
+			if (a.xMin != b.xMin || a.yMin != b.yMin || a.xMax != b.xMax || a.yMax != b.yMax)
+				errorOut_("value bounds differ for shape ", int(i), 2);
+
+			// the same transform on the value and the shape
+			switch (step) {
+				case 0: v.translate(0.5, -1); shapes[i]->translate(0.5, -1); break;
+				case 1: v.rotate(); shapes[i]->rotate(); break;
+				case 2: v.scale(2); shapes[i]->scale(2); break;
+				default: break;
+			}
+			ShapeValue w = shapes[i]->value();
+			a = v.bounds();
+			b = w.bounds();
+			if (step < 3 && (a.xMin != b.xMin || a.yMin != b.yMin || a.xMax != b.xMax || a.yMax != b.yMax))
+				errorOut_("value transform differs for shape ", int(i), 3);
+		}
+	}
+	ShapeValue c(CircleValue { 0, 0, 2 });
+	if (c.area() != Circle(Point(0,0), 2).area())
+		errorOut_("circle value area wrong", 3);
+	try {
+		c.scale(0);
+		errorOut_("zero factor should throw exception", 3);
+	}
+	catch(const std::invalid_argument& e) {}
+	}
+
+	{
+	// and still after several transforms in a row
+	for (int chain = 0; chain < 4; chain++) {
+		vector<shared_ptr<Shape>> shapes;
+		shapes.push_back(make_shared<LineSegment>(Point(0,0), Point(8,0)));
+		shapes.push_back(make_shared<LineSegment>(Point(3,1), Point(3,6)));
+		shapes.push_back(make_shared<Rectangle>(Point(1,1), Point(8,5)));
+		shapes.push_back(make_shared<Circle>(Point(5,5), 3.5));
+		for (size_t i = 0; i < shapes.size(); i++) {
+			ShapeValue v = shapes[i]->value();
+			for (int step = 0; step < 5; step++) {
+				switch ((chain + step) % 4) {
+					case 0: v.scale(2); shapes[i]->scale(2); break;
+					case 1: v.rotate(); shapes[i]->rotate(); break;
+					case 2: v.scale(1.5); shapes[i]->scale(1.5); break;
+					default: v.translate(1.5, -2); shapes[i]->translate(1.5, -2); break;
+				}
+				BoundingBox a = v.bounds(), b = shapes[i]->bounds();
+				if (a.xMin != b.xMin || a.yMin != b.yMin || a.xMax != b.xMax || a.yMax != b.yMax)
+					errorOut_("value differs after transforms for shape ", int(i), 3);
+				if (fabs(v.area() - shapes[i]->area()) > 1e-3 * v.area())
+					errorOut_("area differs after transforms for shape ", int(i), 3);
+			}
+		}
+		LineSegment* segment = static_cast<LineSegment*>(shapes[0].get());
+		if (segment->length() != segment->value().length())
+			errorOut_("segment length differs after transforms", 3);
+	}
+	}
+
+	{
+	// a scene of values draws like a scene of shapes
+	Scene shapes, values;
+	shapes.addObject(make_shared<Rectangle>(Point(2,2), Point(12,6)));
+	shapes.addObject(make_shared<Circle>(Point(30,10), 5));
+	shapes.addObject(make_shared<LineSegment>(Point(40,1), Point(40,18)));
+	shapes.addObject(make_shared<Point>(55,15));
+	values.add(RectangleValue { 2, 2, 12, 6 });
+	int circle = values.add(CircleValue { 30, 10, 5 });
+	values.add(SegmentValue { 40, 1, 40, 18 });
+	values.add(PointValue { 55, 15 });
+	stringstream one, two;
+	one << shapes;
+	two << values;
+	if (one.str() != two.str() || values.size() != 4)
+		errorOut_("scene of values drawn differently", 4);
+
+	// values are replaced in place, and found by slot
+	ShapeValue moved = values.value(circle);
+	moved.translate(-20, 0);
+	values.setValue(circle, moved);
+	vector<int> slots;
+	values.querySlots(10, 10, slots);
+	if (slots.size() != 1 || slots[0] != circle || !values.query(Point(10,10)).empty())
+		errorOut_("query of values wrong", 5);
+	stringstream three;
+	three << values;
+	if (three.str() == two.str())
+		errorOut_("scene missed a changed value", 5);
+
+	// shapes added by pointer are kept in step and cannot be replaced
+	shared_ptr<Circle> shared = make_shared<Circle>(Point(5,5), 1);
+	values.addObject(shared);
+	shared->scale(3);
+	if (values.value(4).bounds().xMax != 8)
+		errorOut_("value of shared shape not updated", 6);
+	try {
+		values.setValue(4, moved);
+		errorOut_("replacing a shared shape should throw exception", 6);
+	}
+	catch(const std::invalid_argument& e) {}
+	try {
+		values.value(5);
+		errorOut_("missing slot should throw exception", 6);
+	}
+	catch(const std::out_of_range& e) {}
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testI() {
+	funcname_ = "GeometryTester::testI";
+
+	{
+	// deep shapes first: shallower ones after them must still be drawn
+	vector<shared_ptr<Shape>> shapes;
+	for (int i = 0; i < 40; i++) {
+		int depth = 40 - i;
+		shapes.push_back(make_shared<Rectangle>(Point(i, i%20, depth), Point(i+3, i%20+2, depth)));
+	}
+	Scene s;
+	for (const auto& shape : shapes)
+		s.addObject(shape);
+
+	// compare with a scene holding just the shapes at or above depth d
+	auto expect = [&](int d) {
+		Scene fresh;
+		for (const auto& shape : shapes)
+			if (d == 0 || shape->getDepth() <= d)
+				fresh.add(shape->value());
+		stringstream ss;
+		ss << fresh;
+		return ss.str();
+	};
+
+	int depths[6] = { 10, 25, 25, 3, 0, 40 };
+	for (int d : depths) {
+		s.setDrawDepth(d);
+		stringstream ss;
+		ss << s;
+		if (ss.str() != expect(d))
+			errorOut_("wrong shapes drawn at depth ", d, 1);
+	}
+
+	// shapes move between layers as their depth changes
+	s.setDrawDepth(5);
+	stringstream before;
+	before << s;
+	shapes[0]->setDepth(1);
+	shapes[39]->setDepth(30);
+	shapes[20]->setDepth(5);
+	stringstream after;
+	after << s;
+	if (after.str() != expect(5) || after.str() == before.str())
+		errorOut_("shape not moved between layers", 2);
+	shapes[0]->setDepth(7);
+	s.setDrawDepth(7);
+	stringstream again;
+	again << s;
+	if (again.str() != expect(7))
+		errorOut_("shape not moved back between layers", 2);
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testJ() {
+	funcname_ = "GeometryTester::testJ";
+
+	{
+	// the nearest shape wins, whichever was added first
+	Scene a, b;
+	a.setDepthCompositing(true);
+	b.setDepthCompositing(true);
+	int farA = a.addObject(make_shared<Rectangle>(Point(0,0,5), Point(10,10,5)));
+	int nearA = a.addObject(make_shared<Circle>(Point(5,5,1), 3));
+	int nearB = b.addObject(make_shared<Circle>(Point(5,5,1), 3));
+	int farB = b.addObject(make_shared<Rectangle>(Point(0,0,5), Point(10,10,5)));
+	a.setGlyph(farA, '#');
+	a.setGlyph(nearA, 'o');
+	b.setGlyph(farB, '#');
+	b.setGlyph(nearB, 'o');
+	stringstream sa, sb;
+	sa << a;
+	sb << b;
+	string page = sa.str();
+	if (page != sb.str())
+		errorOut_("composited output depends on insertion order", 1);
+	// cell (x,y) sits on line 19-y, column x
+	if (page[(19-5)*61+5] != 'o' || page[(19-1)*61+1] != '#' || page[(19-5)*61+11] != ' ')
+		errorOut_("wrong glyph won", 1);
+	if (a.glyph(nearA) != 'o' || !a.depthCompositing())
+		errorOut_("glyph or mode reported wrongly", 1);
+
+	// equal depths: the shape added last wins
+	Scene c;
+	c.setDepthCompositing(true);
+	c.setGlyph(c.addObject(make_shared<Rectangle>(Point(0,0), Point(4,4))), 'x');
+	c.setGlyph(c.addObject(make_shared<Rectangle>(Point(2,2), Point(6,6))), 'y');
+	stringstream sc;
+	sc << c;
+	if (sc.str()[(19-3)*61+3] != 'y' || sc.str()[(19-1)*61+1] != 'x')
+		errorOut_("tie between equal depths broken wrongly", 2);
+
+	// moving the near shape away uncovers the far one
+	shared_ptr<Circle> circle = make_shared<Circle>(Point(30,10,0), 4);
+	int slot = a.addObject(circle);
+	a.setGlyph(slot, '@');
+	circle->translate(-25, -5);
+	stringstream sa2;
+	sa2 << a;
+	if (sa2.str()[(19-5)*61+5] != '@')
+		errorOut_("moved shape not composited", 3);
+	circle->translate(40, 0);
+	stringstream sa3;
+	sa3 << a;
+	if (sa3.str()[(19-5)*61+5] != 'o' || sa3.str()[(19-5)*61+45] != '@')
+		errorOut_("uncovered shape not redrawn", 3);
+
+	// plain mode is unchanged
+	a.setDepthCompositing(false);
+	stringstream sa4;
+	sa4 << a;
+	if (sa4.str().find_first_not_of(" *\n") != string::npos)
+		errorOut_("glyphs shown without compositing", 4);
+
+	try {
+		a.setGlyph(99, 'z');
+		errorOut_("glyph of missing slot should throw exception", 4);
+	}
+	catch(const std::out_of_range& e) {}
+	}
+
+	{
+	// large pages: whole, incremental, tiled and parallel output agree
+	Scene s(200, 150);
+	s.setDepthCompositing(true);
+	vector<shared_ptr<Shape>> shapes;
+	for (int i = 0; i < 300; i++) {
+		int x = (i*37) % 210 - 5, y = (i*53) % 160 - 5, d = i % 7;
+		shared_ptr<Shape> shape;
+		if (i % 2)
+			shape = make_shared<Circle>(Point(x, y, d), 3 + i % 11);
+		else
+			shape = make_shared<Rectangle>(Point(x, y, d), Point(x + 1 + i % 70, y + 1 + i % 9, d));
+		s.setGlyph(s.addObject(shape), 'a' + i % 26);
+		shapes.push_back(shape);
+	}
+	stringstream first;
+	first << s;
+	for (int i = 0; i < 300; i += 7)
+		shapes[i]->translate(3, -2);
+	shapes[10]->setDepth(0);
+	stringstream incremental, tiled, parallel;
+	incremental << s;
+	s.renderTiled(tiled);
+	s.invalidate();
+	s.setRenderThreads(3);
+	parallel << s;
+	if (incremental.str() == first.str() || incremental.str() != tiled.str()
+			|| incremental.str() != parallel.str())
+		errorOut_("composited outputs disagree", 5);
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testK() {
+	funcname_ = "GeometryTester::testK";
+
+	{
+	// every cell picks the shape whose glyph depth compositing shows
+	Scene s(120, 80), shown(120, 80);
+	shown.setDepthCompositing(true);
+	vector<shared_ptr<Shape>> shapes;
+	for (int i = 0; i < 60; i++) {
+		int x = (i*37) % 130 - 5, y = (i*53) % 90 - 5, d = i % 4;
+		shared_ptr<Shape> shape;
+		switch (i % 3) {
+			case 0: shape = make_shared<Circle>(Point(x, y, d), 2 + i % 9); break;
+			case 1: shape = make_shared<Rectangle>(Point(x, y, d), Point(x + 1 + i % 30, y + 1 + i % 7, d)); break;
+			default: shape = make_shared<LineSegment>(Point(x, y, d), Point(x, y + 1 + i % 40, d)); break;
+		}
+		s.addObject(shape);
+		shown.setGlyph(shown.addObject(shape), '!' + i);
+		shapes.push_back(shape);
+	}
+
+	auto check = [&](unsigned int errBit) {
+		stringstream ss;
+		ss << shown;
+		string page = ss.str();
+		for (int y = 0; y < 80; y++) {
+			for (int x = 0; x < 120; x++) {
+				char glyph = page[(79-y)*121 + x];
+				int slot = s.pick(x, y);
+				if ((glyph == ' ') != (slot == -1) || (slot != -1 && glyph != '!' + slot)) {
+					errorOut_("wrong shape picked at x = ", x, errBit);
+					return;
+				}
+			}
+		}
+	};
+	check(1);
+	if (s.pick(-1, 0) != -1 || s.pick(0, 80) != -1)
+		errorOut_("cell off the page picked", 1);
+
+	// kept up to date as shapes move and layers are hidden
+	for (int i = 0; i < 60; i += 5)
+		shapes[i]->translate(-4, 3);
+	shapes[7]->setDepth(0);
+	check(2);
+	s.setDrawDepth(2);
+	shown.setDrawDepth(2);
+	check(3);
+
+	// the text output is unchanged by picking
+	Scene plain(120, 80);
+	for (const auto& shape : shapes)
+		plain.addObject(shape);
+	plain.setDrawDepth(2);
+	stringstream a, b;
+	a << s;
+	b << plain;
+	if (a.str() != b.str())
+		errorOut_("picking changed the text output", 4);
+	if (s.pickBuffer().width() != 120 || s.pickBuffer().data()[0] != s.pick(0, 0))
+		errorOut_("pick buffer laid out wrongly", 4);
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testL() {
+	funcname_ = "GeometryTester::testL";
+
+	{
+	// circle spans cover exactly the cells the per cell test accepts
+	for (int i = 0; i < 400; i++) {
+		float cx = -3 + (i*7919 % 4000) / 97.0f;
+		float cy = -3 + (i*104729 % 3000) / 101.0f;
+		float r = 0.25f + (i*31 % 200) / 13.0f;
+		if (i % 5 == 0) {
+			cx = int(cx);
+			cy = int(cy);
+			r = 1 + i % 17;
+		}
+		FrameBuffer fb(40, 30), expect(40, 30);
+		if (i % 3 == 0) {
+			fb.setClip(CellRect { 5, 4, 30, 20 });
+			expect.setClip(CellRect { 5, 4, 30, 20 });
+		}
+		ShapeValue(CircleValue { cx, cy, r }).draw(fb);
+		float radSquare = r * r;
+		for (int y = int(ceil(cy - r)); y <= int(floor(cy + r)); y++)
+			for (int x = int(ceil(cx - r)); x <= int(floor(cx + r)); x++)
+				if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= radSquare)
+					expect.plot(x, y);
+		stringstream a, b;
+		fb.write(a);
+		expect.write(b);
+		if (a.str() != b.str()) {
+			errorOut_("circle coverage differs for circle ", i, 1);
+			break;
+		}
+	}
+
+	// circles far larger than the page cost the page's cells, not their
+	// own: a walk across the circle would take seconds here
+	{
+	FrameBuffer fb(80, 40), expect(80, 40);
+	float cx = -1e6f + 40, cy = 20, r = 1e6f;
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < 200; i++)
+		ShapeValue(CircleValue { cx, cy, r }).draw(fb);
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	if (ms > 250)
+		errorOut_("huge circle drawn in ms: ", int(ms), 1);
+	for (int y = 0; y < 40; y++)
+		for (int x = 0; x < 80; x++)
+			if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r)
+				expect.plot(x, y);
+	stringstream a, b;
+	fb.write(a);
+	expect.write(b);
+	if (a.str() != b.str())
+		errorOut_("huge circle drawn as ", "\n" + a.str(), 1);
+	}
+
+	// rectangles cover exactly the cells they contain
+	FrameBuffer fb(20, 20);
+	Rectangle rect(Point(2.5, 3), Point(9, 7.75));
+	rect.draw(fb);
+	stringstream ss;
+	fb.write(ss);
+	for (int y = 0; y < 20; y++)
+		for (int x = 0; x < 20; x++)
+			if ((ss.str()[(19-y)*21 + x] == '*') != rect.contains(Point(x, y)))
+				errorOut_("rectangle coverage differs at x = ", x, 2);
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testM() {
+	funcname_ = "GeometryTester::testM";
+
+	{
+	// the canvas holds exactly the cells of the text output
+	Scene s(150, 70);
+	for (int i = 0; i < 80; i++) {
+		int x = (i*37) % 160 - 5, y = (i*53) % 80 - 5;
+		if (i % 2)
+			s.addObject(make_shared<Circle>(Point(x, y, i % 3), 1 + i % 12));
+		else
+			s.addObject(make_shared<Rectangle>(Point(x, y, i % 3), Point(x + 1 + i % 90, y + 1 + i % 5, i % 3)));
+	}
+	s.setDrawDepth(1);
+	BitCanvas canvas(150, 70);
+	s.render(canvas);
+	stringstream ss;
+	ss << s;
+	size_t inked = 0;
+	for (int y = 0; y < 70; y++)
+		for (int x = 0; x < 150; x++) {
+			bool set = ss.str()[(69-y)*151 + x] == '*';
+			inked += set;
+			if (set != canvas.test(x, y))
+				errorOut_("canvas differs from text at x = ", x, 1);
+		}
+	if (canvas.count() != inked || canvas.wordsPerRow() != 3)
+		errorOut_("canvas count wrong", 1);
+	}
+
+	{
+	// word-parallel operations agree with cell by cell ones
+	BitCanvas a(130, 4), b(130, 4);
+	a.fillSpan(0, 0, 129);
+	a.fillSpan(1, 60, 70);
+	a.fillSpan(2, 64, 127);
+	a.plot(129, 3);
+	b.fillSpan(0, 63, 64);
+	b.fillSpan(1, 0, 65);
+	b.fillSpan(2, 100, 200);
+	b.fillSpan(3, -5, 3);
+	if (a.count() != 130 + 11 + 64 + 1 || b.count() != 2 + 66 + 30 + 4)
+		errorOut_("span fills counted wrongly", 2);
+	if (a.test(128, 2) || !a.test(127, 2) || a.test(59, 1) || !b.test(129, 2) || b.test(130, 2))
+		errorOut_("span ends wrong", 2);
+
+	BitCanvas both = a, either = a, only = a;
+	both.intersect(b);
+	either.unite(b);
+	only.subtract(b);
+	size_t common = 0, any = 0, left = 0;
+	for (int y = 0; y < 4; y++)
+		for (int x = 0; x < 130; x++) {
+			bool in = a.test(x, y), other = b.test(x, y);
+			common += in && other;
+			any += in || other;
+			left += in && !other;
+			if (both.test(x, y) != (in && other) || either.test(x, y) != (in || other)
+					|| only.test(x, y) != (in && !other))
+				errorOut_("boolean operation wrong at x = ", x, 3);
+		}
+	if (both.count() != common || either.count() != any || only.count() != left
+			|| a.countCommon(b) != common)
+		errorOut_("boolean operation counted wrongly", 3);
+
+	try {
+		BitCanvas c(129, 4);
+		a.unite(c);
+		errorOut_("different sizes should throw exception", 4);
+	}
+	catch(const std::invalid_argument& e) {}
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testN() {
+	funcname_ = "GeometryTester::testN";
+
+	const char* path = "GeometryTester.scene";
+	{
+	// a saved scene loads back shape for shape and draws the same
+	Scene s(90, 40);
+	s.addObject(make_shared<Point>(3, 4, 2));
+	s.addObject(make_shared<LineSegment>(Point(1.5, 7, 0), Point(20, 7, 0)));
+	s.addObject(make_shared<Rectangle>(Point(10, 10, 1), Point(30, 25, 1)));
+	s.addObject(make_shared<Circle>(Point(60.25, 20, 3), 11.5));
+	s.add(ShapeValue(CircleValue { 0.1f, 0.3f, 0.7f }, 5));
+	s.add(ShapeValue(SegmentValue { 40, -3, 40, 50 }, 0));
+	SceneFile::write(s, path);
+
+	SceneFile file(path);
+	if (file.size() != 6 || file.width() != 90 || file.height() != 40)
+		errorOut_("file header wrong", 1);
+	if (file.kinds()[3] != ShapeValue::CIRCLE || file.r()[3] != 11.5f || file.x0()[3] != 60.25f
+			|| file.depths()[2] != 1 || file.y1()[1] != 7)
+		errorOut_("file columns wrong", 1);
+	Scene t(file);
+	if (t.size() != s.size())
+		errorOut_("loaded scene size wrong", 2);
+	for (int i = 0; i < s.size() && i < t.size(); i++) {
+		const ShapeValue& a = s.value(i);
+		const ShapeValue& b = t.value(i);
+		BoundingBox ab = a.bounds(), bb = b.bounds();
+		if (a.kind() != b.kind() || a.depth() != b.depth() || ab.xMin != bb.xMin || ab.yMin != bb.yMin
+				|| ab.xMax != bb.xMax || ab.yMax != bb.yMax || a.area() != b.area())
+			errorOut_("loaded shape differs in slot ", i, 2);
+	}
+	stringstream before, after;
+	before << s;
+	after << t;
+	if (before.str() != after.str())
+		errorOut_("loaded scene draws differently", 3);
+
+	// points tested on the columns in place agree with the values, over
+	// several words of entries
+	Scene many(90, 40);
+	for (int i = 0; i < 150; i++) {
+		float x = (i * 37) % 80 - 2, y = (i * 53) % 35 - 2;
+		many.add((i % 4 == 0) ? ShapeValue(CircleValue { x + 0.5f, y, 0.5f + i % 6 })
+			: (i % 4 == 1) ? ShapeValue(RectangleValue { x, y, x + 1 + i % 9, y + 1 + i % 5 })
+			: (i % 4 == 2) ? ShapeValue(SegmentValue { x, y, x, y + 1 + i % 7 })
+			: ShapeValue(PointValue { float(int(x)), float(int(y)) }));
+	}
+	SceneFile::write(many, path);
+	SceneFile manyFile(path);
+	bool agree = true;
+	for (float y = -3; y <= 40 && agree; y += 0.5f)
+		for (float x = -3; x <= 90 && agree; x += 0.5f) {
+			vector<int> found, expected;
+			manyFile.containing(x, y, found);
+			for (int i = 0; i < many.size(); i++)
+				if (many.value(i).contains(x, y))
+					expected.push_back(i);
+			agree = (found == expected);
+		}
+	if (!agree)
+		errorOut_("mapped containment wrong", 3);
+
+	// an empty scene round-trips too
+	Scene empty(5, 5);
+	SceneFile::write(empty, path);
+	SceneFile none(path);
+	Scene u(none);
+	if (none.size() != 0 || u.size() != 0 || u.width() != 5)
+		errorOut_("empty scene wrong", 4);
+	}
+
+	{
+	// damaged or missing files are refused
+	Scene s(20, 20);
+	s.add(ShapeValue(RectangleValue { 1, 1, 5, 5 }, 0));
+	SceneFile::write(s, path);
+	fstream f(path, ios::in | ios::out | ios::binary);
+	f.seekp(192);
+	f.put(7);
+	f.close();
+	try {
+		SceneFile file(path);
+		errorOut_("changed file should throw exception", 5);
+	}
+	catch(const std::invalid_argument& e) {}
+
+	ofstream g(path, ios::binary | ios::trunc);
+	g << "GEOSCENE but not really";
+	g.close();
+	try {
+		SceneFile file(path);
+		errorOut_("short file should throw exception", 5);
+	}
+	catch(const std::invalid_argument& e) {}
+
+	std::remove(path);
+	try {
+		SceneFile file(path);
+		errorOut_("missing file should throw exception", 6);
+	}
+	catch(const std::runtime_error& e) {}
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testO() {
+	funcname_ = "GeometryTester::testO";
+
+	const string text =
+		"# shapes for testO\n"
+		"point 3 4 2\n"
+		"segment 20 7 1.5 7 0\n"
+		"\trect 10 25   30 10 1\r\n"
+		"circle 60.25 20 11.5 3\n"
+		"circle 1e1 -2.5E+0 0.125 0\n"
+		"\n"
+		"segment 0 0 5 5 0\n"
+		"rect 1 1 1 5 0\n"
+		"circle 5 5 -2 0\n"
+		"point 1 2 -1\n"
+		"hexagon 1 2 3\n"
+		"point 1 2x 0\n"
+		"point 1 2\n"
+		"segment 4 4 4 4 0\n"
+		"rect 1 1 5 5 0 7\n"
+		"point 0.1 16777217 0";
+
+	{
+	// records are read as the constructors would build them, and bad
+	// ones are reported by line whatever the chunk boundaries
+	Scene expected(90, 40);
+	expected.addObject(make_shared<Point>(3, 4, 2));
+	expected.addObject(make_shared<LineSegment>(Point(20, 7, 0), Point(1.5, 7, 0)));
+	expected.addObject(make_shared<Rectangle>(Point(10, 25, 1), Point(30, 10, 1)));
+	expected.addObject(make_shared<Circle>(Point(60.25, 20, 3), 11.5));
+	expected.addObject(make_shared<Circle>(Point(10, -2.5, 0), 0.125));
+	expected.addObject(make_shared<Point>(0.1f, 16777217.0f, 0));
+
+	const size_t bad[10] = { 8, 9, 10, 11, 12, 13, 14, 15, 16, 0 };
+	const size_t pieces[4] = { 1, 7, 40, 4096 };
+	for (size_t piece : pieces) {
+		Scene s(90, 40);
+		SceneReader reader(s);
+		for (size_t at = 0; at < text.size(); at += piece)
+			reader.feed(text.data() + at, min(piece, text.size() - at));
+		reader.finish();
+		if (reader.lines() != 17 || reader.added() != 6 || reader.errorCount() != 9)
+			errorOut_("wrong counts with pieces of ", piece, 1);
+		for (size_t i = 0; i < 9; i++)
+			if (reader.errors()[i].line != bad[i])
+				errorOut_("error reported on wrong line, pieces of ", piece, 2);
+		if (s.size() != expected.size())
+			errorOut_("wrong number of shapes, pieces of ", piece, 3);
+		for (int i = 0; i < s.size() && i < expected.size(); i++) {
+			BoundingBox a = s.value(i).bounds(), b = expected.value(i).bounds();
+			if (s.value(i).kind() != expected.value(i).kind() || s.value(i).depth() != expected.value(i).depth()
+					|| a.xMin != b.xMin || a.yMin != b.yMin || a.xMax != b.xMax || a.yMax != b.yMax)
+				errorOut_("shape read differs in slot ", i, 3);
+		}
+	}
+	}
+
+	{
+	// numbers of any length that fits a line are read, as strtof reads them
+	Scene s;
+	SceneReader reader(s);
+	istringstream in("point 3." + string(70, '0') + "1 0." + string(66, '0') + "1 0\n"
+		"circle 1" + string(70, '0') + "e-70 2." + string(80, '5') + " 0.5 0\n");
+	if (reader.read(in) != 2 || !reader.errors().empty())
+		errorOut_("long numbers refused", 6);
+	else if (s.value(0).bounds().xMin != 3 || s.value(0).bounds().yMin != 0
+			|| s.value(1).bounds().xMin != 0.5f || s.value(1).bounds().yMin != strtof(("2." + string(80, '5')).c_str(), nullptr) - 0.5f)
+		errorOut_("long numbers read wrong", 6);
+	}
+
+	{
+	// the messages are the constructors' own
+	Scene s;
+	SceneReader reader(s);
+	istringstream in(text);
+	if (reader.read(in) != 6 || reader.errors().size() != 9)
+		errorOut_("read() counts wrong", 4);
+	const char* messages[9] = { "Line is not orthogonal", "Two points of X-coord are same.",
+		"Circle of zero or negative radius.", "Negative depth is not accepted.",
+		"unknown shape kind.", "bad number.", "wrong number of fields.",
+		"Two endpoints are same.", "wrong number of fields." };
+	for (size_t i = 0; i < 9 && i < reader.errors().size(); i++)
+		if (string(reader.errors()[i].message) != messages[i])
+			errorOut_("wrong message for line ", reader.errors()[i].line, 4);
+	}
+
+	{
+	// only maxErrors errors are kept, and chunk size must be positive
+	Scene s;
+	SceneReader reader(s, 16);
+	string junk;
+	for (int i = 0; i < 300; i++)
+		junk += (i % 3) ? "nothing\n" : "point 1 2 3 4 5 6 7 8 9 10 11 12\n";
+	istringstream in(junk);
+	reader.read(in);
+	if (reader.errorCount() != 300 || reader.errors().size() != SceneReader::maxErrors
+			|| reader.errors()[0].line != 1 || string(reader.errors()[0].message) != "line too long.")
+		errorOut_("error list not bounded", 5);
+	try {
+		SceneReader none(s, 0);
+		errorOut_("zero chunk size should throw exception", 5);
+	}
+	catch(const std::invalid_argument& e) {}
+	}
+
+	passOut_();
+}
+
+namespace {
+
+// Return true if a and b are the same shape at the same depth
+bool sameValue(const ShapeValue& a, const ShapeValue& b) {
+	BoundingBox ab = a.bounds(), bb = b.bounds();
+	return a.kind() == b.kind() && a.depth() == b.depth() && ab.xMin == bb.xMin && ab.yMin == bb.yMin
+		&& ab.xMax == bb.xMax && ab.yMax == bb.yMax && a.area() == b.area();
+}
+
+// Return true if r holds what making shape() gives: the same value, or
+// a failure with the message it throws
+template <class Make>
+bool agrees(const ShapeResult& r, Make shape) {
+	try {
+		ShapeValue v = shape();
+		return r.ok() && r.error() == ShapeError::NONE && sameValue(r.value(), v);
+	}
+	catch(const std::invalid_argument& e) {
+		return !r.ok() && string(shapeErrorMessage(r.error())) == e.what();
+	}
+}
+
+}
+
+void GeometryTester::testP() {
+	funcname_ = "GeometryTester::testP";
+
+	struct Case { float x1, y1, x2, y2; int d1, d2; };
+	const Case cases[10] = {
+		{ 1, 2, 5, 2, 0, 0 }, { 5, 2, 1, 2, 3, 3 }, { 1, 2, 1, 9, 0, 0 }, { 1, 2, 5, 6, 0, 0 },
+		{ 1, 2, 1, 2, 0, 0 }, { 1, 2, 5, 2, 0, 1 }, { 1, 2, 5, 6, 0, 1 }, { 1, 2, 1, 2, 1, 0 },
+		{ 1, 2, 5, 6, -1, -1 }, { 4, 2, 1, -6, 2, 2 }
+	};
+
+	{
+	// every factory agrees with its constructor, failures included
+	for (int i = 0; i < 10; i++) {
+		const Case& c = cases[i];
+		if (!agrees(makePoint(c.x1, c.y1, c.d1), [&]() { return Point(c.x1, c.y1, c.d1).value(); }))
+			errorOut_("makePoint disagrees in case ", i, 1);
+		if (!agrees(makeLineSegment(c.x1, c.y1, c.x2, c.y2, c.d1),
+				[&]() { return LineSegment(Point(c.x1, c.y1, c.d1), Point(c.x2, c.y2, c.d1)).value(); }))
+			errorOut_("makeLineSegment disagrees in case ", i, 2);
+		if (!agrees(makeRectangle(c.x1, c.y1, c.x2, c.y2, c.d1),
+				[&]() { return Rectangle(Point(c.x1, c.y1, c.d1), Point(c.x2, c.y2, c.d1)).value(); }))
+			errorOut_("makeRectangle disagrees in case ", i, 3);
+		if (!agrees(makeCircle(c.x1, c.y1, c.x2 - 3, c.d1),
+				[&]() { return Circle(Point(c.x1, c.y1, c.d1), c.x2 - 3).value(); }))
+			errorOut_("makeCircle disagrees in case ", i, 4);
+		if (c.d1 < 0 || c.d2 < 0)
+			continue;
+		Point p(c.x1, c.y1, c.d1), q(c.x2, c.y2, c.d2);
+		if (!agrees(makeLineSegment(p, q), [&]() { return LineSegment(p, q).value(); })
+				|| !agrees(makeRectangle(p, q), [&]() { return Rectangle(p, q).value(); })
+				|| !agrees(makeCircle(p, c.y2), [&]() { return Circle(p, c.y2).value(); }))
+			errorOut_("factory of points disagrees in case ", i, 5);
+	}
+	if (makeLineSegment(Point(1, 2, 0), Point(5, 2, 1)).error() != ShapeError::DEPTH_MISMATCH
+			|| makeCircle(0, 0, 0).error() != ShapeError::NON_POSITIVE_RADIUS
+			|| makeRectangle(1, 1, 3, 1).error() != ShapeError::SAME_Y)
+		errorOut_("wrong error code", 6);
+	}
+
+	{
+	// the batch makes the same shapes as the single factories
+	vector<ShapeArgs> args;
+	for (int i = 0; i < 10; i++) {
+		const Case& c = cases[i];
+		for (int k = 0; k < 4; k++)
+			args.push_back(ShapeArgs { ShapeValue::Kind(k), c.d1, c.x1, c.y1, c.x2, c.y2, c.x2 - 3 });
+	}
+	vector<ShapeError> errors(args.size());
+	vector<ShapeValue> made;
+	size_t count = makeShapes(args.data(), args.size(), errors.data(), made);
+	size_t next = 0;
+	for (size_t i = 0; i < args.size(); i++) {
+		const ShapeArgs& a = args[i];
+		ShapeResult r = (a.kind == ShapeValue::POINT) ? makePoint(a.x0, a.y0, a.depth)
+			: (a.kind == ShapeValue::SEGMENT) ? makeLineSegment(a.x0, a.y0, a.x1, a.y1, a.depth)
+			: (a.kind == ShapeValue::RECTANGLE) ? makeRectangle(a.x0, a.y0, a.x1, a.y1, a.depth)
+			: makeCircle(a.x0, a.y0, a.r, a.depth);
+		if (r.error() != errors[i])
+			errorOut_("batch error differs at ", i, 7);
+		if (r.ok() && (next >= made.size() || !sameValue(r.value(), made[next++])))
+			errorOut_("batch shape differs at ", i, 7);
+	}
+	if (count != next || made.size() != next)
+		errorOut_("batch count wrong", 7);
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testQ() {
+	funcname_ = "GeometryTester::testQ";
+
+	{
+	// batches give the same scene as changing the shapes one at a time
+	Scene s(120, 50), t(120, 50);
+	for (int i = 0; i < 300; i++) {
+		float x = (i * 37) % 130 - 5, y = (i * 53) % 60 - 5;
+		ShapeValue v = (i % 3 == 0) ? ShapeValue(CircleValue { x, y, 1.5f + i % 7 }, i % 4)
+			: (i % 3 == 1) ? ShapeValue(RectangleValue { x, y, x + 2 + i % 9, y + 1 + i % 4 }, i % 4)
+			: ShapeValue(SegmentValue { x, y, x + 1 + i % 11, y }, i % 4);
+		s.add(v);
+		t.add(v);
+	}
+	s.setDrawDepth(2);
+	t.setDrawDepth(2);
+	stringstream first;
+	first << s << t;
+
+	vector<int> some, odd;
+	for (int i = 0; i < 300; i += 3)
+		some.push_back(i);
+	for (int i = 1; i < 300; i += 2)
+		odd.push_back(i);
+	some.push_back(9);
+	s.translate(some, 3, -2);
+	s.scale(odd, 1.5f);
+	s.rotate(some);
+	for (int slot : some) {
+		ShapeValue v = t.value(slot);
+		v.translate(3, -2);
+		t.setValue(slot, v);
+	}
+	for (int slot : odd) {
+		ShapeValue v = t.value(slot);
+		v.scale(1.5f);
+		t.setValue(slot, v);
+	}
+	for (int slot : some) {
+		ShapeValue v = t.value(slot);
+		v.rotate();
+		t.setValue(slot, v);
+	}
+	stringstream a, b;
+	a << s;
+	b << t;
+	if (a.str() != b.str())
+		errorOut_("batched scene draws differently", 1);
+	for (int i = 0; i < 300; i++) {
+		BoundingBox x = s.value(i).bounds(), y = t.value(i).bounds();
+		if (x.xMin != y.xMin || x.yMin != y.yMin || x.xMax != y.xMax || x.yMax != y.yMax)
+			errorOut_("batched shape differs in slot ", i, 1);
+	}
+	for (int x = 0; x < 120; x += 7)
+		for (int y = 0; y < 50; y += 3) {
+			vector<int> p, q;
+			s.querySlots(x, y, p);
+			t.querySlots(x, y, q);
+			sort(p.begin(), p.end());
+			sort(q.begin(), q.end());
+			if (p != q)
+				errorOut_("index not updated at x = ", x, 2);
+		}
+	s.invalidate();
+	stringstream c;
+	c << s;
+	if (c.str() != a.str())
+		errorOut_("incremental frame differs from full redraw", 2);
+	}
+
+	{
+	// bad slots change nothing
+	Scene s(20, 20);
+	s.add(ShapeValue(PointValue { 1, 1 }));
+	s.addObject(make_shared<Point>(2, 2));
+	try {
+		s.translate({ 0, 1 }, 1, 1);
+		errorOut_("pointer slot should throw exception", 3);
+	}
+	catch(const std::invalid_argument& e) {}
+	try {
+		s.rotate({ 0, 2 });
+		errorOut_("missing slot should throw exception", 3);
+	}
+	catch(const std::out_of_range& e) {}
+	try {
+		s.scale({ 0 }, 0);
+		errorOut_("zero factor should throw exception", 3);
+	}
+	catch(const std::invalid_argument& e) {}
+	if (s.value(0).bounds().xMin != 1)
+		errorOut_("failed batch changed a shape", 3);
+	}
+
+	{
+	// a large batch split across threads moves every shape once per listing
+	Scene s(200, 200);
+	vector<int> slots;
+	for (int i = 0; i < 70000; i++) {
+		s.add(ShapeValue(RectangleValue { float(i % 190), float(i % 180), float(i % 190 + 3), float(i % 180 + 2) }));
+		slots.push_back(i);
+	}
+	slots.push_back(5);
+	s.setRenderThreads(4);
+	s.translate(slots, 2, 1);
+	for (int i = 0; i < 70000; i++) {
+		float expected = i % 190 + ((i == 5) ? 4 : 2);
+		if (s.value(i).bounds().xMin != expected)
+			errorOut_("threaded batch wrong in slot ", i, 4);
+	}
+	vector<int> hits;
+	s.querySlots(11.5f, 8.5f, hits);
+	if (find(hits.begin(), hits.end(), 5) == hits.end())
+		errorOut_("index not rebuilt after threaded batch", 4);
+
+	// in any order, with slots listed again at either end of every range
+	vector<int> reversed(slots.rbegin() + 1, slots.rend());
+	for (int slot : { 0, 23333, 23334, 46667, 46668, 69999 })
+		reversed.push_back(slot);
+	s.setRenderThreads(3);
+	s.translate(reversed, -2, 0);
+	for (int i = 0; i < 70000; i++) {
+		bool twice = i == 0 || i == 23333 || i == 23334 || i == 46667 || i == 46668 || i == 69999;
+		float expected = i % 190 + ((i == 5) ? 2 : twice ? -2 : 0);
+		if (s.value(i).bounds().xMin != expected)
+			errorOut_("unordered threaded batch wrong in slot ", i, 4);
+	}
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testR() {
+	funcname_ = "GeometryTester::testR";
+
+	const ShapeValue shapes[4] = {
+		ShapeValue(PointValue { 3, 4 }, 1),
+		ShapeValue(SegmentValue { 2, 6, 10, 6 }, 0),
+		ShapeValue(RectangleValue { 0, 0, 4, 2 }, 2),
+		ShapeValue(CircleValue { 5, 5, 2 }, 0)
+	};
+
+	{
+	// where nothing needs truncating, a composed chain matches the calls
+	// made one at a time
+	for (int k = 0; k < 4; k++) {
+		ShapeValue eager = shapes[k];
+		LazyShape lazy(shapes[k]);
+		for (int i = 0; i < 6; i++) {
+			eager.translate(i, -2 * i);
+			lazy.translate(i, -2 * i);
+			eager.rotate();
+			lazy.rotate();
+			if (i % 3 == 1) {
+				eager.scale(2);
+				lazy.scale(2);
+			}
+		}
+		BoundingBox a = eager.bounds(), b = lazy.bounds();
+		if (a.xMin != b.xMin || a.yMin != b.yMin || a.xMax != b.xMax || a.yMax != b.yMax
+				|| lazy.value().kind() != eager.kind() || lazy.value().depth() != eager.depth()
+				|| lazy.area() != eager.area())
+			errorOut_("composed chain differs for kind ", k, 1);
+		if (lazy.contains(a.xMin, a.yMin) != eager.contains(a.xMin, a.yMin))
+			errorOut_("contains differs for kind ", k, 1);
+	}
+	}
+
+	{
+	// nothing is truncated along the way
+	LazyShape r(ShapeValue(RectangleValue { 0, 0, 3, 1 }));
+	r.rotate();
+	BoundingBox b = r.bounds();
+	if (b.xMin != 1 || b.xMax != 2 || b.yMin != -1 || b.yMax != 2)
+		errorOut_("rotation rounded", 2);
+	r.scale(4);
+	r.rotate();
+	r.scale(0.25f);
+	b = r.bounds();
+	if (b.xMin != 0 || b.xMax != 3 || b.yMin != 0 || b.yMax != 1)
+		errorOut_("chain does not return the rectangle", 2);
+	for (int i = 0; i < 1000; i++) {
+		r.translate(0.5f, 1);
+		r.translate(-0.5f, -1);
+	}
+	if (!r.pending().isIdentity())
+		errorOut_("long chain not reduced", 2);
+	r.translate(1.25f, 0);
+	r.commit();
+	if (!r.pending().isIdentity() || r.bounds().xMin != 1.25f)
+		errorOut_("commit lost the shape", 2);
+	try {
+		r.scale(0);
+		errorOut_("zero factor should throw exception", 2);
+	}
+	catch(const std::invalid_argument& e) {}
+	}
+
+	{
+	// one chain applied to scene slots as a batch
+	ShapeTransform t, u;
+	t.translate(3, 1);
+	t.scale(1.5f);
+	u.rotate();
+	u.translate(-1, 2.5f);
+	t.then(u);
+	Scene s(40, 40), check(40, 40);
+	vector<int> slots;
+	for (int k = 0; k < 4; k++) {
+		slots.push_back(s.add(shapes[k]));
+		check.add(shapes[k]);
+	}
+	s.transform(slots, t);
+	for (int k = 0; k < 4; k++) {
+		LazyShape lazy(shapes[k]);
+		lazy.translate(3, 1);
+		lazy.scale(1.5f);
+		lazy.rotate();
+		lazy.translate(-1, 2.5f);
+		check.setValue(k, lazy.value());
+	}
+	stringstream a, b;
+	a << s;
+	b << check;
+	if (a.str() != b.str())
+		errorOut_("scene transform draws differently", 3);
+	for (int k = 0; k < 4; k++)
+		if (s.value(k).bounds().xMin != check.value(k).bounds().xMin)
+			errorOut_("scene transform differs in slot ", k, 3);
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testS() {
+	funcname_ = "GeometryTester::testS";
+
+	{
+	// exact tests between kinds, circles open and the rest closed
+	ShapeValue box(RectangleValue { 0, 0, 4, 2 });
+	ShapeValue touching(RectangleValue { 4, 1, 6, 5 });
+	ShapeValue across(SegmentValue { 2, -3, 2, 7 });
+	ShapeValue clear(SegmentValue { 5, -3, 5, -1 });
+	ShapeValue tangent(CircleValue { 7, 1, 3 });
+	ShapeValue corner(CircleValue { 5, 3, 1.5f });
+	ShapeValue cornerFar(CircleValue { 5, 3, 1.4f });
+	ShapeValue near(CircleValue { 10, 1, 3.01f });
+	ShapeValue edge(PointValue { 4, 2 });
+	struct Case { const ShapeValue* a; const ShapeValue* b; bool meet; };
+	const Case cases[12] = {
+		{ &box, &touching, true }, { &box, &across, true }, { &box, &clear, false },
+		{ &box, &tangent, false }, { &box, &corner, true }, { &box, &cornerFar, false },
+		{ &tangent, &near, true }, { &tangent, &corner, true }, { &box, &edge, true },
+		{ &tangent, &edge, false }, { &across, &clear, false }, { &touching, &clear, false }
+	};
+	for (int i = 0; i < 12; i++) {
+		const Case& c = cases[i];
+		if (c.a->intersects(*c.b) != c.meet || c.b->intersects(*c.a) != c.meet)
+			errorOut_("wrong intersection in case ", i, 1);
+	}
+	Rectangle r(Point(0, 0), Point(4, 2));
+	Circle inside(Point(1, 1), 0.5);
+	if (!r.intersects(inside) || r.intersects(Circle(Point(-2, 1), 2)))
+		errorOut_("shape intersection wrong", 1);
+	}
+
+	{
+	// the sweep finds exactly the pairs found by testing every pair, also
+	// after shapes move one at a time, in batches, and a few of them far
+	Scene s(200, 200);
+	vector<int> all;
+	for (int i = 0; i < 400; i++) {
+		float x = (i * 37) % 210 - 5, y = (i * 53) % 205 - 5;
+		ShapeValue v = (i % 4 == 0) ? ShapeValue(CircleValue { x, y, 0.5f + i % 6 }, i % 3)
+			: (i % 4 == 1) ? ShapeValue(RectangleValue { x, y, x + 1 + i % 9, y + 1 + i % 5 })
+			: (i % 4 == 2) ? ShapeValue(SegmentValue { x, y, x, y + 1 + i % 7 })
+			: ShapeValue(PointValue { float(int(x)), float(int(y)) });
+		all.push_back(s.add(v));
+	}
+	for (int round = 0; round < 5; round++) {
+		vector<pair<int, int>> found, expected;
+		s.overlaps(found);
+		for (int a = 0; a < s.size(); a++)
+			for (int b = a + 1; b < s.size(); b++)
+				if (s.value(a).intersects(s.value(b)))
+					expected.push_back(make_pair(a, b));
+		sort(found.begin(), found.end());
+		if (found != expected || expected.empty())
+			errorOut_("wrong pairs in round ", round, 2);
+		if (round == 0) {
+			s.translate(all, 1.5f, -2);
+		} else if (round == 1) {
+			for (int slot = 0; slot < 400; slot += 7) {
+				ShapeValue v = s.value(slot);
+				v.translate(40, 3);
+				s.setValue(slot, v);
+			}
+		} else if (round == 2) {
+			for (int slot = 0; slot < 400; slot += 10) {
+				ShapeValue v = s.value(slot);
+				v.translate((slot % 20 == 0) ? 150 : -150, 0);
+				s.setValue(slot, v);
+			}
+		} else {
+			vector<int> some(all.begin(), all.begin() + 150);
+			s.scale(some, 2);
+		}
+	}
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testT() {
+	funcname_ = "GeometryTester::testT";
+
+	{
+	// the tree finds every box overlapping a window, for any size of tree
+	const size_t sizes[5] = { 0, 1, 16, 17, 1000 };
+	for (size_t n : sizes) {
+		vector<BoundingBox> boxes;
+		for (size_t i = 0; i < n; i++) {
+			float x = (i * 37) % 500, y = (i * 91) % 300;
+			boxes.push_back(BoundingBox { x, y, x + i % 13, y + i % 7 });
+		}
+		PackedRTree tree;
+		tree.build(boxes.data(), n);
+		for (int pass = 0; pass < 2; pass++) {
+			for (int w = 0; w < 40; w++) {
+				BoundingBox window { float(w * 13 % 480), float(w * 7 % 290),
+					float(w * 13 % 480 + w % 60), float(w * 7 % 290 + w % 25) };
+				vector<int> found, expected;
+				tree.visit(window, [&](int id) { found.push_back(id); });
+				for (size_t i = 0; i < n; i++)
+					if (boxes[i].intersects(window))
+						expected.push_back(i);
+				sort(found.begin(), found.end());
+				if (found != expected || tree.size() != n)
+					errorOut_("tree query wrong for size ", n, 1);
+			}
+			/* move everything and refit */
+			for (size_t i = 0; i < n; i++) {
+				boxes[i].xMin += 17 * (i % 3);
+				boxes[i].xMax += 17 * (i % 3);
+			}
+			tree.refit(boxes.data(), n);
+		}
+	}
+	}
+
+	{
+	// the scene finds the shapes meeting a window exactly, after shapes
+	// are added and moved
+	Scene s(300, 300);
+	vector<int> all;
+	for (int round = 0; round < 3; round++) {
+		for (int i = 0; i < 500; i++) {
+			float x = (i * 37 + round * 11) % 310 - 5, y = (i * 53) % 305 - 5;
+			ShapeValue v = (i % 3 == 0) ? ShapeValue(CircleValue { x, y, 0.5f + i % 6 }, i % 3)
+				: (i % 3 == 1) ? ShapeValue(RectangleValue { x, y, x + 1 + i % 9, y + 1 + i % 5 })
+				: ShapeValue(PointValue { x, y });
+			all.push_back(s.add(v));
+		}
+		for (int moved = 0; moved < 2; moved++) {
+			for (int w = 0; w < 30; w++) {
+				float x0 = w * 31 % 290, y0 = w * 17 % 290;
+				float x1 = x0 + w % 40, y1 = y0 + (w * 3) % 30;
+				ShapeValue window(RectangleValue { x0, y0, x1, y1 });
+				vector<int> found, expected;
+				s.queryRange(x0, y0, x1, y1, found);
+				for (int slot = 0; slot < s.size(); slot++)
+					if (s.value(slot).intersects(window))
+						expected.push_back(slot);
+				sort(found.begin(), found.end());
+				if (found != expected)
+					errorOut_("wrong shapes in window ", w, 2);
+			}
+			s.translate(all, 3.5f, -1);
+		}
+	}
+	vector<int> none;
+	s.queryRange(10, 10, 5, 20, none);
+	if (!none.empty())
+		errorOut_("inverted window found shapes", 3);
+	}
+
+	passOut_();
+}
+
+void GeometryTester::testU() {
+	funcname_ = "GeometryTester::testU";
+
+	{
+	// distances to each kind of shape
+	Point p(3, 4);
+	LineSegment l(Point(0, 0), Point(8, 0));
+	Rectangle r(Point(0, 0), Point(8, 4));
+	Circle c(Point(0, 0), 4);
+	if (p.distance(Point(0, 0)) != 5 || p.distance(Point(3, 4)) != 0)
+		errorOut_("point distance wrong", 1);
+	if (l.distance(Point(4, 3)) != 3 || l.distance(Point(11, 4)) != 5 || l.distance(Point(8, 0)) != 0)
+		errorOut_("line distance wrong", 1);
+	if (r.distance(Point(4, 2)) != 0 || r.distance(Point(-3, 2)) != 3 || r.distance(Point(11, 8)) != 5)
+		errorOut_("rectangle distance wrong", 1);
+	if (c.distance(Point(1, 1)) != 0 || c.distance(Point(6, 8)) != 6 || c.distance(Point(0, -4)) != 0)
+		errorOut_("circle distance wrong", 1);
+	}
+
+	{
+	// the nearest shapes are found in order, as a scan of every shape finds
+	// them, as shapes are added and moved
+	Scene s(300, 300);
+	vector<int> none;
+	s.nearest(5, 5, 3, none);
+	if (!none.empty())
+		errorOut_("empty scene has nearest shapes", 2);
+	vector<int> all;
+	for (int round = 0; round < 3; round++) {
+		for (int i = 0; i < (round == 0 ? 1 : 700); i++) {
+			float x = (i * 37 + round * 11) % 310 - 5, y = (i * 53) % 305 - 5;
+			ShapeValue v = (i % 4 == 0) ? ShapeValue(CircleValue { x, y, 0.5f + i % 6 }, i % 3)
+				: (i % 4 == 1) ? ShapeValue(RectangleValue { x, y, x + 1 + i % 9, y + 1 + i % 5 })
+				: (i % 4 == 2) ? ShapeValue(SegmentValue { x, y, x, y + 1 + i % 7 })
+				: ShapeValue(PointValue { x, y });
+			all.push_back(s.add(v));
+		}
+		for (int moved = 0; moved < 2; moved++) {
+			for (int q = 0; q < 40; q++) {
+				float x = q * 29 % 320 - 10.5f, y = q * 13 % 310 - 5.25f;
+				int k = 1 + q % 12;
+				vector<int> found;
+				s.nearest(x, y, k, found);
+				vector<float> expected;
+				for (int slot = 0; slot < s.size(); slot++)
+					expected.push_back(s.value(slot).distance(x, y));
+				sort(expected.begin(), expected.end());
+				expected.resize(min<size_t>(k, expected.size()));
+				if (found.size() != expected.size())
+					errorOut_("wrong number of nearest shapes for k ", k, 3);
+				for (size_t j = 0; j < found.size() && j < expected.size(); j++)
+					if (s.value(found[j]).distance(x, y) != expected[j])
+						errorOut_("nearest shape out of order at ", q, 3);
+			}
+			s.translate(all, 2.5f, 1);
+		}
+	}
+
+	// many points at once agree with one at a time, on any number of threads
+	vector<float> xs, ys;
+	for (int q = 0; q < 5000; q++) {
+		xs.push_back(q * 7 % 300);
+		ys.push_back(q * 11 % 300 + 0.5f);
+	}
+	for (int threads = 1; threads <= 4; threads += 3) {
+		s.setRenderThreads(threads);
+		vector<int> batch;
+		s.nearest(xs.data(), ys.data(), xs.size(), 4, batch);
+		if (batch.size() != xs.size() * 4)
+			errorOut_("batch of wrong size", 4);
+		for (size_t q = 0; q < xs.size(); q += 97) {
+			vector<int> one;
+			s.nearest(xs[q], ys[q], 4, one);
+			for (int j = 0; j < 4; j++)
+				if (s.value(batch[q * 4 + j]).distance(xs[q], ys[q]) != s.value(one[j]).distance(xs[q], ys[q]))
+					errorOut_("batch differs from single query at ", q, 4);
+		}
+	}
+
+	// rows are padded when there are fewer shapes than asked for
+	Scene few(10, 10);
+	few.add(ShapeValue(PointValue { 1, 1 }));
+	vector<int> padded;
+	few.nearest(xs.data(), ys.data(), 2, 3, padded);
+	if (padded != vector<int> { 0, -1, -1, 0, -1, -1 })
+		errorOut_("rows not padded", 5);
+	try {
+		few.nearest(0, 0, 0, padded);
+		errorOut_("zero k accepted", 5);
+	} catch (invalid_argument&) {
+	}
+	}
+
+	passOut_();
+}
+
+namespace {
+
+// Shapes on whole and half co-ordinates, which every scalar type holds
+// exactly
+template <class T>
+vector<BasicShapeValue<T>> halfGridShapes() {
+	auto t = [](double v) { return T(v); };
+	return vector<BasicShapeValue<T>> {
+		BasicShapeValue<T>(BasicPointValue<T> { t(3), t(4) }),
+		BasicShapeValue<T>(BasicPointValue<T> { t(3.5), t(4) }),
+		BasicShapeValue<T>(BasicSegmentValue<T> { t(2), t(5), t(9.5), t(5) }),
+		BasicShapeValue<T>(BasicSegmentValue<T> { t(6), t(1.5), t(6), t(8) }),
+		BasicShapeValue<T>(BasicRectangleValue<T> { t(1.5), t(2), t(8), t(6.5) }),
+		BasicShapeValue<T>(BasicRectangleValue<T> { t(3), t(3), t(10), t(8) }),
+		BasicShapeValue<T>(BasicCircleValue<T> { t(6), t(5), t(3.5) }),
+		BasicShapeValue<T>(BasicCircleValue<T> { t(4.5), t(4.5), t(2) })
+	};
+}
+
+// Return the page the shapes draw, then for each shape its bounds and
+// the points of a half grid it contains
+template <class T>
+string describe(const vector<BasicShapeValue<T>>& shapes) {
+	ostringstream out;
+	FrameBuffer fb(16, 14, -1, -1);
+	for (const auto& v : shapes)
+		v.draw(fb);
+	fb.write(out);
+	for (const auto& v : shapes) {
+		BasicBoundingBox<T> b = v.bounds();
+		out << double(b.xMin) << ' ' << double(b.yMin) << ' ' << double(b.xMax) << ' ' << double(b.yMax) << ' ';
+		for (int y = -2; y <= 26; y++)
+			for (int x = -2; x <= 26; x++)
+				out << v.contains(T(x / 2.0), T(y / 2.0));
+		out << '\n';
+	}
+	return out.str();
+}
+
+// Change every shape as change does, and return describe() of the result
+template <class T, class Change>
+string describeChanged(vector<BasicShapeValue<T>> shapes, Change change) {
+	for (auto& v : shapes)
+		change(v);
+	return describe(shapes);
+}
+
+}
+
+void GeometryTester::testV() {
+	funcname_ = "GeometryTester::testV";
+
+	{
+	// fixed point arithmetic
+	Fixed16 a(2.5), b(-3);
+	if (a * 4 != 10 || b / 2 != Fixed16(-1.5) || a + b != Fixed16(-0.5) || -a != Fixed16(-2.5))
+		errorOut_("fixed point arithmetic wrong", 1);
+	if (scalar::floorInt(Fixed16(-1.5)) != -2 || scalar::ceilInt(Fixed16(-1.5)) != -1
+		|| scalar::floorInt(a) != 2 || scalar::ceilInt(a) != 3 || scalar::ceilInt(b) != -3)
+		errorOut_("fixed point rounding wrong", 1);
+	if (scalar::truncate(Fixed16(-2.75)) != -2 || scalar::truncate(Fixed16(2.75)) != 2)
+		errorOut_("fixed point truncation wrong", 1);
+	if (scalar::root(scalar::square(Fixed16(3)) + scalar::square(Fixed16(4))) != 5
+		|| scalar::root(scalar::square(Fixed16(0.5))) != Fixed16(0.5))
+		errorOut_("fixed point root wrong", 1);
+	}
+
+	{
+	// every scalar type draws, bounds and contains alike, before and after
+	// rotating and scaling
+	string expected = describe(halfGridShapes<float>());
+	if (describe(halfGridShapes<double>()) != expected || describe(halfGridShapes<Fixed16>()) != expected)
+		errorOut_("scalar types disagree", 2);
+	auto rotate = [](auto& v) { v.rotate(); };
+	expected = describeChanged(halfGridShapes<float>(), rotate);
+	if (describeChanged(halfGridShapes<double>(), rotate) != expected
+		|| describeChanged(halfGridShapes<Fixed16>(), rotate) != expected)
+		errorOut_("scalar types disagree after rotate", 2);
+	auto scale = [](auto& v) { v.scale(1.5); };
+	auto scaleFixed = [](BasicShapeValue<Fixed16>& v) { v.scale(Fixed16(1.5)); };
+	expected = describeChanged(halfGridShapes<float>(), scale);
+	if (describeChanged(halfGridShapes<double>(), scale) != expected
+		|| describeChanged(halfGridShapes<Fixed16>(), scaleFixed) != expected)
+		errorOut_("scalar types disagree after scale", 2);
+	}
+
+	{
+	// distances and areas agree to the precision of fixed point
+	vector<BasicShapeValue<float>> floats = halfGridShapes<float>();
+	vector<BasicShapeValue<Fixed16>> fixeds = halfGridShapes<Fixed16>();
+	for (size_t i = 0; i < floats.size(); i++) {
+		if (fabs(floats[i].area() - double(fixeds[i].area())) > 1e-3)
+			errorOut_("areas disagree for shape ", i, 3);
+		for (int q = 0; q < 20; q++) {
+			float x = q * 0.75f - 2, y = q * 1.25f - 4;
+			if (fabs(floats[i].distance(x, y) - double(fixeds[i].distance(Fixed16(x), Fixed16(y)))) > 1e-4)
+				errorOut_("distances disagree for shape ", i, 3);
+		}
+	}
+	try {
+		fixeds[0].scale(0);
+		errorOut_("zero factor accepted", 3);
+	} catch (invalid_argument&) {
+	}
+	}
+
+	{
+	// double keeps apart large co-ordinates float cannot
+	BasicShapeValue<double> far(BasicRectangleValue<double> { 1e9, 1e9, 1e9 + 1, 1e9 + 1 });
+	if (far.contains(1e9 + 1.5, 1e9) || !far.contains(1e9 + 0.5, 1e9 + 1) || far.distance(1e9 + 4, 1e9 + 5) != 5)
+		errorOut_("double shape wrong at large co-ordinates", 4);
+	}
+
+	{
+	// edges far beyond int saturate when rounded, and draw as edges just
+	// off the page do
+	static_assert(scalar::floorInt(-1e10) == numeric_limits<int>::min()
+		&& scalar::ceilInt(1e30f) == numeric_limits<int>::max(), "rounding does not saturate");
+	if (scalar::floorInt(NAN) != numeric_limits<int>::min() || scalar::ceilInt(NAN) != numeric_limits<int>::max()
+		|| scalar::ceilInt(-2147483648.5) != numeric_limits<int>::min()
+		|| scalar::floorInt(2147483647.5) != numeric_limits<int>::max())
+		errorOut_("rounding wrong at the ends of int", 5);
+	Scene huge(Scene::WIDTH, Scene::HEIGHT), near(Scene::WIDTH, Scene::HEIGHT);
+	huge.add(ShapeValue(RectangleValue { -1e10f, 2, 10, 5 }));
+	huge.add(ShapeValue(SegmentValue { -1e10f, 8, 1e10f, 8 }));
+	huge.add(ShapeValue(SegmentValue { 40, -1e10f, 40, 1e10f }));
+	huge.add(ShapeValue(RectangleValue { 50, 12, 1e30f, 1e30f }));
+	near.add(ShapeValue(RectangleValue { -1, 2, 10, 5 }));
+	near.add(ShapeValue(SegmentValue { -1, 8, 61, 8 }));
+	near.add(ShapeValue(SegmentValue { 40, -1, 40, 21 }));
+	near.add(ShapeValue(RectangleValue { 50, 12, 61, 21 }));
+	ostringstream hugeOut, nearOut;
+	hugeOut << huge;
+	nearOut << near;
+	if (hugeOut.str() != nearOut.str())
+		errorOut_("huge shapes drawn as ", "\n" + hugeOut.str(), 5);
+	FrameBuffer fb(Scene::WIDTH, Scene::HEIGHT);
+	BasicShapeValue<double>(BasicRectangleValue<double> { -1e10, 2, 10, 5 }).draw(fb);
+	BasicShapeValue<double>(BasicSegmentValue<double> { -1e10, 8, 1e10, 8 }).draw(fb);
+	BasicShapeValue<double>(BasicSegmentValue<double> { 40, -1e10, 40, 1e10 }).draw(fb);
+	BasicShapeValue<double>(BasicRectangleValue<double> { 50, 12, 1e30, 1e30 }).draw(fb);
+	ostringstream doubleOut;
+	fb.write(doubleOut);
+	if (doubleOut.str() != nearOut.str())
+		errorOut_("huge double shapes drawn as ", "\n" + doubleOut.str(), 5);
+	}
+
+	passOut_();
+}
+
+namespace {
+
+// A frame, crosshair and panel that never move, checked and drawn while
+// compiling
+constexpr ShapeValue hudShapes[] = {
+	ShapeValue(SegmentValue { 0, 0, 59, 0 }),
+	ShapeValue(SegmentValue { 0, 19, 59, 19 }),
+	ShapeValue(SegmentValue { 0, 0, 0, 19 }),
+	ShapeValue(SegmentValue { 59, 0, 59, 19 }),
+	ShapeValue(CircleValue { 30, 10, 6 }),
+	ShapeValue(SegmentValue { 24, 10, 36, 10 }),
+	ShapeValue(PointValue { 30, 10 }),
+	ShapeValue(RectangleValue { 2, 2, 10, 5 }, 1)
+};
+constexpr size_t hudCount = sizeof(hudShapes) / sizeof(hudShapes[0]);
+static_assert(validShapes(hudShapes, hudCount), "bad shape in the HUD table");
+
+constexpr StaticPage<60, 20> hudPage = rasterize<60, 20>(hudShapes);
+static_assert(hudPage.at(30, 4) == FrameBuffer::ink && hudPage.at(1, 1) == FrameBuffer::blank
+	&& hudPage.at(2, 5) == FrameBuffer::ink && hudPage.at(60, 5) == FrameBuffer::blank,
+	"HUD drawn wrong while compiling");
+
+// Return the bounds of v after a translate, a rotate and a scale
+constexpr BoundingBox movedBounds(ShapeValue v) {
+	v.translate(2, 1);
+	v.rotate();
+	v.scale(2);
+	return v.bounds();
+}
+
+// The kernels give their answers while compiling
+static_assert(ShapeValue(RectangleValue { 1, 2, 5, 4 }).area() == 8, "constexpr area wrong");
+static_assert(ShapeValue(SegmentValue { 1, 2, 1, 7 }).length() == 5, "constexpr length wrong");
+static_assert(ShapeValue(RectangleValue { 1, 2, 5, 4 }).length() == 0, "constexpr length wrong");
+static_assert(ShapeValue(CircleValue { 3, 3, 2 }).bounds().xMax == 5, "constexpr bounds wrong");
+static_assert(ShapeValue(CircleValue { 3, 3, 2 }).contains(4, 4)
+	&& !ShapeValue(CircleValue { 3, 3, 2 }).contains(5, 3), "constexpr contains wrong");
+static_assert(ShapeValue(PointValue { 1, 1 }).intersects(ShapeValue(RectangleValue { 0, 0, 2, 2 })),
+	"constexpr intersects wrong");
+static_assert(movedBounds(ShapeValue(RectangleValue { 0, 0, 4, 2 })).xMin == 2
+	&& movedBounds(ShapeValue(RectangleValue { 0, 0, 4, 2 })).yMax == 6, "constexpr transforms wrong");
+static_assert(BasicShapeValue<Fixed16>(BasicCircleValue<Fixed16> { 0, 0, 2 }).area() > Fixed16(12.56)
+	&& scalar::root(scalar::square(Fixed16(3)) + scalar::square(Fixed16(4))) == 5,
+	"constexpr fixed point wrong");
+
+// The errors of hand-written values are found while compiling
+static_assert(checkShape(ShapeValue(PointValue { 1, 1 }, -1)) == ShapeError::NEGATIVE_DEPTH
+	&& checkShape(ShapeValue(SegmentValue { 0, 0, 3, 3 })) == ShapeError::NOT_ORTHOGONAL
+	&& checkShape(ShapeValue(SegmentValue { 1, 1, 1, 1 })) == ShapeError::SAME_ENDPOINTS
+	&& checkShape(ShapeValue(RectangleValue { 1, 1, 1, 4 })) == ShapeError::SAME_X
+	&& checkShape(ShapeValue(CircleValue { 1, 1, 0 })) == ShapeError::NON_POSITIVE_RADIUS
+	&& checkShape(ShapeValue(CircleValue { 1e8f, 0, 1 })) == ShapeError::NONE
+	&& checkShape(ShapeValue(RectangleValue { 5, 1, 2, 4 })) == ShapeError::UNORDERED_CORNERS,
+	"constexpr shape checks wrong");
+
+// Return everything s shows: the page, depth composited or not, tiled,
+// and the cells of its canvas
+string showScene(const Scene& s) {
+	ostringstream out;
+	out << s;
+	s.renderTiled(out);
+	BitCanvas canvas(s.width(), s.height());
+	s.render(canvas);
+	for (int y = 0; y < s.height(); y++)
+		for (int x = 0; x < s.width(); x++)
+			out << canvas.test(x, y);
+	return out.str();
+}
+
+}
+
+void GeometryTester::testW() {
+	funcname_ = "GeometryTester::testW";
+
+	{
+	// the page drawn while compiling is the page drawn at run time, and
+	// the shapes check as the factories do
+	FrameBuffer fb(60, 20);
+	for (const ShapeValue& v : hudShapes)
+		v.draw(fb);
+	ostringstream out;
+	fb.write(out);
+	if (out.str() != string(hudPage.data(), hudPage.size))
+		errorOut_("static page differs from framebuffer", 1);
+	ostringstream loaded;
+	hudPage.frameBuffer().write(loaded);
+	if (loaded.str() != out.str())
+		errorOut_("static page not loaded", 1);
+	if (checkShape(makeCircle(1, 2, 3).value()) != ShapeError::NONE
+		|| checkShape(makeLineSegment(5, 2, 1, 2).value()) != ShapeError::NONE
+		|| checkShape(makeRectangle(5, 4, 1, 2, 3).value()) != ShapeError::NONE
+		|| checkShape(makeCircle(1e8f, 0, 1).value()) != ShapeError::NONE)
+		errorOut_("factory shape refused", 1);
+	}
+
+	{
+	// a table adds as its shapes would one at a time
+	Scene table(60, 20), single(60, 20);
+	single.add(ShapeValue(PointValue { 3, 3 }));
+	table.add(ShapeValue(PointValue { 3, 3 }));
+	for (const ShapeValue& v : hudShapes)
+		single.add(v);
+	if (table.add(hudShapes) != 1 || table.size() != single.size() || table.add(hudShapes, 0) != table.size())
+		errorOut_("table added to wrong slots", 2);
+	if (showScene(table) != showScene(single))
+		errorOut_("table scene differs", 2);
+	}
+
+	{
+	// shapes over the background show as they would beside the shapes
+	// drawn into it, however they move and whichever way frames are drawn
+	Scene over(60, 20), all(60, 20);
+	over.setBackground(hudPage.frameBuffer());
+	all.add(hudShapes);
+	vector<int> overMoving, allMoving;
+	for (int i = 0; i < 6; i++) {
+		ShapeValue v = (i % 2 == 0) ? ShapeValue(CircleValue { 5.0f + i * 9, 8, 3 })
+			: ShapeValue(RectangleValue { 4.0f + i * 8, 6, 8.0f + i * 8, 13 });
+		overMoving.push_back(over.add(v));
+		allMoving.push_back(all.add(v));
+	}
+	for (int step = 0; step < 8; step++) {
+		if (step == 4) {
+			over.setDepthCompositing(true);
+			all.setDepthCompositing(true);
+			for (size_t i = 0; i < overMoving.size(); i++) {
+				over.setGlyph(overMoving[i], 'a' + i);
+				all.setGlyph(allMoving[i], 'a' + i);
+			}
+		}
+		if (step == 6) {
+			over.setRenderThreads(4);
+			over.invalidate();
+		}
+		if (showScene(over) != showScene(all))
+			errorOut_("background scene differs at step ", step, 3);
+		over.translate(overMoving, 1.5f, -1);
+		all.translate(allMoving, 1.5f, -1);
+	}
+
+	// without it only the moving shapes are left
+	Scene moving(60, 20);
+	for (int slot : allMoving)
+		moving.add(all.value(slot));
+	over.setDepthCompositing(false);
+	over.clearBackground();
+	if (showScene(over) != showScene(moving))
+		errorOut_("background not cleared", 3);
+	try {
+		over.setBackground(FrameBuffer(60, 21));
+		errorOut_("background of wrong size accepted", 3);
+	} catch (invalid_argument&) {
+	}
+	}
+
+	{
+	// canvases of any size get the cells of the background that are not
+	// blank, as well as the shapes
+	Scene over(60, 20);
+	over.setBackground(hudPage.frameBuffer());
+	ShapeValue circle(CircleValue { 12, 12, 3 });
+	over.add(circle);
+	const int sizes[3][2] = { { 60, 20 }, { 37, 11 }, { 130, 70 } };
+	for (const auto& size : sizes) {
+		BitCanvas canvas(size[0], size[1]), expect(size[0], size[1]);
+		over.render(canvas);
+		expect.setClip(CellRect { 0, 0, 59, 19 });
+		circle.draw(expect);
+		for (int y = 0; y < size[1]; y++)
+			for (int x = 0; x < size[0]; x++)
+				if (hudPage.at(x, y) != FrameBuffer::blank)
+					expect.plot(x, y);
+		if (canvas.count() != expect.count() || canvas.countCommon(expect) != expect.count())
+			errorOut_("background canvas wrong for width ", size[0], 4);
+	}
+	}
+
+	passOut_();
+}
+
+namespace {
+
+// Return count shapes of every kind at depths 0 to 3, on a half grid over
+// and around a Scene::WIDTH * Scene::HEIGHT page
+template <class T>
+vector<BasicShapeValue<T>> sceneShapes(int count) {
+	unsigned state = 7;
+	auto next = [&](int n) { state = state * 1103515245u + 12345u; return int((state >> 16) % n); };
+	auto t = [](int halves) { return T(halves / 2.0); };
+	vector<BasicShapeValue<T>> shapes;
+	for (int i = 0; i < count; i++) {
+		T x = t(next(140) - 10), y = t(next(60) - 10), e = t(1 + next(24));
+		int kind = next(4), depth = next(4);
+		if (kind == 0)
+			shapes.push_back(BasicShapeValue<T>(BasicPointValue<T> { x, y }, depth));
+		else if (kind == 1 && i % 2)
+			shapes.push_back(BasicShapeValue<T>(BasicSegmentValue<T> { x, y, x + e, y }, depth));
+		else if (kind == 1)
+			shapes.push_back(BasicShapeValue<T>(BasicSegmentValue<T> { x, y, x, y + e }, depth));
+		else if (kind == 2)
+			shapes.push_back(BasicShapeValue<T>(BasicRectangleValue<T> { x, y, x + e, y + e / T(2) }, depth));
+		else
+			shapes.push_back(BasicShapeValue<T>(BasicCircleValue<T> { x, y, e / T(2) }, depth));
+	}
+	return shapes;
+}
+
+// Return the page s draws, its bit canvas, and for each point of a half
+// grid over and around the page the sorted slots containing it
+template <class S, class T>
+string describeScene(const S& s) {
+	ostringstream out;
+	out << s;
+	BitCanvas canvas(Scene::WIDTH + 3, Scene::HEIGHT - 2);
+	s.render(canvas);
+	for (int y = 0; y < canvas.height(); y++)
+		for (int x = 0; x < canvas.width(); x++)
+			out << canvas.test(x, y);
+	vector<int> slots;
+	for (int y = -6; y <= 2 * Scene::HEIGHT + 6; y++)
+		for (int x = -6; x <= 2 * Scene::WIDTH + 6; x++) {
+			slots.clear();
+			s.querySlots(T(x / 2.0), T(y / 2.0), slots);
+			sort(slots.begin(), slots.end());
+			out << '\n';
+			for (int slot : slots)
+				out << slot << ' ';
+		}
+	return out.str();
+}
+
+}
+
+void GeometryTester::testX() {
+	funcname_ = "GeometryTester::testX";
+
+	{
+	// the Fixed16 scene is compiled where no float can be held, and takes
+	// no float in
+	static_assert(!is_convertible<float, Fixed16>::value && !is_convertible<double, Fixed16>::value,
+		"floating point converts to Fixed16 implicitly");
+	static_assert(is_same<decltype(&FixedScene::contains), bool (FixedScene::*)(Fixed16, Fixed16) const>::value,
+		"FixedScene tests points in another type");
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+	if (!FIXED_SCENE_INTEGER_ONLY)
+		errorOut_("FixedScene compiled with floating point registers", 1);
+#endif
+	}
+
+	{
+	// fixed point, float, double and Scene draw and find the same shapes,
+	// at every drawing depth and after shapes move
+	vector<BasicShapeValue<float>> floats = sceneShapes<float>(300);
+	vector<BasicShapeValue<double>> doubles = sceneShapes<double>(300);
+	vector<BasicShapeValue<Fixed16>> fixeds = sceneShapes<Fixed16>(300);
+	Scene scene(Scene::WIDTH, Scene::HEIGHT);
+	BasicScene<float> floatScene(Scene::WIDTH, Scene::HEIGHT);
+	BasicScene<double> doubleScene(Scene::WIDTH, Scene::HEIGHT);
+	FixedScene fixedScene(Scene::WIDTH, Scene::HEIGHT);
+	scene.add(&floats[0], floats.size());
+	floatScene.add(&floats[0], floats.size());
+	doubleScene.add(&doubles[0], doubles.size());
+	if (fixedScene.add(&fixeds[0], fixeds.size()) != 0 || fixedScene.size() != 300)
+		errorOut_("shapes not added in order", 2);
+	for (int round = 0; round < 3; round++) {
+		for (int d : { 0, 1, 3 }) {
+			scene.setDrawDepth(d);
+			floatScene.setDrawDepth(d);
+			doubleScene.setDrawDepth(d);
+			fixedScene.setDrawDepth(d);
+			string expected = describeScene<Scene, float>(scene);
+			if (describeScene<BasicScene<float>, float>(floatScene) != expected)
+				errorOut_("float scene differs from Scene in round ", round, 2);
+			if (describeScene<BasicScene<double>, double>(doubleScene) != expected)
+				errorOut_("double scene differs from Scene in round ", round, 2);
+			if (describeScene<FixedScene, Fixed16>(fixedScene) != expected)
+				errorOut_("fixed point scene differs from Scene in round ", round, 2);
+		}
+		for (int slot = round; slot < 300; slot += 7) {
+			floats[slot].translate(-20.5f + round * 15, 4.5f);
+			doubles[slot].translate(-20.5 + round * 15, 4.5);
+			fixeds[slot].translate(Fixed16(-20.5 + round * 15), Fixed16(4.5));
+			scene.setValue(slot, floats[slot]);
+			floatScene.setValue(slot, floats[slot]);
+			doubleScene.setValue(slot, doubles[slot]);
+			fixedScene.setValue(slot, fixeds[slot]);
+		}
+	}
+	for (int y = -4; y <= 44; y++)
+		for (int x = -4; x <= 124; x++) {
+			vector<int> slots;
+			fixedScene.querySlots(Fixed16(x) / 2, Fixed16(y) / 2, slots);
+			if (fixedScene.contains(Fixed16(x) / 2, Fixed16(y) / 2) != !slots.empty())
+				errorOut_("contains disagrees with querySlots at row ", y, 2);
+		}
+	}
+
+	{
+	// drawing is clipped to the drawing area and value() reads back
+	FixedScene s(10, 5);
+	s.add(BasicShapeValue<Fixed16>(BasicRectangleValue<Fixed16> { Fixed16(-3), Fixed16(-3), Fixed16(20), Fixed16(2) }));
+	s.add(BasicShapeValue<Fixed16>(BasicCircleValue<Fixed16> { Fixed16(5), Fixed16(4), Fixed16(1) }, 2));
+	ostringstream out;
+	out << s;
+	string expected = "    ***   \n     *    \n";
+	for (int y = 0; y < 3; y++)
+		expected += string(10, '*') + "\n";
+	if (out.str() != expected)
+		errorOut_("page drawn as ", "\n" + out.str(), 3);
+	FrameBuffer big(14, 8);
+	s.setDrawDepth(1);
+	s.render(big);
+	int marked = 0;
+	for (int y = 0; y < 8; y++)
+		for (int x = 0; x < 14; x++)
+			marked += big.at(x, y) != ' ';
+	if (marked != 30)
+		errorOut_("cells drawn outside the area: ", marked, 3);
+	if (s.value(1).kind() != BasicShapeValue<Fixed16>::CIRCLE || s.value(1).depth() != 2)
+		errorOut_("value read back wrong", 3);
+	}
+
+	{
+	// bad arguments
+	try {
+		FixedScene s(0, 5);
+		errorOut_("empty drawing area accepted", 4);
+	} catch (invalid_argument&) {
+	}
+	FixedScene s(10, 5);
+	s.add(BasicShapeValue<Fixed16>(BasicPointValue<Fixed16> { Fixed16(1), Fixed16(1) }));
+	try {
+		s.value(1);
+		errorOut_("slot 1 read", 4);
+	} catch (out_of_range&) {
+	}
+	try {
+		s.setValue(-1, s.value(0));
+		errorOut_("slot -1 replaced", 4);
+	} catch (out_of_range&) {
+	}
+	}
+
+	passOut_();
 }
 
 void GeometryTester::errorOut_(const string& errMsg, unsigned int errBit) {
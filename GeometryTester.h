@@ -47,9 +47,81 @@ public:
 	void testx();
 	void testy();
 
-	// unused
+	// scene clipping
 	void testz();
 
+	// scene queries
+	void testA();
+
+	// shape store
+	void testB();
+
+	// batch containment
+	void testC();
+
+	// incremental rendering
+	void testD();
+
+	// canvas size, tiles
+	void testE();
+
+	// parallel rendering
+	void testF();
+
+	// arena allocation
+	void testG();
+
+	// shapes by value
+	void testH();
+
+	// depth layers
+	void testI();
+
+	// depth compositing
+	void testJ();
+
+	// pick buffer
+	void testK();
+
+	// scanline rasterizers
+	void testL();
+
+	// bit canvas
+	void testM();
+
+	// binary scene files
+	void testN();
+
+	// streaming text ingestion
+	void testO();
+
+	// exception-free factories
+	void testP();
+
+	// batch transforms
+	void testQ();
+
+	// lazy composed transforms
+	void testR();
+
+	// shape intersection and sweep and prune
+	void testS();
+
+	// packed R-tree range queries
+	void testT();
+
+	// distances and nearest shapes
+	void testU();
+
+	// shapes in double and fixed point
+	void testV();
+
+	// shapes and pages made while compiling
+	void testW();
+
+	// scenes in fixed point
+	void testX();
+
 private:
 
 	// three overloaded versions
@@ -34,7 +34,31 @@ int main(int argc, char* argv[]) {
 		case 'x': { GeometryTester t; t.testx(); } break;
 		case 'y': { GeometryTester t; t.testy(); } break;
 		case 'z': { GeometryTester t; t.testz(); } break;
-		default: { cout << "Options are a -- y." << endl; } break;
+		case 'A': { GeometryTester t; t.testA(); } break;
+		case 'B': { GeometryTester t; t.testB(); } break;
+		case 'C': { GeometryTester t; t.testC(); } break;
+		case 'D': { GeometryTester t; t.testD(); } break;
+		case 'E': { GeometryTester t; t.testE(); } break;
+		case 'F': { GeometryTester t; t.testF(); } break;
+		case 'G': { GeometryTester t; t.testG(); } break;
+		case 'H': { GeometryTester t; t.testH(); } break;
+		case 'I': { GeometryTester t; t.testI(); } break;
+		case 'J': { GeometryTester t; t.testJ(); } break;
+		case 'K': { GeometryTester t; t.testK(); } break;
+		case 'L': { GeometryTester t; t.testL(); } break;
+		case 'M': { GeometryTester t; t.testM(); } break;
+		case 'N': { GeometryTester t; t.testN(); } break;
+		case 'O': { GeometryTester t; t.testO(); } break;
+		case 'P': { GeometryTester t; t.testP(); } break;
+		case 'Q': { GeometryTester t; t.testQ(); } break;
+		case 'R': { GeometryTester t; t.testR(); } break;
+		case 'S': { GeometryTester t; t.testS(); } break;
+		case 'T': { GeometryTester t; t.testT(); } break;
+		case 'U': { GeometryTester t; t.testU(); } break;
+		case 'V': { GeometryTester t; t.testV(); } break;
+		case 'W': { GeometryTester t; t.testW(); } break;
+		case 'X': { GeometryTester t; t.testX(); } break;
+		default: { cout << "Options are a -- z, A -- X." << endl; } break;
 	       	}
 	}
 	return 0;
@@ -0,0 +1,423 @@
+#include <algorithm>
+#include "Kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+using namespace std;
+
+namespace {
+
+typedef void (*BoxesKernel)(const float*, const float*, const float*,
+        const float*, size_t, float, float, uint64_t*);
+typedef void (*CirclesKernel)(const float*, const float*, const float*,
+        size_t, float, float, uint64_t*);
+typedef void (*InBoxKernel)(const float*, const float*, size_t,
+        float, float, float, float, uint64_t*);
+typedef void (*InCircleKernel)(const float*, const float*, size_t,
+        float, float, float, uint64_t*);
+
+/*
+ * Every kernel fills whole 64-bit words. The vector versions handle 8
+ * or 4 items per step and leave the last n % 8 (or n % 4) items to the
+ * scalar version, whose bits are or-ed into the final word.
+ */
+
+void boxesScalar(const float* xMin, const float* yMin, const float* xMax,
+        const float* yMax, size_t n, float px, float py, uint64_t* mask) {
+
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t end = min(n, word * 64 + 64);
+        uint64_t bits = 0;
+        for (size_t i = word * 64; i < end; i++) {
+            bool in = xMin[i] <= px && px <= xMax[i] &&
+                yMin[i] <= py && py <= yMax[i];
+            bits |= static_cast<uint64_t>(in) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    return;
+}
+
+void circlesScalar(const float* x, const float* y, const float* r,
+        size_t n, float px, float py, uint64_t* mask) {
+
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t end = min(n, word * 64 + 64);
+        uint64_t bits = 0;
+        for (size_t i = word * 64; i < end; i++) {
+            float xDiff = x[i] - px;
+            float yDiff = y[i] - py;
+            bool in = xDiff * xDiff + yDiff * yDiff < r[i] * r[i];
+            bits |= static_cast<uint64_t>(in) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    return;
+}
+
+void inBoxScalar(const float* xs, const float* ys, size_t n, float xMin,
+        float yMin, float xMax, float yMax, uint64_t* mask) {
+
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t end = min(n, word * 64 + 64);
+        uint64_t bits = 0;
+        for (size_t i = word * 64; i < end; i++) {
+            bool in = xMin <= xs[i] && xs[i] <= xMax &&
+                yMin <= ys[i] && ys[i] <= yMax;
+            bits |= static_cast<uint64_t>(in) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    return;
+}
+
+void inCircleScalar(const float* xs, const float* ys, size_t n,
+        float cx, float cy, float r, uint64_t* mask) {
+
+    float radSquare = r * r;
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t end = min(n, word * 64 + 64);
+        uint64_t bits = 0;
+        for (size_t i = word * 64; i < end; i++) {
+            float xDiff = cx - xs[i];
+            float yDiff = cy - ys[i];
+            bool in = xDiff * xDiff + yDiff * yDiff < radSquare;
+            bits |= static_cast<uint64_t>(in) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    return;
+}
+
+#ifdef KERNELS_X86
+
+__attribute__((target("sse2")))
+void boxesSse2(const float* xMin, const float* yMin, const float* xMax,
+        const float* yMax, size_t n, float px, float py, uint64_t* mask) {
+
+    __m128 vx = _mm_set1_ps(px);
+    __m128 vy = _mm_set1_ps(py);
+    size_t full = n / 4 * 4;
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t i = word * 64;
+        size_t end = min(full, i + 64);
+        uint64_t bits = 0;
+        for (; i < end; i += 4) {
+            __m128 in = _mm_and_ps(
+                    _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(xMin + i), vx),
+                        _mm_cmple_ps(vx, _mm_loadu_ps(xMax + i))),
+                    _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(yMin + i), vy),
+                        _mm_cmple_ps(vy, _mm_loadu_ps(yMax + i))));
+            bits |= static_cast<uint64_t>(_mm_movemask_ps(in)) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    if (full < n) {
+        uint64_t tail;
+        boxesScalar(xMin + full, yMin + full, xMax + full, yMax + full,
+                n - full, px, py, &tail);
+        mask[full / 64] |= tail << (full % 64);
+    }
+    return;
+}
+
+__attribute__((target("sse2")))
+void circlesSse2(const float* x, const float* y, const float* r,
+        size_t n, float px, float py, uint64_t* mask) {
+
+    __m128 vx = _mm_set1_ps(px);
+    __m128 vy = _mm_set1_ps(py);
+    size_t full = n / 4 * 4;
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t i = word * 64;
+        size_t end = min(full, i + 64);
+        uint64_t bits = 0;
+        for (; i < end; i += 4) {
+            __m128 xDiff = _mm_sub_ps(_mm_loadu_ps(x + i), vx);
+            __m128 yDiff = _mm_sub_ps(_mm_loadu_ps(y + i), vy);
+            __m128 rad = _mm_loadu_ps(r + i);
+            __m128 dist = _mm_add_ps(_mm_mul_ps(xDiff, xDiff), _mm_mul_ps(yDiff, yDiff));
+            __m128 in = _mm_cmplt_ps(dist, _mm_mul_ps(rad, rad));
+            bits |= static_cast<uint64_t>(_mm_movemask_ps(in)) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    if (full < n) {
+        uint64_t tail;
+        circlesScalar(x + full, y + full, r + full, n - full, px, py, &tail);
+        mask[full / 64] |= tail << (full % 64);
+    }
+    return;
+}
+
+__attribute__((target("sse2")))
+void inBoxSse2(const float* xs, const float* ys, size_t n, float xMin,
+        float yMin, float xMax, float yMax, uint64_t* mask) {
+
+    __m128 x0 = _mm_set1_ps(xMin);
+    __m128 y0 = _mm_set1_ps(yMin);
+    __m128 x1 = _mm_set1_ps(xMax);
+    __m128 y1 = _mm_set1_ps(yMax);
+    size_t full = n / 4 * 4;
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t i = word * 64;
+        size_t end = min(full, i + 64);
+        uint64_t bits = 0;
+        for (; i < end; i += 4) {
+            __m128 vx = _mm_loadu_ps(xs + i);
+            __m128 vy = _mm_loadu_ps(ys + i);
+            __m128 in = _mm_and_ps(
+                    _mm_and_ps(_mm_cmple_ps(x0, vx), _mm_cmple_ps(vx, x1)),
+                    _mm_and_ps(_mm_cmple_ps(y0, vy), _mm_cmple_ps(vy, y1)));
+            bits |= static_cast<uint64_t>(_mm_movemask_ps(in)) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    if (full < n) {
+        uint64_t tail;
+        inBoxScalar(xs + full, ys + full, n - full, xMin, yMin, xMax, yMax, &tail);
+        mask[full / 64] |= tail << (full % 64);
+    }
+    return;
+}
+
+__attribute__((target("sse2")))
+void inCircleSse2(const float* xs, const float* ys, size_t n,
+        float cx, float cy, float r, uint64_t* mask) {
+
+    __m128 vx = _mm_set1_ps(cx);
+    __m128 vy = _mm_set1_ps(cy);
+    __m128 radSquare = _mm_set1_ps(r * r);
+    size_t full = n / 4 * 4;
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t i = word * 64;
+        size_t end = min(full, i + 64);
+        uint64_t bits = 0;
+        for (; i < end; i += 4) {
+            __m128 xDiff = _mm_sub_ps(vx, _mm_loadu_ps(xs + i));
+            __m128 yDiff = _mm_sub_ps(vy, _mm_loadu_ps(ys + i));
+            __m128 dist = _mm_add_ps(_mm_mul_ps(xDiff, xDiff), _mm_mul_ps(yDiff, yDiff));
+            __m128 in = _mm_cmplt_ps(dist, radSquare);
+            bits |= static_cast<uint64_t>(_mm_movemask_ps(in)) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    if (full < n) {
+        uint64_t tail;
+        inCircleScalar(xs + full, ys + full, n - full, cx, cy, r, &tail);
+        mask[full / 64] |= tail << (full % 64);
+    }
+    return;
+}
+
+__attribute__((target("avx2")))
+void boxesAvx2(const float* xMin, const float* yMin, const float* xMax,
+        const float* yMax, size_t n, float px, float py, uint64_t* mask) {
+
+    __m256 vx = _mm256_set1_ps(px);
+    __m256 vy = _mm256_set1_ps(py);
+    size_t full = n / 8 * 8;
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t i = word * 64;
+        size_t end = min(full, i + 64);
+        uint64_t bits = 0;
+        for (; i < end; i += 8) {
+            __m256 in = _mm256_and_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(xMin + i), vx, _CMP_LE_OQ),
+                        _mm256_cmp_ps(vx, _mm256_loadu_ps(xMax + i), _CMP_LE_OQ)),
+                    _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(yMin + i), vy, _CMP_LE_OQ),
+                        _mm256_cmp_ps(vy, _mm256_loadu_ps(yMax + i), _CMP_LE_OQ)));
+            bits |= static_cast<uint64_t>(_mm256_movemask_ps(in)) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    if (full < n) {
+        uint64_t tail;
+        boxesScalar(xMin + full, yMin + full, xMax + full, yMax + full,
+                n - full, px, py, &tail);
+        mask[full / 64] |= tail << (full % 64);
+    }
+    return;
+}
+
+__attribute__((target("avx2")))
+void circlesAvx2(const float* x, const float* y, const float* r,
+        size_t n, float px, float py, uint64_t* mask) {
+
+    __m256 vx = _mm256_set1_ps(px);
+    __m256 vy = _mm256_set1_ps(py);
+    size_t full = n / 8 * 8;
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t i = word * 64;
+        size_t end = min(full, i + 64);
+        uint64_t bits = 0;
+        for (; i < end; i += 8) {
+            __m256 xDiff = _mm256_sub_ps(_mm256_loadu_ps(x + i), vx);
+            __m256 yDiff = _mm256_sub_ps(_mm256_loadu_ps(y + i), vy);
+            __m256 rad = _mm256_loadu_ps(r + i);
+            /* No FMA, so that rounding matches the scalar kernel */
+            __m256 dist = _mm256_add_ps(_mm256_mul_ps(xDiff, xDiff),
+                    _mm256_mul_ps(yDiff, yDiff));
+            __m256 in = _mm256_cmp_ps(dist, _mm256_mul_ps(rad, rad), _CMP_LT_OQ);
+            bits |= static_cast<uint64_t>(_mm256_movemask_ps(in)) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    if (full < n) {
+        uint64_t tail;
+        circlesScalar(x + full, y + full, r + full, n - full, px, py, &tail);
+        mask[full / 64] |= tail << (full % 64);
+    }
+    return;
+}
+
+__attribute__((target("avx2")))
+void inBoxAvx2(const float* xs, const float* ys, size_t n, float xMin,
+        float yMin, float xMax, float yMax, uint64_t* mask) {
+
+    __m256 x0 = _mm256_set1_ps(xMin);
+    __m256 y0 = _mm256_set1_ps(yMin);
+    __m256 x1 = _mm256_set1_ps(xMax);
+    __m256 y1 = _mm256_set1_ps(yMax);
+    size_t full = n / 8 * 8;
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t i = word * 64;
+        size_t end = min(full, i + 64);
+        uint64_t bits = 0;
+        for (; i < end; i += 8) {
+            __m256 vx = _mm256_loadu_ps(xs + i);
+            __m256 vy = _mm256_loadu_ps(ys + i);
+            __m256 in = _mm256_and_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(x0, vx, _CMP_LE_OQ),
+                        _mm256_cmp_ps(vx, x1, _CMP_LE_OQ)),
+                    _mm256_and_ps(_mm256_cmp_ps(y0, vy, _CMP_LE_OQ),
+                        _mm256_cmp_ps(vy, y1, _CMP_LE_OQ)));
+            bits |= static_cast<uint64_t>(_mm256_movemask_ps(in)) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    if (full < n) {
+        uint64_t tail;
+        inBoxScalar(xs + full, ys + full, n - full, xMin, yMin, xMax, yMax, &tail);
+        mask[full / 64] |= tail << (full % 64);
+    }
+    return;
+}
+
+__attribute__((target("avx2")))
+void inCircleAvx2(const float* xs, const float* ys, size_t n,
+        float cx, float cy, float r, uint64_t* mask) {
+
+    __m256 vx = _mm256_set1_ps(cx);
+    __m256 vy = _mm256_set1_ps(cy);
+    __m256 radSquare = _mm256_set1_ps(r * r);
+    size_t full = n / 8 * 8;
+    for (size_t word = 0; word * 64 < n; word++) {
+        size_t i = word * 64;
+        size_t end = min(full, i + 64);
+        uint64_t bits = 0;
+        for (; i < end; i += 8) {
+            __m256 xDiff = _mm256_sub_ps(vx, _mm256_loadu_ps(xs + i));
+            __m256 yDiff = _mm256_sub_ps(vy, _mm256_loadu_ps(ys + i));
+            __m256 dist = _mm256_add_ps(_mm256_mul_ps(xDiff, xDiff),
+                    _mm256_mul_ps(yDiff, yDiff));
+            __m256 in = _mm256_cmp_ps(dist, radSquare, _CMP_LT_OQ);
+            bits |= static_cast<uint64_t>(_mm256_movemask_ps(in)) << (i - word * 64);
+        }
+        mask[word] = bits;
+    }
+    if (full < n) {
+        uint64_t tail;
+        inCircleScalar(xs + full, ys + full, n - full, cx, cy, r, &tail);
+        mask[full / 64] |= tail << (full % 64);
+    }
+    return;
+}
+
+#endif /* KERNELS_X86 */
+
+// Kernels picked once, on first use
+struct KernelTable {
+    BoxesKernel boxes;
+    CirclesKernel circles;
+    InBoxKernel inBox;
+    InCircleKernel inCircle;
+    const char* name;
+};
+
+KernelTable pickKernels() {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return KernelTable { boxesAvx2, circlesAvx2, inBoxAvx2, inCircleAvx2, "avx2" };
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return KernelTable { boxesSse2, circlesSse2, inBoxSse2, inCircleSse2, "sse2" };
+    }
+#endif
+    return KernelTable { boxesScalar, circlesScalar, inBoxScalar, inCircleScalar, "scalar" };
+}
+
+const KernelTable& kernels() {
+    static const KernelTable picked = pickKernels();
+    return picked;
+}
+
+}
+
+namespace batch {
+
+void boxesContaining(const float* xMin, const float* yMin,
+        const float* xMax, const float* yMax, size_t n,
+        float px, float py, uint64_t* mask) {
+    kernels().boxes(xMin, yMin, xMax, yMax, n, px, py, mask);
+    return;
+}
+
+void circlesContaining(const float* x, const float* y, const float* r,
+        size_t n, float px, float py, uint64_t* mask) {
+    kernels().circles(x, y, r, n, px, py, mask);
+    return;
+}
+
+void pointsInBox(const float* xs, const float* ys, size_t n,
+        float xMin, float yMin, float xMax, float yMax, uint64_t* mask) {
+    kernels().inBox(xs, ys, n, xMin, yMin, xMax, yMax, mask);
+    return;
+}
+
+void pointsInCircle(const float* xs, const float* ys, size_t n,
+        float cx, float cy, float r, uint64_t* mask) {
+    kernels().inCircle(xs, ys, n, cx, cy, r, mask);
+    return;
+}
+
+void appendSetBits(const uint64_t* mask, size_t n, vector<size_t>& indices) {
+    for (size_t word = 0; word * 64 < n; word++) {
+        for (uint64_t bits = mask[word]; bits != 0; bits &= bits - 1) {
+            indices.push_back(word * 64 + lowestBit(bits));
+        }
+    }
+    return;
+}
+
+int lowestBit(uint64_t bits) {
+#ifdef __GNUC__
+    return __builtin_ctzll(bits);
+#else
+    int index = 0;
+    for (; (bits & 1) == 0; bits >>= 1) {
+        index++;
+    }
+    return index;
+#endif
+}
+
+const char* kernelName() {
+    return kernels().name;
+}
+
+}
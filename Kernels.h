@@ -0,0 +1,50 @@
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Batch containment kernels behind ShapeStore (many shapes, one point)
+ * and Shape::containsMany (one shape, many points). Each kernel fills a
+ * bitmask: bit i % 64 of word i / 64 is set when item i passes the test
+ * and cleared otherwise, so mask must hold at least (n + 63) / 64 words.
+ *
+ * The widest version the CPU supports (AVX2, then SSE2, then plain C++)
+ * is picked at run time, and all of them produce the same bits. Boxes
+ * are closed; circles are open and compared on squared distances,
+ * like Circle::contains.
+ */
+namespace batch {
+
+// Box i is xMin[i]..xMax[i] by yMin[i]..yMax[i]; test it against (px, py)
+void boxesContaining(const float* xMin, const float* yMin,
+        const float* xMax, const float* yMax, size_t n,
+        float px, float py, uint64_t* mask);
+
+// Circle i has centre (x[i], y[i]) and radius r[i]; test it against (px, py)
+void circlesContaining(const float* x, const float* y, const float* r,
+        size_t n, float px, float py, uint64_t* mask);
+
+// Test the points (xs[i], ys[i]) against one box
+void pointsInBox(const float* xs, const float* ys, size_t n,
+        float xMin, float yMin, float xMax, float yMax, uint64_t* mask);
+
+// Test the points (xs[i], ys[i]) against one circle
+void pointsInCircle(const float* xs, const float* ys, size_t n,
+        float cx, float cy, float r, uint64_t* mask);
+
+// Append to indices the position of every set bit among the first n bits
+// of mask, in increasing order
+void appendSetBits(const uint64_t* mask, size_t n, std::vector<size_t>& indices);
+
+// Return the index of the lowest set bit of a non-zero word
+int lowestBit(uint64_t bits);
+
+// Return the name of the kernels in use: "avx2", "sse2" or "scalar"
+const char* kernelName();
+
+}
+
+#endif /* KERNELS_H_ */
@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <stdexcept>
+#include "Raster.h"
+
+// ============== FrameBuffer class ================
+
+constexpr char FrameBuffer::blank;
+constexpr char FrameBuffer::ink;
+
+FrameBuffer::FrameBuffer(int width, int height, int xOrigin, int yOrigin) :
+    width_(width), height_(height), xOrigin_(xOrigin), yOrigin_(yOrigin) {
+    page_.assign(static_cast<size_t>(height_) * (width_ + 1), blank);
+    resetClip();
+    clear();
+}
+
+char* FrameBuffer::row_(int y) {
+    /* Row 0 of the page is the top of the scene */
+    return &page_[static_cast<size_t>(yOrigin_ + height_ - 1 - y) * (width_ + 1)];
+}
+
+const char* FrameBuffer::row_(int y) const {
+    return &page_[static_cast<size_t>(yOrigin_ + height_ - 1 - y) * (width_ + 1)];
+}
+
+void FrameBuffer::clear() {
+    for (int row = 0; row < height_; row++) {
+        char* line = &page_[static_cast<size_t>(row) * (width_ + 1)];
+        std::fill(line, line + width_, blank);
+        line[width_] = '\n';
+    }
+    return;
+}
+
+void FrameBuffer::load(const char* cells) {
+    for (int row = 0; row < height_; row++) {
+        const char* from = cells + static_cast<size_t>(row) * (width_ + 1);
+        std::copy(from, from + width_, &page_[static_cast<size_t>(row) * (width_ + 1)]);
+    }
+    return;
+}
+
+void FrameBuffer::plot(int x, int y) {
+    if (x < clip_.x0 || x > clip_.x1 || y < clip_.y0 || y > clip_.y1) {
+        return;
+    }
+    row_(y)[x - xOrigin_] = ink;
+    return;
+}
+
+void FrameBuffer::fillSpan(int y, int x0, int x1) {
+    if (y < clip_.y0 || y > clip_.y1) {
+        return;
+    }
+    if (x0 < clip_.x0) {
+        x0 = clip_.x0;
+    }
+    if (x1 > clip_.x1) {
+        x1 = clip_.x1;
+    }
+    if (x0 > x1) {
+        return;
+    }
+    char* line = row_(y);
+    std::fill(line + x0 - xOrigin_, line + x1 + 1 - xOrigin_, ink);
+    return;
+}
+
+void FrameBuffer::clearRect(const CellRect& r) {
+
+    CellRect all = page();
+    int x0 = std::max(r.x0, all.x0);
+    int x1 = std::min(r.x1, all.x1);
+    int y0 = std::max(r.y0, all.y0);
+    int y1 = std::min(r.y1, all.y1);
+    if (x0 > x1) {
+        return;
+    }
+    for (int y = y0; y <= y1; y++) {
+        char* line = row_(y);
+        std::fill(line + x0 - xOrigin_, line + x1 + 1 - xOrigin_, blank);
+    }
+    return;
+}
+
+void FrameBuffer::setClip(const CellRect& r) {
+    CellRect all = page();
+    clip_.x0 = std::max(r.x0, all.x0);
+    clip_.x1 = std::min(r.x1, all.x1);
+    clip_.y0 = std::max(r.y0, all.y0);
+    clip_.y1 = std::min(r.y1, all.y1);
+    return;
+}
+
+void FrameBuffer::resetClip() {
+    clip_ = page();
+    return;
+}
+
+void FrameBuffer::setOrigin(int xOrigin, int yOrigin) {
+    xOrigin_ = xOrigin;
+    yOrigin_ = yOrigin;
+    resetClip();
+    return;
+}
+
+void FrameBuffer::copyRect(const FrameBuffer& other, const CellRect& r) {
+
+    CellRect mine = page();
+    CellRect theirs = other.page();
+    int x0 = std::max(r.x0, std::max(mine.x0, theirs.x0));
+    int x1 = std::min(r.x1, std::min(mine.x1, theirs.x1));
+    int y0 = std::max(r.y0, std::max(mine.y0, theirs.y0));
+    int y1 = std::min(r.y1, std::min(mine.y1, theirs.y1));
+    if (x0 > x1) {
+        return;
+    }
+    for (int y = y0; y <= y1; y++) {
+        const char* from = other.row_(y) + (x0 - other.xOrigin_);
+        std::copy(from, from + (x1 - x0 + 1), row_(y) + (x0 - xOrigin_));
+    }
+    return;
+}
+
+void FrameBuffer::paint(const DepthBuffer& depth, const CellRect& r,
+        const std::vector<char>& glyphs, const FrameBuffer* background) {
+
+    CellRect mine = page();
+    CellRect theirs = depth.page();
+    int x0 = std::max(r.x0, std::max(mine.x0, theirs.x0));
+    int x1 = std::min(r.x1, std::min(mine.x1, theirs.x1));
+    int y0 = std::max(r.y0, std::max(mine.y0, theirs.y0));
+    int y1 = std::min(r.y1, std::min(mine.y1, theirs.y1));
+    for (int y = y0; y <= y1; y++) {
+        char* line = row_(y);
+        for (int x = x0; x <= x1; x++) {
+            int id = depth.idAt(x, y);
+            if (id != DepthBuffer::none) {
+                line[x - xOrigin_] = glyphs[id];
+            } else {
+                line[x - xOrigin_] = (background == nullptr) ? blank : background->at(x, y);
+            }
+        }
+    }
+    return;
+}
+
+void FrameBuffer::paint(const DepthBuffer& depth, const CellRect& r,
+        const FrameBuffer* background) {
+
+    CellRect mine = page();
+    CellRect theirs = depth.page();
+    int x0 = std::max(r.x0, std::max(mine.x0, theirs.x0));
+    int x1 = std::min(r.x1, std::min(mine.x1, theirs.x1));
+    int y0 = std::max(r.y0, std::max(mine.y0, theirs.y0));
+    int y1 = std::min(r.y1, std::min(mine.y1, theirs.y1));
+    for (int y = y0; y <= y1; y++) {
+        char* line = row_(y);
+        for (int x = x0; x <= x1; x++) {
+            if (depth.idAt(x, y) != DepthBuffer::none) {
+                line[x - xOrigin_] = ink;
+            } else {
+                line[x - xOrigin_] = (background == nullptr) ? blank : background->at(x, y);
+            }
+        }
+    }
+    return;
+}
+
+const CellRect& FrameBuffer::clip() const {
+    return clip_;
+}
+
+CellRect FrameBuffer::page() const {
+    return CellRect { xOrigin_, yOrigin_, xOrigin_ + width_ - 1, yOrigin_ + height_ - 1 };
+}
+
+char FrameBuffer::at(int x, int y) const {
+    CellRect all = page();
+    if (x < all.x0 || x > all.x1 || y < all.y0 || y > all.y1) {
+        return blank;
+    }
+    return row_(y)[x - xOrigin_];
+}
+
+int FrameBuffer::width() const {
+    return width_;
+}
+
+int FrameBuffer::height() const {
+    return height_;
+}
+
+void FrameBuffer::write(std::ostream& out) const {
+    out.write(page_.data(), page_.size());
+    return;
+}
+
+// ============== DepthBuffer class ================
+
+constexpr int DepthBuffer::none;
+
+DepthBuffer::DepthBuffer(int width, int height, int xOrigin, int yOrigin) :
+    width_(width), height_(height), xOrigin_(xOrigin), yOrigin_(yOrigin),
+    id_(none), depth_(0) {
+    ids_.resize(static_cast<size_t>(width_) * height_);
+    depths_.resize(ids_.size());
+    resetClip();
+    clear();
+}
+
+void DepthBuffer::clear() {
+    std::fill(ids_.begin(), ids_.end(), none);
+    return;
+}
+
+void DepthBuffer::setOrigin(int xOrigin, int yOrigin) {
+    xOrigin_ = xOrigin;
+    yOrigin_ = yOrigin;
+    resetClip();
+    return;
+}
+
+void DepthBuffer::setClip(const CellRect& r) {
+    CellRect all = page();
+    clip_.x0 = std::max(r.x0, all.x0);
+    clip_.x1 = std::min(r.x1, all.x1);
+    clip_.y0 = std::max(r.y0, all.y0);
+    clip_.y1 = std::min(r.y1, all.y1);
+    return;
+}
+
+void DepthBuffer::resetClip() {
+    clip_ = page();
+    return;
+}
+
+const CellRect& DepthBuffer::clip() const {
+    return clip_;
+}
+
+CellRect DepthBuffer::page() const {
+    return CellRect { xOrigin_, yOrigin_, xOrigin_ + width_ - 1, yOrigin_ + height_ - 1 };
+}
+
+void DepthBuffer::setSource(int id, int d) {
+    id_ = id;
+    depth_ = d;
+    return;
+}
+
+void DepthBuffer::offer_(size_t index) {
+    /* Empty cells hold no meaningful depth, so they are taken outright */
+    if (ids_[index] == none || depth_ < depths_[index] ||
+            (depth_ == depths_[index] && id_ > ids_[index])) {
+        ids_[index] = id_;
+        depths_[index] = depth_;
+    }
+    return;
+}
+
+void DepthBuffer::plot(int x, int y) {
+    if (x < clip_.x0 || x > clip_.x1 || y < clip_.y0 || y > clip_.y1) {
+        return;
+    }
+    offer_(static_cast<size_t>(y - yOrigin_) * width_ + (x - xOrigin_));
+    return;
+}
+
+void DepthBuffer::fillSpan(int y, int x0, int x1) {
+    if (y < clip_.y0 || y > clip_.y1) {
+        return;
+    }
+    if (x0 < clip_.x0) {
+        x0 = clip_.x0;
+    }
+    if (x1 > clip_.x1) {
+        x1 = clip_.x1;
+    }
+    size_t row = static_cast<size_t>(y - yOrigin_) * width_;
+    for (int x = x0; x <= x1; x++) {
+        offer_(row + (x - xOrigin_));
+    }
+    return;
+}
+
+int DepthBuffer::idAt(int x, int y) const {
+    return ids_[static_cast<size_t>(y - yOrigin_) * width_ + (x - xOrigin_)];
+}
+
+// ============== PickBuffer class ================
+
+PickBuffer::PickBuffer(int width, int height) : width_(width), height_(height) {
+    ids_.assign(static_cast<size_t>(width_) * height_, DepthBuffer::none);
+}
+
+void PickBuffer::clear() {
+    std::fill(ids_.begin(), ids_.end(), DepthBuffer::none);
+    return;
+}
+
+void PickBuffer::copyRect(const DepthBuffer& depth, const CellRect& r) {
+
+    CellRect theirs = depth.page();
+    int x0 = std::max(r.x0, std::max(0, theirs.x0));
+    int x1 = std::min(r.x1, std::min(width_ - 1, theirs.x1));
+    int y0 = std::max(r.y0, std::max(0, theirs.y0));
+    int y1 = std::min(r.y1, std::min(height_ - 1, theirs.y1));
+    for (int y = y0; y <= y1; y++) {
+        int32_t* line = &ids_[static_cast<size_t>(y) * width_];
+        for (int x = x0; x <= x1; x++) {
+            line[x] = depth.idAt(x, y);
+        }
+    }
+    return;
+}
+
+int32_t PickBuffer::at(int x, int y) const {
+    if (x < 0 || x >= width_ || y < 0 || y >= height_) {
+        return DepthBuffer::none;
+    }
+    return ids_[static_cast<size_t>(y) * width_ + x];
+}
+
+const int32_t* PickBuffer::data() const {
+    return ids_.data();
+}
+
+int PickBuffer::width() const {
+    return width_;
+}
+
+int PickBuffer::height() const {
+    return height_;
+}
+
+// ============== BitCanvas class ================
+
+BitCanvas::BitCanvas(int width, int height) : width_(width), height_(height),
+    wordsPerRow_((width + 63) / 64) {
+
+    if (width <= 0 || height <= 0) {
+        throw std::invalid_argument("zero or negative canvas size.");
+    }
+    words_.assign(static_cast<size_t>(wordsPerRow_) * height_, 0);
+    resetClip();
+}
+
+void BitCanvas::clear() {
+    std::fill(words_.begin(), words_.end(), 0);
+    return;
+}
+
+void BitCanvas::setClip(const CellRect& r) {
+    clip_.x0 = std::max(r.x0, 0);
+    clip_.x1 = std::min(r.x1, width_ - 1);
+    clip_.y0 = std::max(r.y0, 0);
+    clip_.y1 = std::min(r.y1, height_ - 1);
+    return;
+}
+
+void BitCanvas::resetClip() {
+    clip_ = CellRect { 0, 0, width_ - 1, height_ - 1 };
+    return;
+}
+
+const CellRect& BitCanvas::clip() const {
+    return clip_;
+}
+
+void BitCanvas::plot(int x, int y) {
+    if (x < clip_.x0 || x > clip_.x1 || y < clip_.y0 || y > clip_.y1) {
+        return;
+    }
+    words_[static_cast<size_t>(y) * wordsPerRow_ + x / 64] |= uint64_t(1) << (x % 64);
+    return;
+}
+
+void BitCanvas::fillSpan(int y, int x0, int x1) {
+    if (y < clip_.y0 || y > clip_.y1) {
+        return;
+    }
+    if (x0 < clip_.x0) {
+        x0 = clip_.x0;
+    }
+    if (x1 > clip_.x1) {
+        x1 = clip_.x1;
+    }
+    if (x0 > x1) {
+        return;
+    }
+
+    /* Partial words at either end, whole words in between */
+    uint64_t* row = &words_[static_cast<size_t>(y) * wordsPerRow_];
+    int first = x0 / 64;
+    int last = x1 / 64;
+    uint64_t low = ~uint64_t(0) << (x0 % 64);
+    uint64_t high = ~uint64_t(0) >> (63 - x1 % 64);
+    if (first == last) {
+        row[first] |= low & high;
+        return;
+    }
+    row[first] |= low;
+    std::fill(row + first + 1, row + last, ~uint64_t(0));
+    row[last] |= high;
+    return;
+}
+
+bool BitCanvas::test(int x, int y) const {
+    if (x < 0 || x >= width_ || y < 0 || y >= height_) {
+        return false;
+    }
+    return (words_[static_cast<size_t>(y) * wordsPerRow_ + x / 64] >> (x % 64)) & 1;
+}
+
+void BitCanvas::checkSize_(const BitCanvas& other) const {
+    if (other.width_ != width_ || other.height_ != height_) {
+        throw std::invalid_argument("canvases of different sizes.");
+    }
+    return;
+}
+
+void BitCanvas::unite(const BitCanvas& other) {
+    checkSize_(other);
+    for (size_t i = 0; i < words_.size(); i++) {
+        words_[i] |= other.words_[i];
+    }
+    return;
+}
+
+void BitCanvas::uniteOverlap(const BitCanvas& other) {
+    int rows = std::min(height_, other.height_);
+    int words = std::min(wordsPerRow_, other.wordsPerRow_);
+    /* Bits past the end of a row stay clear, so a wider other is masked */
+    uint64_t last = (width_ % 64 == 0) ? ~uint64_t(0) : ~uint64_t(0) >> (64 - width_ % 64);
+    for (int y = 0; y < rows; y++) {
+        uint64_t* row = &words_[static_cast<size_t>(y) * wordsPerRow_];
+        const uint64_t* from = &other.words_[static_cast<size_t>(y) * other.wordsPerRow_];
+        for (int w = 0; w < words; w++) {
+            row[w] |= from[w];
+        }
+        if (other.width_ > width_) {
+            row[wordsPerRow_ - 1] &= last;
+        }
+    }
+    return;
+}
+
+void BitCanvas::intersect(const BitCanvas& other) {
+    checkSize_(other);
+    for (size_t i = 0; i < words_.size(); i++) {
+        words_[i] &= other.words_[i];
+    }
+    return;
+}
+
+void BitCanvas::subtract(const BitCanvas& other) {
+    checkSize_(other);
+    for (size_t i = 0; i < words_.size(); i++) {
+        words_[i] &= ~other.words_[i];
+    }
+    return;
+}
+
+size_t BitCanvas::count() const {
+    size_t total = 0;
+    for (uint64_t word : words_) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
+
+size_t BitCanvas::countCommon(const BitCanvas& other) const {
+    checkSize_(other);
+    size_t total = 0;
+    for (size_t i = 0; i < words_.size(); i++) {
+        total += __builtin_popcountll(words_[i] & other.words_[i]);
+    }
+    return total;
+}
+
+int BitCanvas::width() const {
+    return width_;
+}
+
+int BitCanvas::height() const {
+    return height_;
+}
+
+int BitCanvas::wordsPerRow() const {
+    return wordsPerRow_;
+}
+
+const uint64_t* BitCanvas::data() const {
+    return words_.data();
+}
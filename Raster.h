@@ -0,0 +1,312 @@
+#ifndef RASTER_H_
+#define RASTER_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Inclusive range of cells x0..x1 by y0..y1, in scene co-ordinates
+struct CellRect {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+class DepthBuffer;
+
+/*
+ * A flat character framebuffer of width * height cells. Rows are kept
+ * top to bottom, each one followed by '\n', so a finished page is
+ * emitted with a single write. Cells are addressed in scene
+ * co-ordinates: the bottom-left cell of the buffer is (xOrigin,
+ * yOrigin), so a buffer can hold one band or tile of a larger scene.
+ */
+class FrameBuffer {
+
+    public:
+        // Default constructor is not meaningful without a size
+        FrameBuffer() = delete;
+
+        // Constructor. Allocate a blank page of width * height cells whose
+        // bottom-left cell is (xOrigin, yOrigin).
+        FrameBuffer(int width, int height, int xOrigin = 0, int yOrigin = 0);
+
+        // Reset every cell to blank, keeping the allocation
+        void clear();
+
+        // Set every cell from cells, laid out as the page is: height() rows
+        // of width() cells, top row first, each followed by one character
+        // that is not read
+        void load(const char* cells);
+
+        // Mark the cell (x, y). Cells outside the clip rectangle are ignored.
+        void plot(int x, int y);
+
+        // Mark the cells x0..x1 (inclusive) of row y, clipped to the clip
+        // rectangle
+        void fillSpan(int y, int x0, int x1);
+
+        // Blank the cells of r that lie on the page
+        void clearRect(const CellRect& r);
+
+        // Restrict drawing to the cells of r that lie on the page
+        void setClip(const CellRect& r);
+
+        // Allow drawing on the whole page again
+        void resetClip();
+
+        // Move the page so that its bottom-left cell is (xOrigin, yOrigin).
+        // Cell contents are kept and the clip covers the whole page again.
+        void setOrigin(int xOrigin, int yOrigin);
+
+        // Copy the cells of r that lie on both pages from other
+        void copyRect(const FrameBuffer& other, const CellRect& r);
+
+        // Set the cells of r that lie on both pages to glyphs[id], where id
+        // is the shape depth holds for the cell. A cell holding none is set
+        // to the same cell of background, or to blank if background is null
+        // or does not have it.
+        void paint(const DepthBuffer& depth, const CellRect& r,
+                const std::vector<char>& glyphs, const FrameBuffer* background = nullptr);
+
+        // As above, but with ink for every shape
+        void paint(const DepthBuffer& depth, const CellRect& r,
+                const FrameBuffer* background = nullptr);
+
+        // Return the cells drawing is currently restricted to
+        const CellRect& clip() const;
+
+        // Return the cells of the whole page
+        CellRect page() const;
+
+        // Return the cell (x, y), or blank if it is off the page
+        char at(int x, int y) const;
+
+        // Return the number of columns of the page
+        int width() const;
+
+        // Return the number of rows of the page
+        int height() const;
+
+        // Write the whole page to out with a single call
+        void write(std::ostream& out) const;
+
+        // Glyphs for empty and covered cells
+        static constexpr char blank = ' ';
+        static constexpr char ink = '*';
+
+    private:
+        // Return the first cell of row y
+        char* row_(int y);
+        const char* row_(int y) const;
+
+        int width_;
+        int height_;
+        int xOrigin_;
+        int yOrigin_;
+        // Cells plot() and fillSpan() may touch, never larger than the page
+        CellRect clip_;
+        // height_ rows of width_ cells, each row terminated by '\n'
+        std::string page_;
+};
+
+/*
+ * A depth buffer of width * height cells, each holding the id and depth
+ * of the nearest shape drawn over it so far. Shapes are drawn through the
+ * same plot() and fillSpan() calls as on a FrameBuffer, once setSource()
+ * has named the shape. A cell keeps the shape of smallest depth, and of
+ * largest id between equal depths, so the result does not depend on the
+ * order shapes are drawn in. Cells are addressed as in FrameBuffer.
+ */
+class DepthBuffer {
+
+    public:
+        // Default constructor is not meaningful without a size
+        DepthBuffer() = delete;
+
+        // Constructor. Allocate an empty page of width * height cells whose
+        // bottom-left cell is (xOrigin, yOrigin).
+        DepthBuffer(int width, int height, int xOrigin = 0, int yOrigin = 0);
+
+        // Empty every cell, keeping the allocation
+        void clear();
+
+        // Move the page so that its bottom-left cell is (xOrigin, yOrigin).
+        // Cell contents are kept and the clip covers the whole page again.
+        void setOrigin(int xOrigin, int yOrigin);
+
+        // Restrict drawing to the cells of r that lie on the page
+        void setClip(const CellRect& r);
+
+        // Allow drawing on the whole page again
+        void resetClip();
+
+        // Return the cells drawing is currently restricted to
+        const CellRect& clip() const;
+
+        // Return the cells of the whole page
+        CellRect page() const;
+
+        // Draw the following cells as the shape id at depth d
+        void setSource(int id, int d);
+
+        // Offer the cell (x, y) to the current shape. Cells outside the clip
+        // rectangle are ignored.
+        void plot(int x, int y);
+
+        // Offer the cells x0..x1 (inclusive) of row y to the current shape,
+        // clipped to the clip rectangle
+        void fillSpan(int y, int x0, int x1);
+
+        // Return the id of the shape holding cell (x, y), or none
+        int idAt(int x, int y) const;
+
+        // Id of the cells no shape has been drawn over
+        static constexpr int none = -1;
+
+    private:
+        // Offer the cell at index to the current shape
+        void offer_(size_t index);
+
+        int width_;
+        int height_;
+        int xOrigin_;
+        int yOrigin_;
+        // Cells plot() and fillSpan() may touch, never larger than the page
+        CellRect clip_;
+        // Shape being drawn
+        int id_;
+        int depth_;
+        // Id and depth of every cell, bottom row first
+        std::vector<int> ids_;
+        std::vector<int> depths_;
+};
+
+/*
+ * The id of the shape shown in every cell of a width * height page whose
+ * bottom-left cell is (0, 0), so that finding what lies under a cell is a
+ * single lookup. Ids are copied in from a DepthBuffer.
+ */
+class PickBuffer {
+
+    public:
+        // Default constructor is not meaningful without a size
+        PickBuffer() = delete;
+
+        // Constructor. Allocate a page of width * height empty cells.
+        PickBuffer(int width, int height);
+
+        // Empty every cell, keeping the allocation
+        void clear();
+
+        // Copy the ids of the cells of r that lie on both pages from depth
+        void copyRect(const DepthBuffer& depth, const CellRect& r);
+
+        // Return the id in cell (x, y), or DepthBuffer::none if the cell is
+        // empty or off the page
+        int32_t at(int x, int y) const;
+
+        // Return the ids of all cells, row by row from the bottom
+        const int32_t* data() const;
+
+        // Return the number of columns of the page
+        int width() const;
+
+        // Return the number of rows of the page
+        int height() const;
+
+    private:
+        int width_;
+        int height_;
+        std::vector<int32_t> ids_;
+};
+
+/*
+ * A page of width * height cells holding one bit each, packed 64 cells to
+ * a word, whose bottom-left cell is (0, 0). Shapes are drawn on it through
+ * the same plot() and fillSpan() calls as on a FrameBuffer; whole words
+ * are set at once, and canvases of the same size are combined and
+ * counted a word at a time. Every row starts on a new word, and bits past
+ * the end of a row are always clear.
+ */
+class BitCanvas {
+
+    public:
+        // Default constructor is not meaningful without a size
+        BitCanvas() = delete;
+
+        // Constructor. Allocate a page of width * height clear cells.
+        // If either is zero or negative, throw a std::invalid_argument exception.
+        BitCanvas(int width, int height);
+
+        // Clear every cell, keeping the allocation
+        void clear();
+
+        // Restrict drawing to the cells of r that lie on the page
+        void setClip(const CellRect& r);
+
+        // Allow drawing on the whole page again
+        void resetClip();
+
+        // Return the cells drawing is currently restricted to
+        const CellRect& clip() const;
+
+        // Set the cell (x, y). Cells outside the clip rectangle are ignored.
+        void plot(int x, int y);
+
+        // Set the cells x0..x1 (inclusive) of row y, clipped to the clip
+        // rectangle
+        void fillSpan(int y, int x0, int x1);
+
+        // Return true if the cell (x, y) is on the page and set
+        bool test(int x, int y) const;
+
+        // Set the cells set in other. The two must be the same size,
+        // otherwise throw a std::invalid_argument exception; the same goes
+        // for intersect() and subtract().
+        void unite(const BitCanvas& other);
+
+        // As unite(), for canvases of any sizes: set the cells set in other
+        // that also lie on this page
+        void uniteOverlap(const BitCanvas& other);
+
+        // Keep only the cells also set in other
+        void intersect(const BitCanvas& other);
+
+        // Clear the cells set in other
+        void subtract(const BitCanvas& other);
+
+        // Return the number of cells set
+        size_t count() const;
+
+        // Return the number of cells set both here and in other, without
+        // changing either. Sizes must match as for intersect().
+        size_t countCommon(const BitCanvas& other) const;
+
+        // Return the number of columns of the page
+        int width() const;
+
+        // Return the number of rows of the page
+        int height() const;
+
+        // Return the number of words of each row
+        int wordsPerRow() const;
+
+        // Return the words of all rows, bottom row first
+        const uint64_t* data() const;
+
+    private:
+        // Throw unless other has the same size
+        void checkSize_(const BitCanvas& other) const;
+
+        int width_;
+        int height_;
+        int wordsPerRow_;
+        // Cells plot() and fillSpan() may touch, never larger than the page
+        CellRect clip_;
+        std::vector<uint64_t> words_;
+};
+
+#endif /* RASTER_H_ */
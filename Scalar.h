@@ -0,0 +1,262 @@
+#ifndef SCALAR_H_
+#define SCALAR_H_
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+/*
+ * A signed 16.16 fixed-point number: a 32-bit integer counting 1/65536ths.
+ * It holds -32768 up to 32768 - 1/65536 in steps of 1/65536, so whole and
+ * half co-ordinates are exact, and its arithmetic is integer arithmetic
+ * throughout. As for int, results out of range are undefined. Products
+ * and quotients are truncated towards minus infinity.
+ */
+class Fixed16 {
+
+    public:
+        // Default constructor leaves the value unset, as for built-in types
+        Fixed16() = default;
+
+        // Constructor for the whole number v. Only integers convert
+        // implicitly, so a float is never silently truncated.
+        template <class Int, typename std::enable_if<std::is_integral<Int>::value, int>::type = 0>
+        constexpr Fixed16(Int v) : raw_(static_cast<int32_t>(v * 65536)) {
+        }
+
+        // Constructor for the nearest value to v, halves rounded away from
+        // zero. Floating point is used here only, to bring values in.
+        explicit constexpr Fixed16(double v) :
+            raw_(static_cast<int32_t>(v * 65536 + ((v < 0) ? -0.5 : 0.5))) {
+        }
+
+        // Return the number of 1/65536ths raw
+        static constexpr Fixed16 fromRaw(int32_t raw) {
+            return Fixed16(raw, 0);
+        }
+
+        // Return the number of 1/65536ths held
+        constexpr int32_t raw() const {
+            return raw_;
+        }
+
+        // Return the value as a double, to print or compare
+        explicit constexpr operator double() const {
+            return raw_ / 65536.0;
+        }
+
+        constexpr Fixed16& operator+=(Fixed16 v) {
+            raw_ += v.raw_;
+            return *this;
+        }
+
+        constexpr Fixed16& operator-=(Fixed16 v) {
+            raw_ -= v.raw_;
+            return *this;
+        }
+
+        constexpr Fixed16& operator*=(Fixed16 v) {
+            raw_ = static_cast<int32_t>((static_cast<int64_t>(raw_) * v.raw_) >> 16);
+            return *this;
+        }
+
+        constexpr Fixed16& operator/=(Fixed16 v) {
+            raw_ = static_cast<int32_t>(static_cast<int64_t>(raw_) * 65536 / v.raw_);
+            return *this;
+        }
+
+    private:
+        constexpr Fixed16(int32_t raw, int) : raw_(raw) {
+        }
+
+        int32_t raw_;
+};
+
+inline constexpr Fixed16 operator+(Fixed16 a, Fixed16 b) {
+    return a += b;
+}
+
+inline constexpr Fixed16 operator-(Fixed16 a, Fixed16 b) {
+    return a -= b;
+}
+
+inline constexpr Fixed16 operator-(Fixed16 a) {
+    return Fixed16::fromRaw(-a.raw());
+}
+
+inline constexpr Fixed16 operator*(Fixed16 a, Fixed16 b) {
+    return a *= b;
+}
+
+inline constexpr Fixed16 operator/(Fixed16 a, Fixed16 b) {
+    return a /= b;
+}
+
+inline constexpr bool operator==(Fixed16 a, Fixed16 b) {
+    return a.raw() == b.raw();
+}
+
+inline constexpr bool operator!=(Fixed16 a, Fixed16 b) {
+    return a.raw() != b.raw();
+}
+
+inline constexpr bool operator<(Fixed16 a, Fixed16 b) {
+    return a.raw() < b.raw();
+}
+
+inline constexpr bool operator<=(Fixed16 a, Fixed16 b) {
+    return a.raw() <= b.raw();
+}
+
+inline constexpr bool operator>(Fixed16 a, Fixed16 b) {
+    return a.raw() > b.raw();
+}
+
+inline constexpr bool operator>=(Fixed16 a, Fixed16 b) {
+    return a.raw() >= b.raw();
+}
+
+/*
+ * The operations the shape values need beyond + - * / and comparison,
+ * one overload per scalar type: float, double and Fixed16. The Fixed16
+ * overloads use integers only, so shapes and drawing in Fixed16 never
+ * touch floating point. All but the float and double roots are
+ * constexpr, so shapes can be measured, moved and drawn at compile time.
+ */
+namespace scalar {
+
+// Return the greatest whole number not above v. For float and double,
+// values beyond int saturate to its least or greatest value, since
+// converting them to int is undefined, and NaN gives the least.
+inline constexpr int floorInt(double v) {
+    if (!(v >= -2147483648.0)) {
+        return std::numeric_limits<int>::min();
+    }
+    if (v >= 2147483648.0) {
+        return std::numeric_limits<int>::max();
+    }
+    int whole = static_cast<int>(v);
+    return (whole > v) ? whole - 1 : whole;
+}
+
+inline constexpr int floorInt(float v) {
+    /* Every float is exactly a double */
+    return floorInt(static_cast<double>(v));
+}
+
+inline constexpr int floorInt(Fixed16 v) {
+    /* Right shifts of negative numbers are arithmetic on every compiler
+     * this builds with, so the shift rounds down */
+    return v.raw() >> 16;
+}
+
+// Return the least whole number not below v, saturating as floorInt()
+// does but with NaN giving the greatest, so that a span from ceilInt() to
+// floorInt() of NaN edges is empty
+inline constexpr int ceilInt(double v) {
+    if (v <= -2147483649.0) {
+        return std::numeric_limits<int>::min();
+    }
+    if (!(v <= 2147483647.0)) {
+        return std::numeric_limits<int>::max();
+    }
+    int whole = static_cast<int>(v);
+    return (whole < v) ? whole + 1 : whole;
+}
+
+inline constexpr int ceilInt(float v) {
+    return ceilInt(static_cast<double>(v));
+}
+
+inline constexpr int ceilInt(Fixed16 v) {
+    return (static_cast<int64_t>(v.raw()) + 65535) >> 16;
+}
+
+// Return v truncated towards zero, as the shape classes truncate centres
+// and half sizes through int
+inline constexpr float truncate(float v) {
+    return static_cast<int>(v);
+}
+
+inline constexpr double truncate(double v) {
+    /* From 2^52 up every double is a whole number already */
+    return (v < 4503599627370496.0 && v > -4503599627370496.0) ?
+        static_cast<double>(static_cast<long long>(v)) : v;
+}
+
+inline constexpr Fixed16 truncate(Fixed16 v) {
+    int64_t raw = v.raw();
+    return Fixed16::fromRaw((raw >= 0) ? raw / 65536 * 65536 : -(-raw / 65536 * 65536));
+}
+
+// Return v squared, in a type wide enough for sums of squares: for
+// Fixed16, an integer counting 1/2^32ths. Wide<T> below names the type.
+inline constexpr float square(float v) {
+    return v * v;
+}
+
+inline constexpr double square(double v) {
+    return v * v;
+}
+
+inline constexpr int64_t square(Fixed16 v) {
+    return static_cast<int64_t>(v.raw()) * v.raw();
+}
+
+// Return the square root of a sum of squares w, w not negative
+inline float root(float w) {
+    return std::sqrt(w);
+}
+
+inline double root(double w) {
+    return std::sqrt(w);
+}
+
+inline constexpr Fixed16 root(int64_t w) {
+    /*
+     * The root of a count of 1/2^32ths counts 1/65536ths. Newton's method
+     * from a power of two above the root comes down to its floor without
+     * overshooting, in a handful of steps.
+     */
+    uint64_t n = w;
+    if (n < 2) {
+        return Fixed16::fromRaw(static_cast<int32_t>(n));
+    }
+    int bits = 0;
+#ifdef __GNUC__
+    bits = 64 - __builtin_clzll(n);
+#else
+    for (uint64_t rest = n; rest != 0; rest >>= 1) {
+        bits++;
+    }
+#endif
+    uint64_t x = uint64_t(1) << ((bits + 1) / 2);
+    for (uint64_t next = (x + n / x) / 2; next < x; next = (x + n / x) / 2) {
+        x = next;
+    }
+    return Fixed16::fromRaw(static_cast<int32_t>(x));
+}
+
+// Return the area of the disk of radius r, with pi as Shape::PI
+inline constexpr float discArea(float r) {
+    return 3.1415926 * (double(r) * r);
+}
+
+inline constexpr double discArea(double r) {
+    return 3.1415926 * (r * r);
+}
+
+inline constexpr Fixed16 discArea(Fixed16 r) {
+    /* 205887 is pi in 1/65536ths */
+    return Fixed16::fromRaw(static_cast<int32_t>((square(r) >> 16) * 205887 >> 16));
+}
+
+// The type square() gives for T
+template <class T>
+using Wide = decltype(square(std::declval<T>()));
+
+}
+
+#endif /* SCALAR_H_ */
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Geometry.h"
+#include "Kernels.h"
+#include "SceneFile.h"
+
+namespace {
+
+// Layout of the first 64 bytes of a scene file
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t count;
+    int32_t width;
+    int32_t height;
+    uint64_t checksum;
+    uint64_t reserved[3];
+};
+
+static_assert(sizeof(Header) == 64, "scene file header must be 64 bytes.");
+
+const char magic[8] = { 'G', 'E', 'O', 'S', 'C', 'E', 'N', 'E' };
+
+// Every column starts on a multiple of this many bytes
+const size_t align = 64;
+
+// Number of float columns: x0, y0, x1, y1 and r
+const int floatColumns = 5;
+
+size_t alignUp(size_t n) {
+    return (n + align - 1) / align * align;
+}
+
+// Byte offset of every column in a file of count shapes, followed by the
+// length of the whole file
+struct Layout {
+    size_t kinds;
+    size_t depths;
+    size_t floats[floatColumns];
+    size_t length;
+
+    explicit Layout(uint64_t count) {
+        kinds = sizeof(Header);
+        depths = alignUp(kinds + count);
+        size_t at = alignUp(depths + count * sizeof(int32_t));
+        for (int c = 0; c < floatColumns; c++) {
+            floats[c] = at;
+            at = alignUp(at + count * sizeof(float));
+        }
+        length = at;
+    }
+};
+
+// FNV-1a taken over 64-bit words instead of bytes, so that checking a file
+// runs at memory speed; a short tail is padded with zeros
+uint64_t checksum(const char* data, size_t n) {
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    if (i < n) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, n - i);
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Write a shape's fields into entry i of the columns
+struct ToColumns {
+    float* x0;
+    float* y0;
+    float* x1;
+    float* y1;
+    float* r;
+    size_t i;
+
+    void set(float a, float b, float c, float d, float radius) const {
+        x0[i] = a;
+        y0[i] = b;
+        x1[i] = c;
+        y1[i] = d;
+        r[i] = radius;
+    }
+    void operator()(const PointValue& p) const {
+        set(p.x, p.y, p.x, p.y, 0);
+    }
+    void operator()(const SegmentValue& s) const {
+        set(s.xMin, s.yMin, s.xMax, s.yMax, 0);
+    }
+    void operator()(const RectangleValue& r) const {
+        set(r.xMin, r.yMin, r.xMax, r.yMax, 0);
+    }
+    void operator()(const CircleValue& c) const {
+        set(c.x, c.y, c.x, c.y, c.r);
+    }
+};
+
+}
+
+// ============== SceneFile class ================
+
+constexpr uint32_t SceneFile::version;
+
+SceneFile::SceneFile(const std::string& path) : base_(nullptr), length_(0) {
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open scene file.");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot read scene file size.");
+    }
+    length_ = st.st_size;
+    if (length_ < sizeof(Header)) {
+        close(fd);
+        throw std::invalid_argument("scene file too short.");
+    }
+    void* map = mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("cannot map scene file.");
+    }
+    base_ = static_cast<const char*>(map);
+
+    /* Check the header, then the size it implies, then the contents */
+    Header h;
+    std::memcpy(&h, base_, sizeof(Header));
+    const char* error = nullptr;
+    if (std::memcmp(h.magic, magic, sizeof(magic)) != 0) {
+        error = "not a scene file.";
+    } else if (h.version != version || h.headerSize != sizeof(Header)) {
+        error = "unsupported scene file version.";
+    } else if (h.count > length_ || Layout(h.count).length != length_) {
+        error = "scene file size does not match its count.";
+    } else if (h.width <= 0 || h.height <= 0) {
+        error = "zero or negative drawing area.";
+    } else if (checksum(base_ + sizeof(Header), length_ - sizeof(Header)) != h.checksum) {
+        error = "scene file checksum mismatch.";
+    }
+    if (error) {
+        munmap(const_cast<char*>(base_), length_);
+        throw std::invalid_argument(error);
+    }
+
+    size_ = h.count;
+    width_ = h.width;
+    height_ = h.height;
+    Layout layout(size_);
+    kinds_ = reinterpret_cast<const uint8_t*>(base_ + layout.kinds);
+    depths_ = reinterpret_cast<const int32_t*>(base_ + layout.depths);
+    for (int c = 0; c < floatColumns; c++) {
+        columns_[c] = reinterpret_cast<const float*>(base_ + layout.floats[c]);
+    }
+}
+
+SceneFile::~SceneFile() {
+    munmap(const_cast<char*>(base_), length_);
+}
+
+void SceneFile::write(const Scene& s, const std::string& path) {
+
+    /* Assemble the whole file in memory, so it is written in one call */
+    size_t count = s.size();
+    Layout layout(count);
+    std::vector<char> file(layout.length, 0);
+    char* base = file.data();
+
+    uint8_t* kinds = reinterpret_cast<uint8_t*>(base + layout.kinds);
+    int32_t* depths = reinterpret_cast<int32_t*>(base + layout.depths);
+    float* floats[floatColumns];
+    for (int c = 0; c < floatColumns; c++) {
+        floats[c] = reinterpret_cast<float*>(base + layout.floats[c]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        const ShapeValue& v = s.value(i);
+        kinds[i] = v.kind();
+        depths[i] = v.depth();
+        v.visit(ToColumns { floats[0], floats[1], floats[2], floats[3], floats[4], i });
+    }
+
+    Header h;
+    std::memset(&h, 0, sizeof(Header));
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.headerSize = sizeof(Header);
+    h.count = count;
+    h.width = s.width();
+    h.height = s.height();
+    h.checksum = checksum(base + sizeof(Header), layout.length - sizeof(Header));
+    std::memcpy(base, &h, sizeof(Header));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(base, file.size());
+    out.close();
+    if (!out) {
+        throw std::runtime_error("cannot write scene file.");
+    }
+    return;
+}
+
+size_t SceneFile::size() const {
+    return size_;
+}
+
+int SceneFile::width() const {
+    return width_;
+}
+
+int SceneFile::height() const {
+    return height_;
+}
+
+const uint8_t* SceneFile::kinds() const {
+    return kinds_;
+}
+
+const int32_t* SceneFile::depths() const {
+    return depths_;
+}
+
+const float* SceneFile::x0() const {
+    return columns_[0];
+}
+
+const float* SceneFile::y0() const {
+    return columns_[1];
+}
+
+const float* SceneFile::x1() const {
+    return columns_[2];
+}
+
+const float* SceneFile::y1() const {
+    return columns_[3];
+}
+
+const float* SceneFile::r() const {
+    return columns_[4];
+}
+
+ShapeValue SceneFile::value(size_t i) const {
+    float a = columns_[0][i];
+    float b = columns_[1][i];
+    float c = columns_[2][i];
+    float d = columns_[3][i];
+    int depth = depths_[i];
+    switch (kinds_[i]) {
+        case ShapeValue::POINT:
+            return ShapeValue(PointValue { a, b }, depth);
+        case ShapeValue::SEGMENT:
+            return ShapeValue(SegmentValue { a, b, c, d }, depth);
+        case ShapeValue::RECTANGLE:
+            return ShapeValue(RectangleValue { a, b, c, d }, depth);
+        case ShapeValue::CIRCLE:
+            return ShapeValue(CircleValue { a, b, columns_[4][i] }, depth);
+        default:
+            throw std::invalid_argument("unknown shape kind.");
+    }
+}
+
+void SceneFile::containing(float px, float py, std::vector<int>& ids) const {
+
+    /*
+     * Every entry is tested as a box and, where the word holds circles,
+     * as a circle too, 64 entries at a time; its kind picks the answer.
+     * Points keep (x, y) as both corners, so the box test is theirs too.
+     */
+    for (size_t first = 0; first < size_; first += 64) {
+        size_t n = std::min<size_t>(64, size_ - first);
+        uint64_t isBox = 0, isCircle = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint8_t kind = kinds_[first + i];
+            isBox |= uint64_t(kind <= ShapeValue::RECTANGLE) << i;
+            isCircle |= uint64_t(kind == ShapeValue::CIRCLE) << i;
+        }
+        uint64_t boxes = 0, circles = 0;
+        batch::boxesContaining(x0() + first, y0() + first, x1() + first, y1() + first,
+                n, px, py, &boxes);
+        if (isCircle != 0) {
+            batch::circlesContaining(x0() + first, y0() + first, r() + first, n, px, py, &circles);
+        }
+        for (uint64_t bits = (boxes & isBox) | (circles & isCircle); bits != 0; bits &= bits - 1) {
+            ids.push_back(static_cast<int>(first + batch::lowestBit(bits)));
+        }
+    }
+    return;
+}
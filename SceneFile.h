@@ -0,0 +1,94 @@
+#ifndef SCENEFILE_H_
+#define SCENEFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ShapeValue.h"
+
+class Scene;
+
+/*
+ * A scene saved in a compact binary file, mapped into memory read-only.
+ *
+ * The file is a 64 byte header followed by one column per field, each
+ * starting on a 64 byte boundary: kind (uint8_t, a ShapeValue::Kind),
+ * depth (int32_t), and x0, y0, x1, y1 and r (float). Shape i is entry i of
+ * every column. Points store (x, y, x, y), segments and rectangles their
+ * corners, and circles their centre twice and their radius in r, which
+ * is 0 for the other kinds. The header holds a magic string, the format
+ * version, the shape count, the drawing area and a checksum of
+ * everything after the header. Numbers are in the byte order of the
+ * machine that wrote the file.
+ *
+ * The columns are used where they lie in the mapping, so opening a file
+ * costs one pass for the checksum and nothing per shape, and containing()
+ * runs the batch kernels of Kernels.h over them in place. A Scene made
+ * from the file copies every shape into its own storage and indexes it
+ * instead; that costs one Scene::add() per shape.
+ */
+class SceneFile {
+
+    public:
+        // Default constructor is not meaningful without a file
+        SceneFile() = delete;
+
+        // Map the scene file at path and check it.
+        // If the file cannot be opened or mapped, throw a std::runtime_error
+        // exception; if it is not a scene file of this version, or its
+        // size or checksum is wrong, throw a std::invalid_argument exception.
+        explicit SceneFile(const std::string& path);
+
+        // A mapping is owned by one object, so it is not copied
+        SceneFile(const SceneFile&) = delete;
+        SceneFile& operator=(const SceneFile&) = delete;
+
+        // Destructor. Unmap the file.
+        ~SceneFile();
+
+        // Write the shapes of s, in slot order, and its drawing area to path.
+        // If the file cannot be written, throw a std::runtime_error exception.
+        static void write(const Scene& s, const std::string& path);
+
+        // Return the number of shapes in the file
+        size_t size() const;
+
+        // Return the size of the drawing area saved
+        int width() const;
+        int height() const;
+
+        // Return the columns, each of size() entries
+        const uint8_t* kinds() const;
+        const int32_t* depths() const;
+        const float* x0() const;
+        const float* y0() const;
+        const float* x1() const;
+        const float* y1() const;
+        const float* r() const;
+
+        // Return shape i as a value.
+        // If its kind is unknown, throw a std::invalid_argument exception.
+        ShapeValue value(size_t i) const;
+
+        // Append to ids the index of every shape containing (px, py), in
+        // increasing order, with the answers of ShapeValue::contains().
+        // Shapes of unknown kind contain nothing.
+        void containing(float px, float py, std::vector<int>& ids) const;
+
+        // Format version written and accepted
+        static constexpr uint32_t version = 1;
+
+    private:
+        const char* base_;
+        size_t length_;
+        size_t size_;
+        int width_;
+        int height_;
+        // Start of every column within the mapping
+        const uint8_t* kinds_;
+        const int32_t* depths_;
+        const float* columns_[5];
+};
+
+#endif /* SCENEFILE_H_ */
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "SceneReader.h"
+#include "ShapeFactory.h"
+
+namespace {
+
+// Powers of ten a float holds exactly
+const float exactPowers[11] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+void skipBlanks(const char*& p, const char* end) {
+    while (p < end && isBlank(*p)) {
+        p++;
+    }
+}
+
+/*
+ * Parse the decimal number at p, such as "-12", "3.25" or "1e-3", and
+ * move p past it. The result is the float strtof() would give: when the
+ * digits and exponent are small enough for a float to hold both exactly,
+ * one correctly rounded multiply or divide gives it; the rare number that
+ * is not goes through strtof() itself. Return false if there is no
+ * number at p or it is out of range.
+ */
+bool parseFloat(const char*& p, const char* end, float& out) {
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; p < end && isDigit(*p); p++) {
+        any = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += (mantissa != 0);
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += (mantissa != 0);
+                exponent--;
+            }
+        }
+    }
+    if (!any) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExp = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExp = (*p == '-');
+            p++;
+        }
+        if (p == end || !isDigit(*p)) {
+            return false;
+        }
+        int e = 0;
+        for (; p < end && isDigit(*p); p++) {
+            e = std::min(e * 10 + (*p - '0'), 100000);
+        }
+        exponent += negativeExp ? -e : e;
+    }
+
+    if (mantissa == 0) {
+        out = negative ? -0.0f : 0.0f;
+        return true;
+    }
+    if (mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10) {
+        float f = static_cast<float>(mantissa);
+        f = (exponent < 0) ? f / exactPowers[-exponent] : f * exactPowers[exponent];
+        out = negative ? -f : f;
+        return true;
+    }
+
+    /*
+     * Too many digits or too large an exponent for the fast path. The
+     * number is copied to be terminated: on the stack if it is short, as
+     * nearly all are, or else into a string, no longer than the line.
+     */
+    char copy[64];
+    size_t length = p - start;
+    if (length < sizeof(copy)) {
+        std::memcpy(copy, start, length);
+        copy[length] = '\0';
+        out = std::strtof(copy, nullptr);
+    } else {
+        out = std::strtof(std::string(start, length).c_str(), nullptr);
+    }
+    return std::isfinite(out);
+}
+
+// Parse the decimal integer at p and move p past it
+bool parseInt(const char*& p, const char* end, int& out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p == end || !isDigit(*p)) {
+        return false;
+    }
+    long long value = 0;
+    for (; p < end && isDigit(*p); p++) {
+        value = value * 10 + (*p - '0');
+        if (value > INT_MAX) {
+            return false;
+        }
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+// A field must be followed by a blank or the end of the line
+bool fieldEnds(const char* p, const char* end) {
+    return p == end || isBlank(*p);
+}
+
+// Record kinds and the number of coordinates before their depth
+struct Keyword {
+    const char* name;
+    size_t length;
+    ShapeValue::Kind kind;
+    int coordinates;
+};
+
+const Keyword keywords[4] = {
+    { "point", 5, ShapeValue::POINT, 2 },
+    { "segment", 7, ShapeValue::SEGMENT, 4 },
+    { "rect", 4, ShapeValue::RECTANGLE, 4 },
+    { "circle", 6, ShapeValue::CIRCLE, 3 },
+};
+
+// Make the shape of a record from its coordinates c and depth
+ShapeResult make(ShapeValue::Kind kind, const float* c, int depth) {
+    switch (kind) {
+        case ShapeValue::POINT:
+            return makePoint(c[0], c[1], depth);
+        case ShapeValue::SEGMENT:
+            return makeLineSegment(c[0], c[1], c[2], c[3], depth);
+        case ShapeValue::RECTANGLE:
+            return makeRectangle(c[0], c[1], c[2], c[3], depth);
+        default:
+            return makeCircle(c[0], c[1], c[2], depth);
+    }
+}
+
+}
+
+// ============== SceneReader class ================
+
+constexpr size_t SceneReader::maxErrors;
+
+SceneReader::SceneReader(Scene& scene, size_t chunkSize) : scene_(scene),
+    chunkSize_(chunkSize), lines_(0), added_(0), errorCount_(0), tooLong_(false) {
+
+    if (chunkSize == 0) {
+        throw std::invalid_argument("zero chunk size.");
+    }
+}
+
+size_t SceneReader::read(std::istream& in) {
+    size_t before = added_;
+    std::vector<char> chunk(chunkSize_);
+    while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0) {
+        feed(chunk.data(), in.gcount());
+    }
+    finish();
+    return added_ - before;
+}
+
+void SceneReader::feed(const char* data, size_t n) {
+    const char* end = data + n;
+    while (data < end) {
+        const char* newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+        const char* lineEnd = newline ? newline : end;
+        if (partial_.size() + (lineEnd - data) > chunkSize_) {
+            tooLong_ = true;
+            partial_.clear();
+        } else if (!tooLong_ && (!partial_.empty() || !newline)) {
+            partial_.insert(partial_.end(), data, lineEnd);
+        }
+        if (!newline) {
+            /* The rest of the line comes with the next chunk */
+            return;
+        }
+
+        lines_++;
+        if (tooLong_) {
+            error_("line too long.");
+        } else if (partial_.empty()) {
+            /* The whole line is in this chunk, so it is read in place */
+            line_(data, newline);
+        } else {
+            line_(partial_.data(), partial_.data() + partial_.size());
+        }
+        partial_.clear();
+        tooLong_ = false;
+        data = newline + 1;
+    }
+    return;
+}
+
+void SceneReader::finish() {
+    if (!partial_.empty() || tooLong_) {
+        lines_++;
+        if (tooLong_) {
+            error_("line too long.");
+        } else {
+            line_(partial_.data(), partial_.data() + partial_.size());
+        }
+        partial_.clear();
+        tooLong_ = false;
+    }
+    return;
+}
+
+size_t SceneReader::lines() const {
+    return lines_;
+}
+
+size_t SceneReader::added() const {
+    return added_;
+}
+
+size_t SceneReader::errorCount() const {
+    return errorCount_;
+}
+
+const std::vector<SceneReader::Error>& SceneReader::errors() const {
+    return errors_;
+}
+
+size_t SceneReader::chunkSize() const {
+    return chunkSize_;
+}
+
+void SceneReader::line_(const char* begin, const char* end) {
+    if (begin < end && end[-1] == '\r') {
+        end--;
+    }
+    const char* p = begin;
+    skipBlanks(p, end);
+    if (p == end || *p == '#') {
+        return;
+    }
+
+    /* Kind of record */
+    const char* word = p;
+    while (p < end && !isBlank(*p)) {
+        p++;
+    }
+    const Keyword* keyword = nullptr;
+    for (const Keyword& k : keywords) {
+        if (static_cast<size_t>(p - word) == k.length && std::memcmp(word, k.name, k.length) == 0) {
+            keyword = &k;
+        }
+    }
+    if (!keyword) {
+        error_("unknown shape kind.");
+        return;
+    }
+
+    /* Its coordinates, then its depth, then nothing more */
+    float c[4];
+    int depth;
+    for (int i = 0; i < keyword->coordinates; i++) {
+        skipBlanks(p, end);
+        if (p == end) {
+            error_("wrong number of fields.");
+            return;
+        }
+        if (!parseFloat(p, end, c[i]) || !fieldEnds(p, end)) {
+            error_("bad number.");
+            return;
+        }
+    }
+    skipBlanks(p, end);
+    if (p == end) {
+        error_("wrong number of fields.");
+        return;
+    }
+    if (!parseInt(p, end, depth) || !fieldEnds(p, end)) {
+        error_("bad number.");
+        return;
+    }
+    skipBlanks(p, end);
+    if (p != end) {
+        error_("wrong number of fields.");
+        return;
+    }
+
+    ShapeResult shape = make(keyword->kind, c, depth);
+    if (!shape) {
+        error_(shapeErrorMessage(shape.error()));
+        return;
+    }
+    scene_.add(shape.value());
+    added_++;
+    return;
+}
+
+void SceneReader::error_(const char* message) {
+    if (errors_.size() < maxErrors) {
+        errors_.push_back(Error { lines_, message });
+    }
+    errorCount_++;
+    return;
+}
@@ -0,0 +1,95 @@
+#ifndef SCENEREADER_H_
+#define SCENEREADER_H_
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include "Geometry.h"
+
+/*
+ * Reads shapes from line-oriented text into a Scene as it goes. Each line
+ * is one record, its fields separated by spaces or tabs:
+ *
+ *     point x y depth
+ *     segment x1 y1 x2 y2 depth
+ *     rect x1 y1 x2 y2 depth
+ *     circle x y r depth
+ *
+ * Blank lines and lines starting with '#' are skipped. Records are made
+ * into shapes by the factories of ShapeFactory.h, so they are checked by
+ * the rules the shape constructors enforce, and added by value. A bad
+ * record is not added; its line number and the reason are kept instead
+ * of throwing, and reading carries on with the next line.
+ *
+ * Text is taken in chunks of any size and lines may span chunks, so the
+ * reader holds at most one line, of at most chunkSize() bytes, whatever
+ * the length of the input. Only the first maxErrors errors are kept.
+ */
+class SceneReader {
+
+    public:
+        // A record that was not added
+        struct Error {
+            // Line of the record, from 1
+            size_t line;
+            // Why it was refused
+            const char* message;
+        };
+
+        // Default constructor is not meaningful without a scene
+        SceneReader() = delete;
+
+        // Constructor. Add the shapes read to scene, taking input in chunks
+        // of chunkSize bytes.
+        // If chunkSize is zero, throw a std::invalid_argument exception.
+        explicit SceneReader(Scene& scene, size_t chunkSize = 64 * 1024);
+
+        // Read in to its end, then finish(). Return the number of shapes
+        // added by this call.
+        size_t read(std::istream& in);
+
+        // Take the next n bytes of text. Complete lines are read at once;
+        // the rest is kept until more text arrives.
+        void feed(const char* data, size_t n);
+
+        // Read a last line left without a newline
+        void finish();
+
+        // Return the number of lines read so far
+        size_t lines() const;
+
+        // Return the number of shapes added so far
+        size_t added() const;
+
+        // Return the number of records refused so far
+        size_t errorCount() const;
+
+        // Return the first maxErrors records refused, in input order
+        const std::vector<Error>& errors() const;
+
+        // Return the chunk size, which is also the longest line accepted
+        size_t chunkSize() const;
+
+        // Number of errors kept
+        static constexpr size_t maxErrors = 100;
+
+    private:
+        // Read the record in [begin, end), without its newline
+        void line_(const char* begin, const char* end);
+
+        // Note an error on the current line
+        void error_(const char* message);
+
+        Scene& scene_;
+        size_t chunkSize_;
+        size_t lines_;
+        size_t added_;
+        size_t errorCount_;
+        std::vector<Error> errors_;
+        // Start of a line whose end has not arrived yet
+        std::vector<char> partial_;
+        // Whether the partial line has grown past chunkSize_
+        bool tooLong_;
+};
+
+#endif /* SCENEREADER_H_ */
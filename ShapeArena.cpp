@@ -0,0 +1,35 @@
+#include <cstdint>
+#include "Geometry.h"
+#include "ShapeArena.h"
+
+// ============== ShapeArena class ================
+
+constexpr size_t ShapeArena::blockSize;
+
+ShapeArena::ShapeArena() : next_(nullptr), end_(nullptr) {
+}
+
+ShapeArena::~ShapeArena() {
+    for (auto iter = shapes_.rbegin(); iter != shapes_.rend(); iter++) {
+        (*iter)->~Shape();
+    }
+}
+
+size_t ShapeArena::size() const {
+    return shapes_.size();
+}
+
+void* ShapeArena::allocate_(size_t size, size_t align) {
+
+    uintptr_t at = (reinterpret_cast<uintptr_t>(next_) + align - 1) & ~(uintptr_t(align) - 1);
+    if (next_ == nullptr || at + size > reinterpret_cast<uintptr_t>(end_)) {
+        /* new[] aligns for any fundamental type, which covers every shape */
+        size_t bytes = (size > blockSize) ? size : blockSize;
+        blocks_.emplace_back(new char[bytes]);
+        next_ = blocks_.back().get();
+        end_ = next_ + bytes;
+        at = reinterpret_cast<uintptr_t>(next_);
+    }
+    next_ = reinterpret_cast<char*>(at + size);
+    return reinterpret_cast<void*>(at);
+}
@@ -0,0 +1,71 @@
+#ifndef SHAPEARENA_H_
+#define SHAPEARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+class Shape;
+
+/*
+ * Storage for shapes that all live exactly as long as their owner.
+ * Shapes are constructed one after another in large blocks, so making
+ * one costs a pointer bump rather than a heap allocation, and they are
+ * destroyed and released together when the arena is. Shapes never move,
+ * so the pointers make() returns stay valid until then.
+ */
+class ShapeArena {
+
+    public:
+        // Constructor. Nothing is allocated until the first shape is made.
+        ShapeArena();
+
+        // Arenas own their shapes, so they cannot be copied
+        ShapeArena(const ShapeArena&) = delete;
+        ShapeArena& operator=(const ShapeArena&) = delete;
+
+        // Destroy every shape made, newest first, and release the blocks
+        ~ShapeArena();
+
+        // Construct a T from args in the arena and return it.
+        // Exceptions thrown by the constructor of T are passed on.
+        template <class T, class... Args>
+        T* make(Args&&... args);
+
+        // Return the number of shapes in the arena
+        size_t size() const;
+
+        // Size in bytes of each block
+        static constexpr size_t blockSize = 64 * 1024;
+
+    private:
+        // Return size bytes aligned to align, starting a new block if needed
+        void* allocate_(size_t size, size_t align);
+
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        // Free space left in the newest block
+        char* next_;
+        char* end_;
+        // Every shape made, oldest first
+        std::vector<Shape*> shapes_;
+};
+
+template <class T, class... Args>
+T* ShapeArena::make(Args&&... args) {
+
+    /* Make room first, so that a shape is never left undestroyed */
+    shapes_.push_back(nullptr);
+    try {
+        T* shape = new (allocate_(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        shapes_.back() = shape;
+        return shape;
+    }
+    catch (...) {
+        shapes_.pop_back();
+        throw;
+    }
+}
+
+#endif /* SHAPEARENA_H_ */
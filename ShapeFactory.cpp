@@ -0,0 +1,207 @@
+#include <algorithm>
+#include "ShapeFactory.h"
+
+namespace {
+
+// The checks of each constructor, in the order it makes them. Depths are
+// checked by the Point constructors the shape constructors are given.
+
+ShapeError checkPoint(int d) {
+    return (d < 0) ? ShapeError::NEGATIVE_DEPTH : ShapeError::NONE;
+}
+
+ShapeError checkLineSegment(float x1, float y1, float x2, float y2) {
+    if (y1 != y2 && x1 != x2) {
+        return ShapeError::NOT_ORTHOGONAL;
+    }
+    if (x1 == x2 && y1 == y2) {
+        return ShapeError::SAME_ENDPOINTS;
+    }
+    return ShapeError::NONE;
+}
+
+ShapeError checkRectangle(float x1, float y1, float x2, float y2) {
+    if (x1 == x2) {
+        return ShapeError::SAME_X;
+    }
+    if (y1 == y2) {
+        return ShapeError::SAME_Y;
+    }
+    return ShapeError::NONE;
+}
+
+ShapeError checkCircle(float r) {
+    return (r <= 0) ? ShapeError::NON_POSITIVE_RADIUS : ShapeError::NONE;
+}
+
+// The shapes made once the checks pass, with corners ordered as the
+// constructors order them
+
+ShapeValue segment(float x1, float y1, float x2, float y2, int d) {
+    return ShapeValue(SegmentValue { std::min(x1, x2), std::min(y1, y2),
+            std::max(x1, x2), std::max(y1, y2) }, d);
+}
+
+ShapeValue rectangle(float x1, float y1, float x2, float y2, int d) {
+    return ShapeValue(RectangleValue { std::min(x1, x2), std::min(y1, y2),
+            std::max(x1, x2), std::max(y1, y2) }, d);
+}
+
+}
+
+// ============== ShapeResult class ================
+
+ShapeResult::ShapeResult(const ShapeValue& v) : error_(ShapeError::NONE), value_(v) {
+}
+
+ShapeResult::ShapeResult(ShapeError e) : error_(e), value_(PointValue { 0, 0 }) {
+}
+
+bool ShapeResult::ok() const {
+    return error_ == ShapeError::NONE;
+}
+
+ShapeResult::operator bool() const {
+    return ok();
+}
+
+ShapeError ShapeResult::error() const {
+    return error_;
+}
+
+const ShapeValue& ShapeResult::value() const {
+    return value_;
+}
+
+// ============== Factories ================
+
+const char* shapeErrorMessage(ShapeError e) {
+    switch (e) {
+        case ShapeError::NEGATIVE_DEPTH:
+            return "Negative depth is not accepted.";
+        case ShapeError::DEPTH_MISMATCH:
+            return "Both depths are not same.";
+        case ShapeError::NOT_ORTHOGONAL:
+            return "Line is not orthogonal";
+        case ShapeError::SAME_ENDPOINTS:
+            return "Two endpoints are same.";
+        case ShapeError::SAME_X:
+            return "Two points of X-coord are same.";
+        case ShapeError::SAME_Y:
+            return "Two points of Y-coord are same.";
+        case ShapeError::NON_POSITIVE_RADIUS:
+            return "Circle of zero or negative radius.";
+        case ShapeError::UNORDERED_CORNERS:
+            return "Corners are out of order.";
+        default:
+            return "";
+    }
+}
+
+ShapeResult makePoint(float x, float y, int d) {
+    ShapeError e = checkPoint(d);
+    if (e != ShapeError::NONE) {
+        return e;
+    }
+    return ShapeValue(PointValue { x, y }, d);
+}
+
+ShapeResult makeLineSegment(float x1, float y1, float x2, float y2, int d) {
+    ShapeError e = checkPoint(d);
+    if (e == ShapeError::NONE) {
+        e = checkLineSegment(x1, y1, x2, y2);
+    }
+    if (e != ShapeError::NONE) {
+        return e;
+    }
+    return segment(x1, y1, x2, y2, d);
+}
+
+ShapeResult makeLineSegment(const Point& p, const Point& q) {
+    ShapeError e = checkLineSegment(p.getX(), p.getY(), q.getX(), q.getY());
+    if (e == ShapeError::NOT_ORTHOGONAL) {
+        return e;
+    }
+    if (p.getDepth() != q.getDepth()) {
+        return ShapeError::DEPTH_MISMATCH;
+    }
+    if (e != ShapeError::NONE) {
+        return e;
+    }
+    return segment(p.getX(), p.getY(), q.getX(), q.getY(), p.getDepth());
+}
+
+ShapeResult makeRectangle(float x1, float y1, float x2, float y2, int d) {
+    ShapeError e = checkPoint(d);
+    if (e == ShapeError::NONE) {
+        e = checkRectangle(x1, y1, x2, y2);
+    }
+    if (e != ShapeError::NONE) {
+        return e;
+    }
+    return rectangle(x1, y1, x2, y2, d);
+}
+
+ShapeResult makeRectangle(const Point& p, const Point& q) {
+    ShapeError e = checkRectangle(p.getX(), p.getY(), q.getX(), q.getY());
+    if (e == ShapeError::NONE && p.getDepth() != q.getDepth()) {
+        e = ShapeError::DEPTH_MISMATCH;
+    }
+    if (e != ShapeError::NONE) {
+        return e;
+    }
+    return rectangle(p.getX(), p.getY(), q.getX(), q.getY(), p.getDepth());
+}
+
+ShapeResult makeCircle(float x, float y, float r, int d) {
+    ShapeError e = checkPoint(d);
+    if (e == ShapeError::NONE) {
+        e = checkCircle(r);
+    }
+    if (e != ShapeError::NONE) {
+        return e;
+    }
+    return ShapeValue(CircleValue { x, y, r }, d);
+}
+
+ShapeResult makeCircle(const Point& c, float r) {
+    return makeCircle(c.getX(), c.getY(), r, c.getDepth());
+}
+
+size_t makeShapes(const ShapeArgs* args, size_t n, ShapeError* errors,
+        std::vector<ShapeValue>& out) {
+
+    size_t made = 0;
+    for (size_t i = 0; i < n; i++) {
+        const ShapeArgs& a = args[i];
+        ShapeError e = checkPoint(a.depth);
+        if (e == ShapeError::NONE) {
+            switch (a.kind) {
+                case ShapeValue::POINT:
+                    out.push_back(ShapeValue(PointValue { a.x0, a.y0 }, a.depth));
+                    break;
+                case ShapeValue::SEGMENT:
+                    e = checkLineSegment(a.x0, a.y0, a.x1, a.y1);
+                    if (e == ShapeError::NONE) {
+                        out.push_back(segment(a.x0, a.y0, a.x1, a.y1, a.depth));
+                    }
+                    break;
+                case ShapeValue::RECTANGLE:
+                    e = checkRectangle(a.x0, a.y0, a.x1, a.y1);
+                    if (e == ShapeError::NONE) {
+                        out.push_back(rectangle(a.x0, a.y0, a.x1, a.y1, a.depth));
+                    }
+                    break;
+                default:
+                    e = checkCircle(a.r);
+                    if (e == ShapeError::NONE) {
+                        out.push_back(ShapeValue(CircleValue { a.x0, a.y0, a.r }, a.depth));
+                    }
+                    break;
+            }
+        }
+        errors[i] = e;
+        made += (e == ShapeError::NONE);
+    }
+    return made;
+}
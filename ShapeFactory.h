@@ -0,0 +1,174 @@
+#ifndef SHAPEFACTORY_H_
+#define SHAPEFACTORY_H_
+
+#include <cstddef>
+#include <vector>
+#include "Geometry.h"
+
+/*
+ * Shape construction that reports bad arguments by return value instead
+ * of by exception. Every factory makes the same checks, in the same order,
+ * as the constructor of its shape class and gives the shape as a value,
+ * ready for Scene::add(). A failure is one of the codes below, each naming
+ * a condition a constructor throws std::invalid_argument for, but for
+ * UNORDERED_CORNERS, which only values written out by hand can have.
+ */
+
+// Why a shape could not be made
+enum class ShapeError : unsigned char {
+    NONE,
+    NEGATIVE_DEPTH,
+    DEPTH_MISMATCH,
+    NOT_ORTHOGONAL,
+    SAME_ENDPOINTS,
+    SAME_X,
+    SAME_Y,
+    NON_POSITIVE_RADIUS,
+    UNORDERED_CORNERS
+};
+
+// Return the message the constructors throw for e, or "" for NONE
+const char* shapeErrorMessage(ShapeError e);
+
+// Return the failure the factories would give for the arguments v was
+// made from, or UNORDERED_CORNERS if a segment or rectangle has its
+// minimum above its maximum, or NONE if v is a shape they could make.
+// Usable in constant expressions, to check a table of values written out
+// as a constant before it is added to a scene.
+constexpr ShapeError checkShape(const ShapeValue& v);
+
+// Return true if checkShape() finds nothing wrong with shapes[0..n)
+constexpr bool validShapes(const ShapeValue* shapes, size_t n);
+
+// Either a shape or the reason it could not be made
+class ShapeResult {
+
+    public:
+        // Constructor for a shape made
+        ShapeResult(const ShapeValue& v);
+
+        // Constructor for a failure. e must not be NONE.
+        ShapeResult(ShapeError e);
+
+        // Return true if a shape was made
+        bool ok() const;
+        explicit operator bool() const;
+
+        // Return the failure, or NONE if a shape was made
+        ShapeError error() const;
+
+        // Return the shape made. Only meaningful if ok().
+        const ShapeValue& value() const;
+
+    private:
+        ShapeError error_;
+        ShapeValue value_;
+};
+
+// As Point(x, y, d)
+ShapeResult makePoint(float x, float y, int d = 0);
+
+// As LineSegment(Point(x1, y1, d), Point(x2, y2, d))
+ShapeResult makeLineSegment(float x1, float y1, float x2, float y2, int d = 0);
+
+// As LineSegment(p, q)
+ShapeResult makeLineSegment(const Point& p, const Point& q);
+
+// As Rectangle(Point(x1, y1, d), Point(x2, y2, d))
+ShapeResult makeRectangle(float x1, float y1, float x2, float y2, int d = 0);
+
+// As Rectangle(p, q)
+ShapeResult makeRectangle(const Point& p, const Point& q);
+
+// As Circle(Point(x, y, d), r)
+ShapeResult makeCircle(float x, float y, float r, int d = 0);
+
+// As Circle(c, r)
+ShapeResult makeCircle(const Point& c, float r);
+
+// Arguments of one shape for makeShapes(): its kind and depth, and its
+// coordinates as SceneFile lays them out. Points use (x0, y0), segments
+// and rectangles (x0, y0) and (x1, y1), and circles (x0, y0) and r.
+struct ShapeArgs {
+    ShapeValue::Kind kind;
+    int depth;
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    float r;
+};
+
+// Check args[0..n) in one pass. Set errors[i] to the failure of args[i],
+// or NONE, and append the shapes made to out in input order. Return the
+// number of shapes made.
+size_t makeShapes(const ShapeArgs* args, size_t n, ShapeError* errors,
+        std::vector<ShapeValue>& out);
+
+namespace shapefactory {
+
+// Visitor giving the radius of a circle, or zero for other shapes
+struct Radius {
+    constexpr float operator()(const PointValue&) const {
+        return 0;
+    }
+    constexpr float operator()(const SegmentValue&) const {
+        return 0;
+    }
+    constexpr float operator()(const RectangleValue&) const {
+        return 0;
+    }
+    constexpr float operator()(const CircleValue& c) const {
+        return c.r;
+    }
+};
+
+}
+
+inline constexpr ShapeError checkShape(const ShapeValue& v) {
+    if (v.depth() < 0) {
+        return ShapeError::NEGATIVE_DEPTH;
+    }
+    BoundingBox b = v.bounds();
+    switch (v.kind()) {
+        case ShapeValue::SEGMENT:
+            if (b.xMin != b.xMax && b.yMin != b.yMax) {
+                return ShapeError::NOT_ORTHOGONAL;
+            }
+            if (b.xMin == b.xMax && b.yMin == b.yMax) {
+                return ShapeError::SAME_ENDPOINTS;
+            }
+            break;
+        case ShapeValue::RECTANGLE:
+            if (b.xMin == b.xMax) {
+                return ShapeError::SAME_X;
+            }
+            if (b.yMin == b.yMax) {
+                return ShapeError::SAME_Y;
+            }
+            break;
+        case ShapeValue::CIRCLE:
+            /* Read r itself: the bounds of a large centre lose small radii */
+            if (v.visit(shapefactory::Radius()) <= 0) {
+                return ShapeError::NON_POSITIVE_RADIUS;
+            }
+            break;
+        default:
+            break;
+    }
+    if (b.xMin > b.xMax || b.yMin > b.yMax) {
+        return ShapeError::UNORDERED_CORNERS;
+    }
+    return ShapeError::NONE;
+}
+
+inline constexpr bool validShapes(const ShapeValue* shapes, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (checkShape(shapes[i]) != ShapeError::NONE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif /* SHAPEFACTORY_H_ */
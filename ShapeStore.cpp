@@ -0,0 +1,138 @@
+#include <algorithm>
+#include "Kernels.h"
+#include "ShapeStore.h"
+
+namespace {
+
+void push(ShapeStore::BoxGroup& g, const BoundingBox& b, int id) {
+    g.xMin.push_back(b.xMin);
+    g.yMin.push_back(b.yMin);
+    g.xMax.push_back(b.xMax);
+    g.yMax.push_back(b.yMax);
+    g.id.push_back(id);
+}
+
+// Appends a shape to the group of its kind
+struct AddTo {
+    ShapeStore::BoxGroup& points;
+    ShapeStore::BoxGroup& segments;
+    ShapeStore::BoxGroup& rectangles;
+    ShapeStore::CircleGroup& circles;
+    int id;
+
+    void operator()(const PointValue& p) const {
+        push(points, BoundingBox { p.x, p.y, p.x, p.y }, id);
+    }
+    void operator()(const SegmentValue& l) const {
+        push(segments, BoundingBox { l.xMin, l.yMin, l.xMax, l.yMax }, id);
+    }
+    void operator()(const RectangleValue& r) const {
+        push(rectangles, BoundingBox { r.xMin, r.yMin, r.xMax, r.yMax }, id);
+    }
+    void operator()(const CircleValue& c) const {
+        circles.x.push_back(c.x);
+        circles.y.push_back(c.y);
+        circles.r.push_back(c.r);
+        circles.id.push_back(id);
+    }
+};
+
+void clearGroup(ShapeStore::BoxGroup& g) {
+    g.xMin.clear();
+    g.yMin.clear();
+    g.xMax.clear();
+    g.yMax.clear();
+    g.id.clear();
+}
+
+}
+
+// ============== ShapeStore class ================
+
+void ShapeStore::add(const Shape& s, int id) {
+    s.value().visit(AddTo { points_, segments_, rectangles_, circles_, id });
+    return;
+}
+
+void ShapeStore::clear() {
+    clearGroup(points_);
+    clearGroup(segments_);
+    clearGroup(rectangles_);
+    circles_.x.clear();
+    circles_.y.clear();
+    circles_.r.clear();
+    circles_.id.clear();
+    return;
+}
+
+size_t ShapeStore::size() const {
+    return points_.id.size() + segments_.id.size() +
+        rectangles_.id.size() + circles_.id.size();
+}
+
+const ShapeStore::BoxGroup& ShapeStore::points() const {
+    return points_;
+}
+
+const ShapeStore::BoxGroup& ShapeStore::segments() const {
+    return segments_;
+}
+
+const ShapeStore::BoxGroup& ShapeStore::rectangles() const {
+    return rectangles_;
+}
+
+const ShapeStore::CircleGroup& ShapeStore::circles() const {
+    return circles_;
+}
+
+void ShapeStore::containing_(const BoxGroup& g, float px, float py,
+        std::vector<int>& ids) const {
+
+    /* One 64-entry word at a time, so no scratch buffer is needed */
+    size_t n = g.id.size();
+    for (size_t first = 0; first < n; first += 64) {
+        uint64_t bits;
+        boxesContaining(&g.xMin[first], &g.yMin[first], &g.xMax[first],
+                &g.yMax[first], std::min<size_t>(64, n - first), px, py, &bits);
+        for (; bits != 0; bits &= bits - 1) {
+            ids.push_back(g.id[first + batch::lowestBit(bits)]);
+        }
+    }
+    return;
+}
+
+void ShapeStore::containing(float px, float py, std::vector<int>& ids) const {
+
+    containing_(points_, px, py, ids);
+    containing_(segments_, px, py, ids);
+    containing_(rectangles_, px, py, ids);
+
+    size_t n = circles_.id.size();
+    for (size_t first = 0; first < n; first += 64) {
+        uint64_t bits;
+        circlesContaining(&circles_.x[first], &circles_.y[first],
+                &circles_.r[first], std::min<size_t>(64, n - first), px, py, &bits);
+        for (; bits != 0; bits &= bits - 1) {
+            ids.push_back(circles_.id[first + batch::lowestBit(bits)]);
+        }
+    }
+    return;
+}
+
+void ShapeStore::boxesContaining(const float* xMin, const float* yMin,
+        const float* xMax, const float* yMax, size_t n,
+        float px, float py, uint64_t* mask) {
+    batch::boxesContaining(xMin, yMin, xMax, yMax, n, px, py, mask);
+    return;
+}
+
+void ShapeStore::circlesContaining(const float* x, const float* y,
+        const float* r, size_t n, float px, float py, uint64_t* mask) {
+    batch::circlesContaining(x, y, r, n, px, py, mask);
+    return;
+}
+
+const char* ShapeStore::kernelName() {
+    return batch::kernelName();
+}
@@ -0,0 +1,81 @@
+#ifndef SHAPESTORE_H_
+#define SHAPESTORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Geometry.h"
+
+/*
+ * Structure-of-arrays copy of a set of shapes, grouped by kind so that
+ * bulk hit-tests run over contiguous float arrays instead of chasing
+ * shared_ptrs and dispatching virtually for every object. The store is
+ * a snapshot: shapes changed after add() are not followed.
+ *
+ * Points, line segments and rectangles all reduce to the same test
+ * (inside the closed box xMin..xMax, yMin..yMax), so they share the box
+ * layout; circles keep their centre and radius.
+ */
+class ShapeStore {
+
+    public:
+        // Box-shaped entries: points, line segments and rectangles
+        struct BoxGroup {
+            std::vector<float> xMin;
+            std::vector<float> yMin;
+            std::vector<float> xMax;
+            std::vector<float> yMax;
+            // Caller supplied id of every entry
+            std::vector<int> id;
+        };
+
+        // Circles, by centre and radius
+        struct CircleGroup {
+            std::vector<float> x;
+            std::vector<float> y;
+            std::vector<float> r;
+            // Caller supplied id of every entry
+            std::vector<int> id;
+        };
+
+        // Copy s into the group of its kind under the given id
+        void add(const Shape& s, int id);
+
+        // Remove every entry, keeping the allocations
+        void clear();
+
+        // Return the total number of entries
+        size_t size() const;
+
+        const BoxGroup& points() const;
+        const BoxGroup& segments() const;
+        const BoxGroup& rectangles() const;
+        const CircleGroup& circles() const;
+
+        // Append to ids the id of every entry containing (px, py), with
+        // the same result as calling contains() on the original shapes
+        void containing(float px, float py, std::vector<int>& ids) const;
+
+        // Batch kernels. Set bit i of mask (bit i % 64 of word i / 64) when
+        // entry i contains (px, py) and clear it otherwise. mask must hold
+        // at least (n + 63) / 64 words. See Kernels.h.
+        static void boxesContaining(const float* xMin, const float* yMin,
+                const float* xMax, const float* yMax, size_t n,
+                float px, float py, uint64_t* mask);
+        static void circlesContaining(const float* x, const float* y,
+                const float* r, size_t n, float px, float py, uint64_t* mask);
+
+        // Return the name of the kernels in use: "avx2", "sse2" or "scalar"
+        static const char* kernelName();
+
+    private:
+        void containing_(const BoxGroup& g, float px, float py,
+                std::vector<int>& ids) const;
+
+        BoxGroup points_;
+        BoxGroup segments_;
+        BoxGroup rectangles_;
+        CircleGroup circles_;
+};
+
+#endif /* SHAPESTORE_H_ */
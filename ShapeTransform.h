@@ -0,0 +1,265 @@
+#ifndef SHAPETRANSFORM_H_
+#define SHAPETRANSFORM_H_
+
+#include <stdexcept>
+#include "ShapeValue.h"
+
+/*
+ * A chain of translate(), scale() and rotate() calls, kept as a single
+ * composed transform so that it can be applied to a shape later, once.
+ * Scaling and rotating are about the shape's own centre, so the centre
+ * only moves by the translations and the three kinds of call commute:
+ * any chain reduces to an offset, a factor, and whether an odd number of
+ * quarter turns was made (a half turn leaves every shape here as it was).
+ * Each call is therefore O(1) however long the chain.
+ *
+ * Applying the transform works in floats throughout. Unlike the shape
+ * classes, which truncate centres and half sizes to integers at every
+ * rotate() and scale(), nothing is rounded to an integer, so a long chain
+ * gives the shape its exact place.
+ */
+class ShapeTransform {
+
+    public:
+        // Constructor for the identity
+        ShapeTransform();
+
+        // Follow the chain with a translation by x horizontally and y
+        // vertically
+        void translate(float x, float y);
+
+        // Follow the chain with scaling by a factor f about the centre.
+        // If f is zero or negative, throw a std::invalid_argument exception.
+        void scale(float f);
+
+        // Follow the chain with a 90 degree rotation about the centre
+        void rotate();
+
+        // Follow the chain with the whole of next
+        void then(const ShapeTransform& next);
+
+        // Return true if the chain leaves every shape as it is
+        bool isIdentity() const;
+
+        // Return v moved by the whole chain
+        ShapeValue apply(const ShapeValue& v) const;
+
+        // Return the total translation and scale factor, and whether the
+        // chain turns shapes a quarter
+        float dx() const;
+        float dy() const;
+        float factor() const;
+        bool quarterTurn() const;
+
+    private:
+        float dx_;
+        float dy_;
+        float factor_;
+        bool quarterTurn_;
+};
+
+/*
+ * A shape held by value with a pending ShapeTransform. translate(),
+ * scale() and rotate() only extend the pending chain; the shape itself is
+ * worked out when it is first read through value(), bounds(), contains(),
+ * area() or draw(), and kept until the next change. The pending chain is
+ * always applied to the original shape, so reading it often costs no
+ * accuracy either.
+ */
+class LazyShape {
+
+    public:
+        // Default constructor is not meaningful without a shape
+        LazyShape() = delete;
+
+        // Constructor for v with nothing pending
+        explicit LazyShape(const ShapeValue& v);
+
+        // Extend the pending chain, as the ShapeTransform calls do
+        void translate(float x, float y);
+        void scale(float f);
+        void rotate();
+
+        // Return the transform still to be applied to the original shape
+        const ShapeTransform& pending() const;
+
+        // Return the shape with the pending chain applied
+        const ShapeValue& value() const;
+
+        // As the ShapeValue calls, on value()
+        BoundingBox bounds() const;
+        bool contains(float x, float y) const;
+        float area() const;
+        template <class Target>
+        void draw(Target& target) const;
+
+        // Make value() the original shape and clear the pending chain
+        void commit();
+
+    private:
+        ShapeValue original_;
+        ShapeTransform pending_;
+        // value(), valid when current_ is set
+        mutable ShapeValue value_;
+        mutable bool current_;
+};
+
+namespace shapevalue {
+
+// Visitor applying a ShapeTransform to the data of each kind
+struct Transform {
+    const ShapeTransform& t;
+
+    // Move the box with centre (cx, cy) and half sizes (hx, hy)
+    void box(float& xMin, float& yMin, float& xMax, float& yMax) const {
+        float cx = (xMin + xMax) / 2 + t.dx();
+        float cy = (yMin + yMax) / 2 + t.dy();
+        float hx = (xMax - xMin) / 2 * t.factor();
+        float hy = (yMax - yMin) / 2 * t.factor();
+        if (t.quarterTurn()) {
+            float swap = hx;
+            hx = hy;
+            hy = swap;
+        }
+        xMin = cx - hx;
+        xMax = cx + hx;
+        yMin = cy - hy;
+        yMax = cy + hy;
+    }
+    void operator()(PointValue& p) const {
+        p.x += t.dx();
+        p.y += t.dy();
+    }
+    void operator()(SegmentValue& s) const {
+        box(s.xMin, s.yMin, s.xMax, s.yMax);
+    }
+    void operator()(RectangleValue& r) const {
+        box(r.xMin, r.yMin, r.xMax, r.yMax);
+    }
+    void operator()(CircleValue& c) const {
+        c.x += t.dx();
+        c.y += t.dy();
+        c.r *= t.factor();
+    }
+};
+
+}
+
+// ============== ShapeTransform class ================
+
+inline ShapeTransform::ShapeTransform() : dx_(0), dy_(0), factor_(1), quarterTurn_(false) {
+}
+
+inline void ShapeTransform::translate(float x, float y) {
+    dx_ += x;
+    dy_ += y;
+    return;
+}
+
+inline void ShapeTransform::scale(float f) {
+    if (f <= 0) {
+        throw std::invalid_argument("zero or negative factor.");
+    }
+    factor_ *= f;
+    return;
+}
+
+inline void ShapeTransform::rotate() {
+    quarterTurn_ = !quarterTurn_;
+    return;
+}
+
+inline void ShapeTransform::then(const ShapeTransform& next) {
+    dx_ += next.dx_;
+    dy_ += next.dy_;
+    factor_ *= next.factor_;
+    quarterTurn_ = (quarterTurn_ != next.quarterTurn_);
+    return;
+}
+
+inline bool ShapeTransform::isIdentity() const {
+    return dx_ == 0 && dy_ == 0 && factor_ == 1 && !quarterTurn_;
+}
+
+inline ShapeValue ShapeTransform::apply(const ShapeValue& v) const {
+    ShapeValue result = v;
+    result.visit(shapevalue::Transform { *this });
+    return result;
+}
+
+inline float ShapeTransform::dx() const {
+    return dx_;
+}
+
+inline float ShapeTransform::dy() const {
+    return dy_;
+}
+
+inline float ShapeTransform::factor() const {
+    return factor_;
+}
+
+inline bool ShapeTransform::quarterTurn() const {
+    return quarterTurn_;
+}
+
+// ============== LazyShape class ================
+
+inline LazyShape::LazyShape(const ShapeValue& v) : original_(v), value_(v), current_(true) {
+}
+
+inline void LazyShape::translate(float x, float y) {
+    pending_.translate(x, y);
+    current_ = false;
+    return;
+}
+
+inline void LazyShape::scale(float f) {
+    pending_.scale(f);
+    current_ = false;
+    return;
+}
+
+inline void LazyShape::rotate() {
+    pending_.rotate();
+    current_ = false;
+    return;
+}
+
+inline const ShapeTransform& LazyShape::pending() const {
+    return pending_;
+}
+
+inline const ShapeValue& LazyShape::value() const {
+    if (!current_) {
+        value_ = pending_.apply(original_);
+        current_ = true;
+    }
+    return value_;
+}
+
+inline BoundingBox LazyShape::bounds() const {
+    return value().bounds();
+}
+
+inline bool LazyShape::contains(float x, float y) const {
+    return value().contains(x, y);
+}
+
+inline float LazyShape::area() const {
+    return value().area();
+}
+
+template <class Target>
+void LazyShape::draw(Target& target) const {
+    value().draw(target);
+    return;
+}
+
+inline void LazyShape::commit() {
+    original_ = value();
+    pending_ = ShapeTransform();
+    return;
+}
+
+#endif /* SHAPETRANSFORM_H_ */
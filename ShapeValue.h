@@ -0,0 +1,579 @@
+#ifndef SHAPEVALUE_H_
+#define SHAPEVALUE_H_
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include "BoundingBox.h"
+#include "Raster.h"
+#include "Scalar.h"
+
+// Plain data of each of the four shapes, in co-ordinates of type T
+
+// A point at (x, y)
+template <class T>
+struct BasicPointValue {
+    T x;
+    T y;
+};
+
+// An axis-aligned segment from (xMin, yMin) to (xMax, yMax). Either
+// xMin == xMax or yMin == yMax.
+template <class T>
+struct BasicSegmentValue {
+    T xMin;
+    T yMin;
+    T xMax;
+    T yMax;
+};
+
+// The rectangle with corners (xMin, yMin) and (xMax, yMax)
+template <class T>
+struct BasicRectangleValue {
+    T xMin;
+    T yMin;
+    T xMax;
+    T yMax;
+};
+
+// The circle of radius r around (x, y)
+template <class T>
+struct BasicCircleValue {
+    T x;
+    T y;
+    T r;
+};
+
+/*
+ * One of the four shapes held by value: a tag, a depth and a union of
+ * the plain data above, 24 bytes in all for float. The set of shapes is
+ * closed, so the algorithms below switch on the tag instead of calling
+ * virtual functions, and are defined here so that loops over contiguous
+ * arrays of values can be inlined. Values are not checked the way the
+ * shape classes check their constructor arguments; convert with
+ * Shape::value().
+ *
+ * T is the co-ordinate type: float, as the shape classes and Scene use
+ * (ShapeValue below), double for large co-ordinates, or Fixed16 for
+ * shapes on a grid, whose tests and drawing use integers only. Every T
+ * gives the same answers wherever its values are exact, rotate() and
+ * scale() included: those truncate centres and half sizes to whole
+ * numbers, as the shape classes do, in T rather than through int.
+ */
+template <class T>
+class BasicShapeValue {
+
+    public:
+        // Which member of the union is in use
+        enum Kind : unsigned char { POINT, SEGMENT, RECTANGLE, CIRCLE };
+
+        // Constructors, one for each kind, at depth d
+        constexpr BasicShapeValue(const BasicPointValue<T>& p, int d = 0);
+        constexpr BasicShapeValue(const BasicSegmentValue<T>& s, int d = 0);
+        constexpr BasicShapeValue(const BasicRectangleValue<T>& r, int d = 0);
+        constexpr BasicShapeValue(const BasicCircleValue<T>& c, int d = 0);
+
+        // Return the kind of shape held
+        constexpr Kind kind() const;
+
+        // Return the depth of the shape
+        constexpr int depth() const;
+
+        // Set the depth of the shape to d. If d is negative, return false and
+        // do not update depth. Otherwise return true
+        constexpr bool setDepth(int d);
+
+        // Call v with the data of the shape held, as BasicPointValue,
+        // BasicSegmentValue, BasicRectangleValue or BasicCircleValue, and
+        // return its result. Every overload of v must return the same type.
+        template <class Visitor>
+        constexpr auto visit(Visitor&& v) const
+            -> decltype(v(std::declval<const BasicPointValue<T>&>()));
+
+        // As above, but v may change the data
+        template <class Visitor>
+        constexpr auto visit(Visitor&& v) -> decltype(v(std::declval<BasicPointValue<T>&>()));
+
+        // Return the axis-aligned bounds of the shape
+        constexpr BasicBoundingBox<T> bounds() const;
+
+        // Return true if the shape contains (x, y), with the same answers
+        // as the contains() of the matching shape class
+        constexpr bool contains(T x, T y) const;
+
+        // Return true if the shape and other share a point, taking every
+        // shape as the set of points its contains() accepts: points, line
+        // segments and rectangles are closed, circles open
+        constexpr bool intersects(const BasicShapeValue& other) const;
+
+        // Return the distance from (x, y) to the nearest point of the shape,
+        // or zero if the shape contains it. Rectangles and circles are
+        // filled, so the distance is to their area rather than their edges.
+        T distance(T x, T y) const;
+
+        // Return the area of the shape
+        constexpr T area() const;
+
+        // Return the length of a line segment, or zero for other shapes
+        constexpr T length() const;
+
+        // Translate the shape horizontally by x and vertically by y
+        constexpr void translate(T x, T y);
+
+        // Rotate the shape 90 degrees around its centre, as the matching
+        // shape class does
+        constexpr void rotate();
+
+        // Scale the shape by a factor f relative to its centre, as the
+        // matching shape class does.
+        // If f is zero or negative, throw a std::invalid_argument exception.
+        constexpr void scale(T f);
+
+        // Mark the cells of target covered by the shape. Target is
+        // FrameBuffer, DepthBuffer, BitCanvas or StaticPage; all are drawn
+        // by the same code, at compile time for StaticPage.
+        template <class Target>
+        constexpr void draw(Target& target) const;
+
+    private:
+        Kind kind_;
+        int depth_;
+        union {
+            BasicPointValue<T> point_;
+            BasicSegmentValue<T> segment_;
+            BasicRectangleValue<T> rectangle_;
+            BasicCircleValue<T> circle_;
+        };
+};
+
+// The values the shape classes and Scene work in
+using PointValue = BasicPointValue<float>;
+using SegmentValue = BasicSegmentValue<float>;
+using RectangleValue = BasicRectangleValue<float>;
+using CircleValue = BasicCircleValue<float>;
+using ShapeValue = BasicShapeValue<float>;
+
+template <class T>
+inline constexpr BasicShapeValue<T>::BasicShapeValue(const BasicPointValue<T>& p, int d) :
+    kind_(POINT), depth_(d), point_(p) {
+}
+
+template <class T>
+inline constexpr BasicShapeValue<T>::BasicShapeValue(const BasicSegmentValue<T>& s, int d) :
+    kind_(SEGMENT), depth_(d), segment_(s) {
+}
+
+template <class T>
+inline constexpr BasicShapeValue<T>::BasicShapeValue(const BasicRectangleValue<T>& r, int d) :
+    kind_(RECTANGLE), depth_(d), rectangle_(r) {
+}
+
+template <class T>
+inline constexpr BasicShapeValue<T>::BasicShapeValue(const BasicCircleValue<T>& c, int d) :
+    kind_(CIRCLE), depth_(d), circle_(c) {
+}
+
+template <class T>
+inline constexpr typename BasicShapeValue<T>::Kind BasicShapeValue<T>::kind() const {
+    return kind_;
+}
+
+template <class T>
+inline constexpr int BasicShapeValue<T>::depth() const {
+    return depth_;
+}
+
+template <class T>
+inline constexpr bool BasicShapeValue<T>::setDepth(int d) {
+    if (d < 0) {
+        return false;
+    }
+    depth_ = d;
+    return true;
+}
+
+template <class T>
+template <class Visitor>
+constexpr auto BasicShapeValue<T>::visit(Visitor&& v) const
+    -> decltype(v(std::declval<const BasicPointValue<T>&>())) {
+    switch (kind_) {
+        case POINT:
+            return v(point_);
+        case SEGMENT:
+            return v(segment_);
+        case RECTANGLE:
+            return v(rectangle_);
+        default:
+            return v(circle_);
+    }
+}
+
+template <class T>
+template <class Visitor>
+constexpr auto BasicShapeValue<T>::visit(Visitor&& v) -> decltype(v(std::declval<BasicPointValue<T>&>())) {
+    switch (kind_) {
+        case POINT:
+            return v(point_);
+        case SEGMENT:
+            return v(segment_);
+        case RECTANGLE:
+            return v(rectangle_);
+        default:
+            return v(circle_);
+    }
+}
+
+namespace shapevalue {
+
+// Visitors behind the ShapeValue algorithms, one overload per kind
+
+template <class T>
+struct Bounds {
+    constexpr BasicBoundingBox<T> operator()(const BasicPointValue<T>& p) const {
+        return BasicBoundingBox<T> { p.x, p.y, p.x, p.y };
+    }
+    constexpr BasicBoundingBox<T> operator()(const BasicSegmentValue<T>& s) const {
+        return BasicBoundingBox<T> { s.xMin, s.yMin, s.xMax, s.yMax };
+    }
+    constexpr BasicBoundingBox<T> operator()(const BasicRectangleValue<T>& r) const {
+        return BasicBoundingBox<T> { r.xMin, r.yMin, r.xMax, r.yMax };
+    }
+    constexpr BasicBoundingBox<T> operator()(const BasicCircleValue<T>& c) const {
+        return BasicBoundingBox<T> { c.x - c.r, c.y - c.r, c.x + c.r, c.y + c.r };
+    }
+};
+
+template <class T>
+struct Contains {
+    T x;
+    T y;
+    constexpr bool operator()(const BasicPointValue<T>& p) const {
+        return p.x == x && p.y == y;
+    }
+    constexpr bool operator()(const BasicSegmentValue<T>& s) const {
+        /* Degenerate in one direction, so the box test is the line test */
+        return s.xMin <= x && s.xMax >= x && s.yMin <= y && s.yMax >= y;
+    }
+    constexpr bool operator()(const BasicRectangleValue<T>& r) const {
+        return r.xMin <= x && r.xMax >= x && r.yMin <= y && r.yMax >= y;
+    }
+    constexpr bool operator()(const BasicCircleValue<T>& c) const {
+        return scalar::square(c.x - x) + scalar::square(c.y - y) < scalar::square(c.r);
+    }
+};
+
+// Return true if the closed box b and the open disk c share a point: the
+// point of b nearest the centre is tested as Contains tests points
+template <class T>
+inline constexpr bool boxMeetsDisk(const BasicBoundingBox<T>& b, const BasicCircleValue<T>& c) {
+    T x = (c.x < b.xMin) ? b.xMin : (c.x > b.xMax) ? b.xMax : c.x;
+    T y = (c.y < b.yMin) ? b.yMin : (c.y > b.yMax) ? b.yMax : c.y;
+    return scalar::square(c.x - x) + scalar::square(c.y - y) < scalar::square(c.r);
+}
+
+template <class T>
+struct Distance {
+    T x;
+    T y;
+    T operator()(const BasicPointValue<T>& p) const {
+        return scalar::root(scalar::square(p.x - x) + scalar::square(p.y - y));
+    }
+    T operator()(const BasicSegmentValue<T>& s) const {
+        /* Degenerate in one direction, so the box distance is the line's */
+        return BasicBoundingBox<T> { s.xMin, s.yMin, s.xMax, s.yMax }.distance(x, y);
+    }
+    T operator()(const BasicRectangleValue<T>& r) const {
+        return BasicBoundingBox<T> { r.xMin, r.yMin, r.xMax, r.yMax }.distance(x, y);
+    }
+    T operator()(const BasicCircleValue<T>& c) const {
+        T beyond = scalar::root(scalar::square(c.x - x) + scalar::square(c.y - y)) - c.r;
+        return (beyond > T(0)) ? beyond : T(0);
+    }
+};
+
+template <class T>
+struct Area {
+    constexpr T operator()(const BasicPointValue<T>&) const {
+        return T(0);
+    }
+    constexpr T operator()(const BasicSegmentValue<T>&) const {
+        return T(0);
+    }
+    constexpr T operator()(const BasicRectangleValue<T>& r) const {
+        return (r.xMax - r.xMin) * (r.yMax - r.yMin);
+    }
+    constexpr T operator()(const BasicCircleValue<T>& c) const {
+        return scalar::discArea(c.r);
+    }
+};
+
+template <class T>
+struct Translate {
+    T x;
+    T y;
+    constexpr void operator()(BasicPointValue<T>& p) const {
+        p.x += x;
+        p.y += y;
+    }
+    constexpr void operator()(BasicSegmentValue<T>& s) const {
+        s.xMin += x;
+        s.xMax += x;
+        s.yMin += y;
+        s.yMax += y;
+    }
+    constexpr void operator()(BasicRectangleValue<T>& r) const {
+        r.xMin += x;
+        r.xMax += x;
+        r.yMin += y;
+        r.yMax += y;
+    }
+    constexpr void operator()(BasicCircleValue<T>& c) const {
+        c.x += x;
+        c.y += y;
+    }
+};
+
+template <class T>
+struct Rotate {
+    constexpr void operator()(BasicPointValue<T>&) const {
+    }
+    constexpr void operator()(BasicSegmentValue<T>& s) const {
+        T half = (s.xMax - s.xMin + s.yMax - s.yMin) / T(2);
+        if (s.yMin == s.yMax) {
+            s.xMin += half;
+            s.xMax = s.xMin;
+            s.yMax += half;
+            s.yMin -= half;
+        } else {
+            s.yMin += half;
+            s.yMax = s.yMin;
+            s.xMax += half;
+            s.xMin -= half;
+        }
+    }
+    constexpr void operator()(BasicRectangleValue<T>& r) const {
+        /* Centre and half sizes are truncated, as Rectangle::rotate does */
+        T xDiff = scalar::truncate((r.xMax - r.xMin) / T(2));
+        T xCenter = scalar::truncate(r.xMin + xDiff);
+        T yDiff = scalar::truncate((r.yMax - r.yMin) / T(2));
+        T yCenter = scalar::truncate(r.yMin + yDiff);
+        r.xMin = xCenter - yDiff;
+        r.xMax = xCenter + yDiff;
+        r.yMax = yCenter + xDiff;
+        r.yMin = yCenter - xDiff;
+    }
+    constexpr void operator()(BasicCircleValue<T>&) const {
+    }
+};
+
+template <class T>
+struct Scale {
+    T f;
+    constexpr void operator()(BasicPointValue<T>&) const {
+    }
+    constexpr void operator()(BasicSegmentValue<T>& s) const {
+        /* The middle is truncated, as LineSegment::scale does */
+        if (s.yMin == s.yMax) {
+            T half = (s.xMax - s.xMin) / T(2);
+            T middle = scalar::truncate(s.xMin + half);
+            s.xMin = middle - half * f;
+            s.xMax = middle + half * f;
+        } else {
+            T half = (s.yMax - s.yMin) / T(2);
+            T middle = scalar::truncate(s.yMin + half);
+            s.yMin = middle - half * f;
+            s.yMax = middle + half * f;
+        }
+    }
+    constexpr void operator()(BasicRectangleValue<T>& r) const {
+        T xDiff = scalar::truncate((r.xMax - r.xMin) / T(2));
+        T xCenter = scalar::truncate(r.xMin + xDiff);
+        T yDiff = scalar::truncate((r.yMax - r.yMin) / T(2));
+        T yCenter = scalar::truncate(r.yMin + yDiff);
+        r.xMin = xCenter - (xDiff * f);
+        r.xMax = xCenter + (xDiff * f);
+        r.yMin = yCenter - (yDiff * f);
+        r.yMax = yCenter + (yDiff * f);
+    }
+    constexpr void operator()(BasicCircleValue<T>& c) const {
+        c.r *= f;
+    }
+};
+
+// Scanline rasterizers, one per kind, writing whole spans through
+// fillSpan() wherever they can. Cells are whole scene co-ordinates; a
+// shape covers the cells from the ceiling of its low edge to the floor of
+// its high edge. Everything here is constexpr, so a Target with constexpr
+// plot(), fillSpan() and clip() is drawn at compile time.
+template <class T, class Target>
+struct Draw {
+    Target& fb;
+
+    constexpr void operator()(const BasicPointValue<T>& p) const {
+        int x = scalar::floorInt(p.x), y = scalar::floorInt(p.y);
+        if (p.x == T(x) && p.y == T(y)) {
+            fb.plot(x, y);
+        }
+    }
+
+    constexpr void operator()(const BasicSegmentValue<T>& s) const {
+        if (s.yMin == s.yMax) {
+            /* Horizontal Line */
+            int y = scalar::floorInt(s.yMin);
+            if (s.yMin == T(y)) {
+                fb.fillSpan(y, scalar::ceilInt(s.xMin), scalar::floorInt(s.xMax));
+            }
+        } else if (s.xMin == s.xMax && s.xMin == T(scalar::floorInt(s.xMin))) {
+            /* Vertical Line, one cell per row */
+            int x = scalar::floorInt(s.xMin);
+            int yLow = std::max(scalar::ceilInt(s.yMin), fb.clip().y0);
+            int yHigh = std::min(scalar::floorInt(s.yMax), fb.clip().y1);
+            for (int y = yLow; y <= yHigh; y++) {
+                fb.plot(x, y);
+            }
+        }
+    }
+
+    constexpr void operator()(const BasicRectangleValue<T>& r) const {
+        int yLow = std::max(scalar::ceilInt(r.yMin), fb.clip().y0);
+        int yHigh = std::min(scalar::floorInt(r.yMax), fb.clip().y1);
+        for (int y = yLow; y <= yHigh; y++) {
+            fb.fillSpan(y, scalar::ceilInt(r.xMin), scalar::floorInt(r.xMax));
+        }
+    }
+
+    // Return true if the cell (x, y) is drawn for circle c, yDiff being
+    // the square of the row's distance from the centre
+    static constexpr bool inCircle(const BasicCircleValue<T>& c, scalar::Wide<T> yDiff, int x) {
+        return scalar::square(T(x) - c.x) + yDiff <= scalar::square(c.r);
+    }
+
+    constexpr void operator()(const BasicCircleValue<T>& c) const {
+        /*
+         * Unlike contains(), cells exactly on the circumference are drawn,
+         * which is what gives the circle its pointed top and bottom rows.
+         * Each row is one span, settled on the same test every cell used
+         * to be drawn by. The drawn cells of a row are symmetric about the
+         * centre, so every row that has any holds the cell m nearest it:
+         * starting each row from the span of the one before, or from m,
+         * the ends only move by the change between rows, with no root.
+         * The walk is kept to the clip and a cell either side: a span is
+         * one run, so where it reaches the clip it holds the cell m is
+         * clamped to, and a circle far larger than the page costs only
+         * the cells of the page.
+         */
+        int yLow = std::max(scalar::ceilInt(c.y - c.r), fb.clip().y0);
+        int yHigh = std::min(scalar::floorInt(c.y + c.r), fb.clip().y1);
+        int xLow = std::max(scalar::ceilInt(c.x - c.r), fb.clip().x0 - 1);
+        int xHigh = std::min(scalar::floorInt(c.x + c.r), fb.clip().x1 + 1);
+        if (xLow > xHigh) {
+            return;
+        }
+        int m = std::min(std::max(scalar::floorInt(c.x + T(1) / T(2)), xLow), xHigh);
+
+        int x0 = m, x1 = m;
+        for (int y = yLow; y <= yHigh; y++) {
+            scalar::Wide<T> yDiff = scalar::square(T(y) - c.y);
+            if (x0 > x1) {
+                x0 = m;
+                x1 = m;
+            }
+            while (x0 > xLow && inCircle(c, yDiff, x0 - 1)) {
+                x0--;
+            }
+            while (x0 <= x1 && !inCircle(c, yDiff, x0)) {
+                x0++;
+            }
+            while (x1 < xHigh && inCircle(c, yDiff, x1 + 1)) {
+                x1++;
+            }
+            while (x1 >= x0 && !inCircle(c, yDiff, x1)) {
+                x1--;
+            }
+            if (x0 <= x1) {
+                fb.fillSpan(y, x0, x1);
+            }
+        }
+    }
+};
+
+}
+
+template <class T>
+inline constexpr BasicBoundingBox<T> BasicShapeValue<T>::bounds() const {
+    return visit(shapevalue::Bounds<T>());
+}
+
+template <class T>
+inline constexpr bool BasicShapeValue<T>::contains(T x, T y) const {
+    return visit(shapevalue::Contains<T> { x, y });
+}
+
+template <class T>
+inline constexpr bool BasicShapeValue<T>::intersects(const BasicShapeValue& other) const {
+    if (kind_ == POINT) {
+        return other.contains(point_.x, point_.y);
+    }
+    if (other.kind_ == POINT) {
+        return contains(other.point_.x, other.point_.y);
+    }
+    if (kind_ == CIRCLE && other.kind_ == CIRCLE) {
+        T reach = circle_.r + other.circle_.r;
+        return scalar::square(circle_.x - other.circle_.x) +
+            scalar::square(circle_.y - other.circle_.y) < scalar::square(reach);
+    }
+    if (kind_ == CIRCLE) {
+        return shapevalue::boxMeetsDisk(other.bounds(), circle_);
+    }
+    if (other.kind_ == CIRCLE) {
+        return shapevalue::boxMeetsDisk(bounds(), other.circle_);
+    }
+    /* Segments and rectangles are both exactly their bounds */
+    return bounds().intersects(other.bounds());
+}
+
+template <class T>
+inline T BasicShapeValue<T>::distance(T x, T y) const {
+    return visit(shapevalue::Distance<T> { x, y });
+}
+
+template <class T>
+inline constexpr T BasicShapeValue<T>::area() const {
+    return visit(shapevalue::Area<T>());
+}
+
+template <class T>
+inline constexpr T BasicShapeValue<T>::length() const {
+    /* Axis-aligned, so the length is the one side that is not zero */
+    return (kind_ == SEGMENT) ? (segment_.xMax - segment_.xMin) + (segment_.yMax - segment_.yMin) : T(0);
+}
+
+template <class T>
+inline constexpr void BasicShapeValue<T>::translate(T x, T y) {
+    visit(shapevalue::Translate<T> { x, y });
+    return;
+}
+
+template <class T>
+inline constexpr void BasicShapeValue<T>::rotate() {
+    visit(shapevalue::Rotate<T>());
+    return;
+}
+
+template <class T>
+inline constexpr void BasicShapeValue<T>::scale(T f) {
+    if (f <= T(0)) {
+        throw std::invalid_argument("zero or negative factor.");
+    }
+    visit(shapevalue::Scale<T> { f });
+    return;
+}
+
+template <class T>
+template <class Target>
+inline constexpr void BasicShapeValue<T>::draw(Target& target) const {
+    visit(shapevalue::Draw<T, Target> { target });
+    return;
+}
+
+#endif /* SHAPEVALUE_H_ */
@@ -0,0 +1,444 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "SpatialIndex.h"
+
+using namespace std;
+
+namespace {
+
+// Cell co-ordinates are clamped so that far away or non-finite bounds
+// still map to a valid cell
+const float cellLimit = 1 << 30;
+
+long long cellKey(int cx, int cy) {
+    /* Shift unsigned: shifting a negative value left is undefined */
+    unsigned long long high = static_cast<unsigned int>(cx);
+    return static_cast<long long>((high << 32) | static_cast<unsigned int>(cy));
+}
+
+}
+
+// ============== UniformGrid class ================
+
+constexpr int UniformGrid::maxCellsPerEntry;
+
+UniformGrid::UniformGrid(float cellSize) : cellSize_(cellSize) {
+    if (cellSize <= 0) {
+        throw invalid_argument("zero or negative cell size.");
+    }
+}
+
+UniformGrid::CellRange UniformGrid::range_(const BoundingBox& b) const {
+
+    float c[4] = { b.xMin, b.yMin, b.xMax, b.yMax };
+    int cell[4];
+    for (int index = 0; index < 4; index++) {
+        float v = floor(c[index] / cellSize_);
+        if (!(v > -cellLimit)) {
+            /* Also catches NaN */
+            v = -cellLimit;
+        } else if (v > cellLimit) {
+            v = cellLimit;
+        }
+        cell[index] = static_cast<int>(v);
+    }
+    return CellRange { cell[0], cell[1], cell[2], cell[3] };
+}
+
+bool UniformGrid::isLarge_(const CellRange& r) const {
+    long long cols = static_cast<long long>(r.cx1) - r.cx0 + 1;
+    long long rows = static_cast<long long>(r.cy1) - r.cy0 + 1;
+    return cols * rows > maxCellsPerEntry;
+}
+
+void UniformGrid::link_(int id) {
+
+    CellRange r = range_(bounds_[id]);
+    if (isLarge_(r)) {
+        large_.push_back(id);
+        return;
+    }
+    for (int cy = r.cy0; cy <= r.cy1; cy++) {
+        for (int cx = r.cx0; cx <= r.cx1; cx++) {
+            cells_[cellKey(cx, cy)].push_back(id);
+        }
+    }
+    return;
+}
+
+void UniformGrid::unlink_(int id) {
+
+    CellRange r = range_(bounds_[id]);
+    if (isLarge_(r)) {
+        auto pos = find(large_.begin(), large_.end(), id);
+        if (pos != large_.end()) {
+            *pos = large_.back();
+            large_.pop_back();
+        }
+        return;
+    }
+    for (int cy = r.cy0; cy <= r.cy1; cy++) {
+        for (int cx = r.cx0; cx <= r.cx1; cx++) {
+            auto cell = cells_.find(cellKey(cx, cy));
+            if (cell == cells_.end()) {
+                continue;
+            }
+            vector<int>& ids = cell->second;
+            auto pos = find(ids.begin(), ids.end(), id);
+            if (pos != ids.end()) {
+                *pos = ids.back();
+                ids.pop_back();
+            }
+            if (ids.empty()) {
+                cells_.erase(cell);
+            }
+        }
+    }
+    return;
+}
+
+void UniformGrid::insert(int id, const BoundingBox& b) {
+
+    if (id >= static_cast<int>(bounds_.size())) {
+        bounds_.resize(id + 1);
+        present_.resize(id + 1, false);
+    }
+    if (present_[id]) {
+        unlink_(id);
+    }
+    bounds_[id] = b;
+    present_[id] = true;
+    link_(id);
+    return;
+}
+
+void UniformGrid::update(int id, const BoundingBox& b) {
+
+    if (id >= static_cast<int>(bounds_.size()) || !present_[id]) {
+        insert(id, b);
+        return;
+    }
+    CellRange before = range_(bounds_[id]);
+    CellRange after = range_(b);
+    if (before.cx0 == after.cx0 && before.cy0 == after.cy0 &&
+            before.cx1 == after.cx1 && before.cy1 == after.cy1) {
+        /* Same cells, only the stored bounds move */
+        bounds_[id] = b;
+        return;
+    }
+    unlink_(id);
+    bounds_[id] = b;
+    link_(id);
+    return;
+}
+
+void UniformGrid::update(const int* ids, const BoundingBox* boxes, size_t n) {
+
+    if (n < bounds_.size() / 4) {
+        for (size_t i = 0; i < n; i++) {
+            update(ids[i], boxes[i]);
+        }
+        return;
+    }
+    /*
+     * Moving an entry costs a lookup and often an allocation per cell it
+     * leaves or enters, so a large batch rebuilds every cell in a single
+     * pass instead, keeping the cells' allocations and then dropping the
+     * cells left empty.
+     */
+    for (size_t i = 0; i < n; i++) {
+        int id = ids[i];
+        if (id >= static_cast<int>(bounds_.size())) {
+            bounds_.resize(id + 1);
+            present_.resize(id + 1, false);
+        }
+        bounds_[id] = boxes[i];
+        present_[id] = true;
+    }
+    for (auto& cell : cells_) {
+        cell.second.clear();
+    }
+    relinkAll_();
+    for (auto cell = cells_.begin(); cell != cells_.end();) {
+        cell = cell->second.empty() ? cells_.erase(cell) : next(cell);
+    }
+    return;
+}
+
+void UniformGrid::remove(int id) {
+
+    if (id < 0 || id >= static_cast<int>(bounds_.size()) || !present_[id]) {
+        return;
+    }
+    unlink_(id);
+    present_[id] = false;
+    return;
+}
+
+const vector<int>* UniformGrid::cell_(float x, float y) const {
+
+    CellRange r = range_(BoundingBox { x, y, x, y });
+    auto cell = cells_.find(cellKey(r.cx0, r.cy0));
+    if (cell == cells_.end()) {
+        return nullptr;
+    }
+    return &cell->second;
+}
+
+void UniformGrid::query(float x, float y, vector<int>& hits) const {
+    visit(x, y, [&hits](int id) { hits.push_back(id); });
+    return;
+}
+
+void UniformGrid::query(const BoundingBox& box, vector<int>& hits) const {
+
+    size_t first = hits.size();
+    CellRange r = range_(box);
+    long long cols = static_cast<long long>(r.cx1) - r.cx0 + 1;
+    long long rows = static_cast<long long>(r.cy1) - r.cy0 + 1;
+
+    if (cols * rows > static_cast<long long>(cells_.size())) {
+        /* Cheaper to walk the occupied cells than the covered ones */
+        for (const auto& cell : cells_) {
+            for (int id : cell.second) {
+                if (bounds_[id].intersects(box)) {
+                    hits.push_back(id);
+                }
+            }
+        }
+    } else {
+        for (int cy = r.cy0; cy <= r.cy1; cy++) {
+            for (int cx = r.cx0; cx <= r.cx1; cx++) {
+                auto cell = cells_.find(cellKey(cx, cy));
+                if (cell == cells_.end()) {
+                    continue;
+                }
+                for (int id : cell->second) {
+                    if (bounds_[id].intersects(box)) {
+                        hits.push_back(id);
+                    }
+                }
+            }
+        }
+    }
+    /* An entry spanning several cells is met once per cell */
+    sort(hits.begin() + first, hits.end());
+    hits.erase(unique(hits.begin() + first, hits.end()), hits.end());
+
+    for (int id : large_) {
+        if (bounds_[id].intersects(box)) {
+            hits.push_back(id);
+        }
+    }
+    return;
+}
+
+const BoundingBox& UniformGrid::bounds(int id) const {
+    return bounds_[id];
+}
+
+float UniformGrid::cellSize() const {
+    return cellSize_;
+}
+
+void UniformGrid::setCellSize(float f) {
+
+    if (f <= 0) {
+        throw invalid_argument("zero or negative cell size.");
+    }
+    cells_.clear();
+    cellSize_ = f;
+    relinkAll_();
+    return;
+}
+
+void UniformGrid::relinkAll_() {
+
+    large_.clear();
+    for (int id = 0; id < static_cast<int>(bounds_.size()); id++) {
+        if (present_[id]) {
+            link_(id);
+        }
+    }
+    return;
+}
+
+// ============== SweepAndPrune class ================
+
+SweepAndPrune::SweepAndPrune() : moved_(0) {
+}
+
+void SweepAndPrune::insert(int id, const BoundingBox& b) {
+
+    if (id >= static_cast<int>(pos_.size())) {
+        pos_.resize(id + 1, -1);
+    }
+    Entry e { b.xMin, b.xMax, b.yMin, b.yMax, id };
+    if (pos_[id] < 0) {
+        pos_[id] = entries_.size();
+        entries_.push_back(e);
+    } else {
+        entries_[pos_[id]] = e;
+    }
+    moved_++;
+    return;
+}
+
+void SweepAndPrune::update(int id, const BoundingBox& b) {
+    insert(id, b);
+    return;
+}
+
+void SweepAndPrune::remove(int id) {
+
+    if (id < 0 || id >= static_cast<int>(pos_.size()) || pos_[id] < 0) {
+        return;
+    }
+    /* The last entry fills the hole, so the order has to be repaired */
+    int at = pos_[id];
+    entries_[at] = entries_.back();
+    pos_[entries_[at].id] = at;
+    entries_.pop_back();
+    pos_[id] = -1;
+    moved_++;
+    return;
+}
+
+void SweepAndPrune::sort_() {
+
+    if (moved_ == 0) {
+        return;
+    }
+    auto byLeft = [](const Entry& a, const Entry& b) { return a.xMin < b.xMin; };
+    if (moved_ * 8 > entries_.size()) {
+        sort(entries_.begin(), entries_.end(), byLeft);
+    } else {
+        /*
+         * Nearly sorted: each moved entry only travels a short way. A few
+         * entries jumping far would make this quadratic, so once the
+         * shifts pass a budget linear in the size, what is left of the
+         * order is repaired by a full sort instead.
+         */
+        size_t budget = 4 * entries_.size();
+        for (size_t i = 1; i < entries_.size() && budget > 0; i++) {
+            Entry e = entries_[i];
+            size_t j = i;
+            for (; j > 0 && budget > 0 && byLeft(e, entries_[j - 1]); j--) {
+                entries_[j] = entries_[j - 1];
+                budget--;
+            }
+            entries_[j] = e;
+        }
+        if (budget == 0) {
+            sort(entries_.begin(), entries_.end(), byLeft);
+        }
+    }
+    for (size_t i = 0; i < entries_.size(); i++) {
+        pos_[entries_[i].id] = i;
+    }
+    moved_ = 0;
+    return;
+}
+
+void SweepAndPrune::pairs(vector<pair<int, int>>& hits) {
+
+    sort_();
+    size_t n = entries_.size();
+    for (size_t i = 0; i < n; i++) {
+        const Entry& a = entries_[i];
+        /* Entries further on start later, so the first one that starts
+         * past the end of a ends the run of overlaps in x */
+        for (size_t j = i + 1; j < n && entries_[j].xMin <= a.xMax; j++) {
+            const Entry& b = entries_[j];
+            if (a.yMin <= b.yMax && b.yMin <= a.yMax) {
+                hits.push_back(a.id < b.id ? make_pair(a.id, b.id) : make_pair(b.id, a.id));
+            }
+        }
+    }
+    return;
+}
+
+size_t SweepAndPrune::size() const {
+    return entries_.size();
+}
+
+// ============== PackedRTree class ================
+
+constexpr int PackedRTree::fanout;
+
+PackedRTree::PackedRTree() {
+}
+
+void PackedRTree::build(const BoundingBox* boxes, size_t n) {
+
+    order_.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        order_[i] = i;
+    }
+    /* Sort by x into slices of whole leaves, then each slice by y */
+    auto centreX = [boxes](int id) { return boxes[id].xMin + boxes[id].xMax; };
+    auto centreY = [boxes](int id) { return boxes[id].yMin + boxes[id].yMax; };
+    sort(order_.begin(), order_.end(), [&](int a, int b) { return centreX(a) < centreX(b); });
+    size_t leaves = (n + fanout - 1) / fanout;
+    size_t slices = max<size_t>(1, ceil(sqrt(static_cast<double>(leaves))));
+    size_t perSlice = (leaves + slices - 1) / slices * fanout;
+    for (size_t first = 0; first < n; first += perSlice) {
+        auto end = order_.begin() + min(first + perSlice, n);
+        sort(order_.begin() + first, end, [&](int a, int b) { return centreY(a) < centreY(b); });
+    }
+
+    /* One level per fanout-fold reduction, down to a single root */
+    levels_.clear();
+    size_t total = 0;
+    for (size_t count = n; ; count = (count + fanout - 1) / fanout) {
+        levels_.push_back(total);
+        total += count;
+        if (count <= 1) {
+            break;
+        }
+    }
+    levels_.push_back(total);
+    boxes_.resize(total);
+    for (size_t i = 0; i < n; i++) {
+        boxes_[i] = boxes[order_[i]];
+    }
+    computeNodes_();
+    return;
+}
+
+void PackedRTree::refit(const BoundingBox* boxes, size_t n) {
+
+    if (n != order_.size()) {
+        build(boxes, n);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        boxes_[i] = boxes[order_[i]];
+    }
+    computeNodes_();
+    return;
+}
+
+void PackedRTree::computeNodes_() {
+
+    for (size_t level = 1; level + 1 < levels_.size(); level++) {
+        size_t below = levels_[level - 1];
+        size_t belowCount = levels_[level] - below;
+        size_t count = levels_[level + 1] - levels_[level];
+        for (size_t node = 0; node < count; node++) {
+            size_t first = node * fanout;
+            size_t last = min(first + fanout, belowCount);
+            BoundingBox b = boxes_[below + first];
+            for (size_t child = first + 1; child < last; child++) {
+                b = b.united(boxes_[below + child]);
+            }
+            boxes_[levels_[level] + node] = b;
+        }
+    }
+    return;
+}
+
+size_t PackedRTree::size() const {
+    return order_.size();
+}
@@ -0,0 +1,347 @@
+#ifndef SPATIALINDEX_H_
+#define SPATIALINDEX_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "BoundingBox.h"
+
+/*
+ * Uniform grid over the plane. Every entry is bucketed into each square
+ * cell of side cellSize() its bounds overlap, so a point query only has
+ * to look at the entries of a single cell. The grid is sparse: only
+ * occupied cells are stored, so entries may lie anywhere in the plane.
+ * Entries are identified by small non-negative integer ids.
+ */
+class UniformGrid {
+
+    public:
+        // Default constructor is not meaningful without a cell size
+        UniformGrid() = delete;
+
+        // Constructor.
+        // If cellSize is zero or negative, throw a std::invalid_argument exception.
+        explicit UniformGrid(float cellSize);
+
+        // Add the entry id with bounds b. An existing entry id is replaced.
+        void insert(int id, const BoundingBox& b);
+
+        // Move the entry id to the bounds b
+        void update(int id, const BoundingBox& b);
+
+        // Move each entry ids[i] to the bounds boxes[i], for i < n. When the
+        // batch is a large part of the grid, every cell is rebuilt at once
+        // instead of moving the entries one at a time.
+        void update(const int* ids, const BoundingBox* boxes, size_t n);
+
+        // Remove the entry id. Unknown ids are ignored.
+        void remove(int id);
+
+        // Append to hits the ids whose bounds contain (x, y), in no
+        // particular order
+        void query(float x, float y, std::vector<int>& hits) const;
+
+        // Call visit(id) for every id whose bounds contain (x, y), in no
+        // particular order. Nothing is allocated.
+        template <class Visitor>
+        void visit(float x, float y, Visitor visit) const;
+
+        // Append to hits the ids whose bounds intersect box, each one once
+        // and in no particular order
+        void query(const BoundingBox& box, std::vector<int>& hits) const;
+
+        // Return the bounds stored for the entry id
+        const BoundingBox& bounds(int id) const;
+
+        // Return the side of a grid cell
+        float cellSize() const;
+
+        // Change the side of a grid cell and rebucket every entry.
+        // If f is zero or negative, throw a std::invalid_argument exception.
+        void setCellSize(float f);
+
+        // Entries overlapping more cells than this are not bucketed but kept
+        // on a list that every query scans
+        static constexpr int maxCellsPerEntry = 64;
+
+    private:
+        // Cell range overlapped by an entry
+        struct CellRange {
+            int cx0, cy0, cx1, cy1;
+        };
+
+        CellRange range_(const BoundingBox& b) const;
+        const std::vector<int>* cell_(float x, float y) const;
+        bool isLarge_(const CellRange& r) const;
+        void link_(int id);
+        void unlink_(int id);
+        void relinkAll_();
+
+        float cellSize_;
+        // Bounds of every entry, indexed by id
+        std::vector<BoundingBox> bounds_;
+        // Whether the id is currently stored
+        std::vector<bool> present_;
+        // Occupied cells, keyed by packed cell co-ordinates
+        std::unordered_map<long long, std::vector<int>> cells_;
+        // Entries too large to bucket
+        std::vector<int> large_;
+};
+
+template <class Visitor>
+void UniformGrid::visit(float x, float y, Visitor visit) const {
+
+    const std::vector<int>* ids = cell_(x, y);
+    if (ids != nullptr) {
+        for (int id : *ids) {
+            if (bounds_[id].contains(x, y)) {
+                visit(id);
+            }
+        }
+    }
+    for (int id : large_) {
+        if (bounds_[id].contains(x, y)) {
+            visit(id);
+        }
+    }
+    return;
+}
+
+/*
+ * Sweep and prune along x. Entries are kept sorted by the left edge of
+ * their bounds, so that every pair whose bounds intersect is found by one
+ * sweep that only compares entries overlapping in x. Entries that move a
+ * little, as most do from one update to the next, leave the order nearly
+ * sorted, and the next sweep repairs it by insertion sort; if that takes
+ * more than a few shifts per entry, a full sort takes over, so a sweep
+ * never costs more than about n log n plus the overlaps in x. Entries are
+ * identified by small non-negative integer ids.
+ */
+class SweepAndPrune {
+
+    public:
+        // Constructor for an empty index
+        SweepAndPrune();
+
+        // Add the entry id with bounds b. An existing entry id is moved.
+        void insert(int id, const BoundingBox& b);
+
+        // Move the entry id to the bounds b
+        void update(int id, const BoundingBox& b);
+
+        // Remove the entry id. Unknown ids are ignored.
+        void remove(int id);
+
+        // Append to hits every pair of ids whose bounds intersect, the
+        // smaller id first, each pair once and in no particular order.
+        // Sorts the entries first if anything has moved.
+        void pairs(std::vector<std::pair<int, int>>& hits);
+
+        // Return the number of entries
+        size_t size() const;
+
+    private:
+        struct Entry {
+            float xMin;
+            float xMax;
+            float yMin;
+            float yMax;
+            int id;
+        };
+
+        // Sort entries_ by xMin again
+        void sort_();
+
+        // Entries, sorted by xMin unless some have moved since
+        std::vector<Entry> entries_;
+        // Position of every id in entries_, or -1
+        std::vector<int> pos_;
+        // Number of entries added or moved since the last sort
+        size_t moved_;
+};
+
+/*
+ * Static R-tree bulk loaded by sort-tile-recursive packing. Entries are
+ * sorted into vertical slices by the x of their centres, and each slice
+ * by y, then packed fanout to a leaf; every level above groups the
+ * nodes below it the same way. All levels, entry boxes included, are
+ * kept in one flat array of bounds, so nodes are found by arithmetic
+ * and nothing is allocated per node. Entries are the ids 0..n-1 of the
+ * boxes the tree is built over.
+ */
+class PackedRTree {
+
+    public:
+        // An entry found by nearest(), with its distance
+        struct Neighbour {
+            float distance;
+            int id;
+        };
+
+        // A node waiting to be searched by nearest()
+        struct Candidate {
+            float distance;
+            int level;
+            size_t index;
+        };
+
+        // Constructor for an empty tree
+        PackedRTree();
+
+        // Build the tree over boxes[0..n), box i being the entry i
+        void build(const BoundingBox* boxes, size_t n);
+
+        // Keep the tree's shape but move every entry i to boxes[i] and
+        // recompute the bounds of every node, in one pass. n must be the
+        // size the tree was built with. Cheaper than build() when entries
+        // have moved; queries stay exact, though a tree refitted after
+        // large moves prunes less well than a rebuilt one.
+        void refit(const BoundingBox* boxes, size_t n);
+
+        // Call visit(id) for every entry whose bounds intersect box, in no
+        // particular order. Nothing is allocated.
+        template <class Visitor>
+        void visit(const BoundingBox& box, Visitor visit) const;
+
+        // Append to found the k entries nearest (x, y), nearest first, or
+        // every entry if there are fewer. distance(id) gives the distance
+        // from (x, y) to entry id and must be no less than the distance to
+        // its box. queue is scratch space, so that a caller making many
+        // searches allocates nothing once it has grown.
+        template <class Distance>
+        void nearest(float x, float y, size_t k, Distance distance,
+                std::vector<Neighbour>& found, std::vector<Candidate>& queue) const;
+
+        // Return the number of entries
+        size_t size() const;
+
+        // Children per node
+        static constexpr int fanout = 16;
+
+    private:
+        // Recompute the bounds of every node above the entries
+        void computeNodes_();
+
+        // Entry id of every position of the bottom level
+        std::vector<int> order_;
+        // Every level, bottom first: the entries in order_ order, then the
+        // nodes of each level up to the root
+        std::vector<BoundingBox> boxes_;
+        // Start of each level within boxes_, followed by boxes_.size()
+        std::vector<size_t> levels_;
+};
+
+template <class Visitor>
+void PackedRTree::visit(const BoundingBox& box, Visitor visit) const {
+
+    if (order_.empty()) {
+        return;
+    }
+    /* Depth first, with a stack of (level, index) deep enough for any tree
+     * of fewer than 2^32 entries */
+    struct Item {
+        int level;
+        size_t index;
+    };
+    Item stack[8 * fanout];
+    int top = 0;
+    stack[top++] = Item { static_cast<int>(levels_.size()) - 2, 0 };
+    while (top > 0) {
+        Item item = stack[--top];
+        if (!boxes_[levels_[item.level] + item.index].intersects(box)) {
+            continue;
+        }
+        if (item.level == 0) {
+            visit(order_[item.index]);
+            continue;
+        }
+        size_t first = item.index * fanout;
+        size_t count = levels_[item.level] - levels_[item.level - 1];
+        size_t last = (first + fanout < count) ? first + fanout : count;
+        if (item.level == 1) {
+            /* Entries are tested in place rather than pushed */
+            for (size_t child = first; child < last; child++) {
+                if (boxes_[child].intersects(box)) {
+                    visit(order_[child]);
+                }
+            }
+            continue;
+        }
+        for (size_t child = first; child < last; child++) {
+            stack[top++] = Item { item.level - 1, child };
+        }
+    }
+    return;
+}
+
+template <class Distance>
+void PackedRTree::nearest(float x, float y, size_t k, Distance distance,
+        std::vector<Neighbour>& found, std::vector<Candidate>& queue) const {
+
+    if (order_.empty() || k == 0) {
+        return;
+    }
+    /*
+     * The best k so far are kept sorted at the end of found, and the
+     * farthest of them bounds the search once there are k. Nodes wait in
+     * queue by the distance to their bounds and the nearest is opened
+     * next, so the search ends when it is no nearer than the bound. An
+     * entry is only measured itself when its bounds are nearer than the
+     * bound, which keeps lookups of the entries, scattered through
+     * memory, few.
+     */
+    size_t base = found.size();
+    auto offer = [&](float d, int id) {
+        if (found.size() - base == k) {
+            if (d >= found.back().distance) {
+                return;
+            }
+            found.pop_back();
+        }
+        found.push_back(Neighbour { d, id });
+        for (size_t i = found.size() - 1; i > base && found[i - 1].distance > d; i--) {
+            std::swap(found[i - 1], found[i]);
+        }
+    };
+    auto bound = [&]() {
+        return (found.size() - base == k) ? found.back().distance
+            : std::numeric_limits<float>::infinity();
+    };
+    auto farther = [](const Candidate& a, const Candidate& b) {
+        return a.distance > b.distance;
+    };
+
+    int root = static_cast<int>(levels_.size()) - 2;
+    if (root == 0) {
+        offer(distance(order_[0]), order_[0]);
+        return;
+    }
+    queue.clear();
+    queue.push_back(Candidate { boxes_[levels_[root]].distance(x, y), root, 0 });
+    while (!queue.empty() && queue.front().distance < bound()) {
+        std::pop_heap(queue.begin(), queue.end(), farther);
+        Candidate item = queue.back();
+        queue.pop_back();
+        size_t first = item.index * fanout;
+        size_t count = levels_[item.level] - levels_[item.level - 1];
+        size_t last = (first + fanout < count) ? first + fanout : count;
+        for (size_t child = first; child < last; child++) {
+            float d = boxes_[levels_[item.level - 1] + child].distance(x, y);
+            if (d >= bound()) {
+                continue;
+            }
+            if (item.level == 1) {
+                offer(distance(order_[child]), order_[child]);
+            } else {
+                queue.push_back(Candidate { d, item.level - 1, child });
+                std::push_heap(queue.begin(), queue.end(), farther);
+            }
+        }
+    }
+    return;
+}
+
+#endif /* SPATIALINDEX_H_ */
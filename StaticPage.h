@@ -0,0 +1,147 @@
+#ifndef STATICPAGE_H_
+#define STATICPAGE_H_
+
+#include <cstddef>
+#include "Raster.h"
+#include "ShapeValue.h"
+
+/*
+ * A character page of W * H cells laid out as FrameBuffer lays out its
+ * page: rows top to bottom, each followed by '\n', with the bottom-left
+ * cell at (0, 0). Every call but frameBuffer() is constexpr, so shapes
+ * known when the program is compiled can be drawn into a page that is a
+ * constant itself: ShapeValue::draw() takes it like any other target, and
+ * rasterize() below draws a whole table of shapes. Such a page costs
+ * nothing at run time until it is handed to Scene::setBackground().
+ */
+template <int W, int H>
+class StaticPage {
+
+    static_assert(W > 0 && H > 0, "zero or negative page size.");
+
+    public:
+        // Constructor for a blank page
+        constexpr StaticPage();
+
+        // Mark the cell (x, y). Cells off the page are ignored.
+        constexpr void plot(int x, int y);
+
+        // Mark the cells x0..x1 (inclusive) of row y, clipped to the page
+        constexpr void fillSpan(int y, int x0, int x1);
+
+        // Return the cells of the whole page, which drawing is clipped to
+        constexpr const CellRect& clip() const;
+
+        // Return the cell (x, y), or blank if it is off the page
+        constexpr char at(int x, int y) const;
+
+        // Return the page as FrameBuffer::write() would write it, size
+        // characters in all
+        constexpr const char* data() const;
+
+        // Return a FrameBuffer holding the same cells
+        FrameBuffer frameBuffer() const;
+
+        // Return the number of columns of the page
+        constexpr int width() const;
+
+        // Return the number of rows of the page
+        constexpr int height() const;
+
+        // Number of characters of the page, newlines included
+        static constexpr size_t size = static_cast<size_t>(H) * (W + 1);
+
+    private:
+        // Return the index of the first cell of row y
+        static constexpr size_t row_(int y);
+
+        CellRect clip_;
+        char cells_[size];
+};
+
+// Return a page with every shape of shapes drawn in FrameBuffer::ink,
+// whatever its depth. Used in a constant expression, the page is drawn by
+// the compiler.
+template <int W, int H, size_t N>
+constexpr StaticPage<W, H> rasterize(const ShapeValue (&shapes)[N]) {
+    StaticPage<W, H> page;
+    for (size_t i = 0; i < N; i++) {
+        shapes[i].draw(page);
+    }
+    return page;
+}
+
+// ============== StaticPage class ================
+
+template <int W, int H>
+constexpr size_t StaticPage<W, H>::size;
+
+template <int W, int H>
+constexpr StaticPage<W, H>::StaticPage() : clip_ { 0, 0, W - 1, H - 1 }, cells_() {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            cells_[row_(y) + x] = FrameBuffer::blank;
+        }
+        cells_[row_(y) + W] = '\n';
+    }
+}
+
+template <int W, int H>
+constexpr size_t StaticPage<W, H>::row_(int y) {
+    /* Row 0 of the page is the top of the scene */
+    return static_cast<size_t>(H - 1 - y) * (W + 1);
+}
+
+template <int W, int H>
+constexpr void StaticPage<W, H>::plot(int x, int y) {
+    if (x < 0 || x >= W || y < 0 || y >= H) {
+        return;
+    }
+    cells_[row_(y) + x] = FrameBuffer::ink;
+    return;
+}
+
+template <int W, int H>
+constexpr void StaticPage<W, H>::fillSpan(int y, int x0, int x1) {
+    if (y < 0 || y >= H) {
+        return;
+    }
+    for (int x = (x0 < 0) ? 0 : x0; x <= x1 && x < W; x++) {
+        cells_[row_(y) + x] = FrameBuffer::ink;
+    }
+    return;
+}
+
+template <int W, int H>
+constexpr const CellRect& StaticPage<W, H>::clip() const {
+    return clip_;
+}
+
+template <int W, int H>
+constexpr char StaticPage<W, H>::at(int x, int y) const {
+    return (x < 0 || x >= W || y < 0 || y >= H) ? FrameBuffer::blank : cells_[row_(y) + x];
+}
+
+template <int W, int H>
+constexpr const char* StaticPage<W, H>::data() const {
+    return cells_;
+}
+
+template <int W, int H>
+FrameBuffer StaticPage<W, H>::frameBuffer() const {
+    FrameBuffer page(W, H);
+    page.load(cells_);
+    return page;
+}
+
+template <int W, int H>
+constexpr int StaticPage<W, H>::width() const {
+    return W;
+}
+
+template <int W, int H>
+constexpr int StaticPage<W, H>::height() const {
+    return H;
+}
+
+#endif /* STATICPAGE_H_ */
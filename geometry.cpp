@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
 #include "Geometry.h"
+#include "Kernels.h"
+#include "SceneFile.h"
 #include "math.h"
-#include "sstream"
 
 // ============ Shape class =================
 
@@ -14,10 +20,29 @@ Shape::Shape(int d) : xMinCoord_(0), yMinCoord_(0),
         }
 }
 
+Shape::Shape(const Shape& other) : shapeDim_(other.shapeDim_),
+    xMinCoord_(other.xMinCoord_), yMinCoord_(other.yMinCoord_),
+    xMaxCoord_(other.xMaxCoord_), yMaxCoord_(other.yMaxCoord_),
+    area_(other.area_), shapeDepth_(other.shapeDepth_) {
+}
+
+Shape& Shape::operator=(const Shape& other) {
+    shapeDim_ = other.shapeDim_;
+    xMinCoord_ = other.xMinCoord_;
+    yMinCoord_ = other.yMinCoord_;
+    xMaxCoord_ = other.xMaxCoord_;
+    yMaxCoord_ = other.yMaxCoord_;
+    area_ = other.area_;
+    shapeDepth_ = other.shapeDepth_;
+    notifyChanged_();
+    return *this;
+}
+
 bool Shape::setDepth(int d) {
 
     if (d >= 0) {
         shapeDepth_ = d;
+        notifyChanged_();
         return true;
     }
     else {
@@ -62,12 +87,17 @@ void Shape::translate(float x, float y) {
     xMaxCoord_ += x;
     yMinCoord_ += y;
     yMaxCoord_ += y;
+    notifyChanged_();
     return;
 }
 float Shape::area() const {
     return area_;
 }
 
+BoundingBox Shape::bounds() const {
+    return BoundingBox { xMinCoord_, yMinCoord_, xMaxCoord_, yMaxCoord_ };
+}
+
 void Shape::rotate() {
     return;
 }
@@ -79,6 +109,90 @@ void Shape::scale(float f) {
     return;
 }
 
+void Shape::containsMany(const float* xs, const float* ys, size_t n,
+        uint64_t* mask) const {
+    containsMany_(xs, ys, n, mask);
+    return;
+}
+
+void Shape::containsMany(const float* xs, const float* ys, size_t n,
+        vector<size_t>& indices) const {
+
+    /* Work through the points in blocks, so that no mask is allocated */
+    const size_t block = 1024;
+    uint64_t mask[block / 64];
+    for (size_t first = 0; first < n; first += block) {
+        size_t count = (n - first < block) ? n - first : block;
+        containsMany_(xs + first, ys + first, count, mask);
+        size_t before = indices.size();
+        batch::appendSetBits(mask, count, indices);
+        for (size_t index = before; index < indices.size(); index++) {
+            indices[index] += first;
+        }
+    }
+    return;
+}
+
+void Shape::containsMany_(const float* xs, const float* ys, size_t n,
+        uint64_t* mask) const {
+    BoundingBox b = bounds();
+    batch::pointsInBox(xs, ys, n, b.xMin, b.yMin, b.xMax, b.yMax, mask);
+    return;
+}
+
+bool Shape::intersects(const Shape& other) const {
+    return value().intersects(other.value());
+}
+
+float Shape::distance(const Point& p) const {
+    return value().distance(p.getX(), p.getY());
+}
+
+void Shape::draw(FrameBuffer& fb) const {
+    value().draw(fb);
+    return;
+}
+
+void Shape::attach(ShapeObserver* o, int slot) {
+    if (observer_.first == nullptr) {
+        observer_ = make_pair(o, slot);
+    } else {
+        observers_.push_back(make_pair(o, slot));
+    }
+    return;
+}
+
+void Shape::detach(ShapeObserver* o, int slot) {
+    if (observer_.first == o && observer_.second == slot) {
+        /* Keep the inline observer filled while others remain */
+        if (observers_.empty()) {
+            observer_ = make_pair(nullptr, 0);
+        } else {
+            observer_ = observers_.back();
+            observers_.pop_back();
+        }
+        return;
+    }
+    for (auto iter = observers_.begin(); iter != observers_.end(); iter++) {
+        if (iter->first == o && iter->second == slot) {
+            observers_.erase(iter);
+            break;
+        }
+    }
+    return;
+}
+
+void Shape::notifyChanged_() const {
+    if (observer_.first == nullptr) {
+        return;
+    }
+    observer_.first->shapeChanged(observer_.second);
+    for (const auto& observer : observers_) {
+        observer.first->shapeChanged(observer.second);
+    }
+    return;
+}
+
 // =============== Point class ================
 Point::Point(float x, float y, int d) : Shape(d) {
     xMinCoord_ = x;
@@ -95,6 +209,14 @@ bool Point::contains(const Point& p) const {
     }
 }
 
+BoundingBox Point::bounds() const {
+    return BoundingBox { getX(), getY(), getX(), getY() };
+}
+
+ShapeValue Point::value() const {
+    return ShapeValue(PointValue { getX(), getY() }, getDepth());
+}
+
 // =========== LineSegment class ==============
 
 LineSegment::LineSegment(const Point& p, const Point& q) : Shape(p.getDepth()) {
@@ -145,6 +267,10 @@ float LineSegment::length() const {
     return lineSegLength_;
 }
 
+ShapeValue LineSegment::value() const {
+    return ShapeValue(SegmentValue { getXmin(), getYmin(), getXmax(), getYmax() }, getDepth());
+}
+
 void LineSegment::rotate() {
 
     if (getYmin() == getYmax()) {
@@ -160,6 +286,8 @@ void LineSegment::rotate() {
         xMaxCoord_ += lineSegLength_/2;
         xMinCoord_ -= lineSegLength_/2;
     }
+    lineSegLength_ = (xMaxCoord_ - xMinCoord_) + (yMaxCoord_ - yMinCoord_);
+    notifyChanged_();
     return;
 }
 
@@ -200,6 +328,9 @@ void LineSegment::scale(float f) {
         yMinCoord_ = middle - (lineSegLength_/2) * f;
         yMaxCoord_ = middle + (lineSegLength_/2) * f;
     }
+    /* Later calls start from the new length, as ShapeValue's do */
+    lineSegLength_ = (xMaxCoord_ - xMinCoord_) + (yMaxCoord_ - yMinCoord_);
+    notifyChanged_();
     return;
 }
 
@@ -230,6 +361,10 @@ Rectangle::Rectangle(const Point& p, const Point& q) : TwoDShape(p.getDepth()) {
     }
 }
 
+ShapeValue Rectangle::value() const {
+    return ShapeValue(RectangleValue { getXmin(), getYmin(), getXmax(), getYmax() }, getDepth());
+}
+
 bool Rectangle::contains(const Point& p) const {
 
     if (getXmin() <= p.getX() && getXmax() >= p.getX() &&
@@ -251,6 +386,8 @@ void Rectangle::rotate() {
     xMaxCoord_ = xCenter + yDiff;
     yMaxCoord_ = yCenter + xDiff;
     yMinCoord_ = yCenter - xDiff;
+    area_ = (xMaxCoord_ - xMinCoord_) * (yMaxCoord_ - yMinCoord_);
+    notifyChanged_();
     return;
 }
 
@@ -269,6 +406,8 @@ void Rectangle::scale(float f) {
     xMaxCoord_ = xCenter + (xDiff * f);
     yMinCoord_ = yCenter - (yDiff * f);
     yMaxCoord_ = yCenter + (yDiff * f);
+    area_ = (xMaxCoord_ - xMinCoord_) * (yMaxCoord_ - yMinCoord_);
+    notifyChanged_();
     return;
 }
 
@@ -288,186 +427,789 @@ float Circle::getR() const {
     return radCircle_;
 }
 
+BoundingBox Circle::bounds() const {
+    return BoundingBox { getX() - radCircle_, getY() - radCircle_,
+        getX() + radCircle_, getY() + radCircle_ };
+}
+
+ShapeValue Circle::value() const {
+    return ShapeValue(CircleValue { getX(), getY(), getR() }, getDepth());
+}
+
 bool Circle::contains(const Point& p) const {
 
-    float xDiff = pow((getX() - p.getX()), 2);
-    float yDiff = pow((getY() - p.getY()), 2);
-    float rootAns = sqrt(xDiff + yDiff);
+    /* Compare squared distances, so no pow or sqrt is needed */
+    float xDiff = getX() - p.getX();
+    float yDiff = getY() - p.getY();
 
-    if (getR() > rootAns) {
+    if (xDiff * xDiff + yDiff * yDiff < getR() * getR()) {
         return true;
     } else {
         return false;
     }
 }
 
+void Circle::containsMany_(const float* xs, const float* ys, size_t n,
+        uint64_t* mask) const {
+    batch::pointsInCircle(xs, ys, n, getX(), getY(), getR(), mask);
+    return;
+}
+
 void Circle::scale(float f) {
 
     if (f <= 0) {
         throw invalid_argument("zero or negative factor.");
     }
     radCircle_ = radCircle_ * f;
+    area_ = PI * pow(radCircle_, 2);
+    notifyChanged_();
     return;
 }
 
 // ================= Scene class ===================
 
-Scene::Scene() : sceneDepth_(0) {
-    string blankline(WIDTH, ' ');
-    for(int index = 0; index < HEIGHT; index++) {
-        scenePage_+= blankline + "\n";
+namespace {
+
+// Name the shape about to be drawn, for targets that keep track of it
+void setSource(FrameBuffer&, int, int) {
+}
+
+void setSource(DepthBuffer& target, int id, int depth) {
+    target.setSource(id, depth);
+}
+
+}
+
+constexpr float Scene::INDEX_CELL;
+constexpr size_t Scene::MAX_DIRTY;
+constexpr int Scene::TILE;
+
+Scene::Scene() : Scene(WIDTH, HEIGHT) {
+}
+
+Scene::Scene(int width, int height) : width_(width), height_(height),
+    sceneDepth_(0), index_(INDEX_CELL), rtreeMoved_(false), redrawAll_(true),
+    renderThreads_(1), depthCompositing_(false) {
+
+    if (width <= 0 || height <= 0) {
+        throw invalid_argument("zero or negative drawing area.");
     }
-    /* TODO: Initialise the shared_ptr */
 }
 
-void Scene::addObject(shared_ptr<Shape> ptr) {
-    this->shapePtr_.push_back(shared_ptr<Shape> (ptr));
+Scene::Scene(const SceneFile& file) : Scene(file.width(), file.height()) {
+    size_t count = file.size();
+    shapePtr_.reserve(count);
+    values_.reserve(count);
+    glyphs_.reserve(count);
+    layerPos_.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        add(file.value(i));
+    }
+}
+
+Scene::~Scene() {
+    for (int slot = 0; slot < static_cast<int>(shapePtr_.size()); slot++) {
+        if (shapePtr_[slot]) {
+            shapePtr_[slot]->detach(this, slot);
+        }
+    }
+}
+
+int Scene::addObject(shared_ptr<Shape> ptr) {
+    ShapeValue v = ptr->value();
+    int slot = add(v);
+    ptr->attach(this, slot);
+    shapePtr_[slot] = std::move(ptr);
+    return slot;
+}
+
+int Scene::add(const ShapeValue& v) {
+    int slot = shapePtr_.size();
+    shapePtr_.emplace_back();
+    values_.push_back(v);
+    glyphs_.push_back(FrameBuffer::ink);
+    index_.insert(slot, v.bounds());
+    sweep_.insert(slot, v.bounds());
+    vector<int>& layer = layers_[v.depth()];
+    layerPos_.push_back(layer.size());
+    layer.push_back(slot);
+    if (visible_(slot)) {
+        markDirty_(index_.bounds(slot));
+    }
+    return slot;
+}
+
+int Scene::add(const ShapeValue* shapes, size_t n) {
+    int first = size();
+    shapePtr_.reserve(shapePtr_.size() + n);
+    values_.reserve(values_.size() + n);
+    glyphs_.reserve(glyphs_.size() + n);
+    layerPos_.reserve(layerPos_.size() + n);
+    for (size_t i = 0; i < n; i++) {
+        add(shapes[i]);
+    }
+    return first;
+}
+
+int Scene::size() const {
+    return values_.size();
+}
+
+const ShapeValue& Scene::value(int slot) const {
+    if (slot < 0 || slot >= size()) {
+        throw out_of_range("no shape in slot.");
+    }
+    return values_[slot];
+}
+
+void Scene::setGlyph(int slot, char glyph) {
+    if (slot < 0 || slot >= size()) {
+        throw out_of_range("no shape in slot.");
+    }
+    if (glyph == '\n') {
+        throw invalid_argument("newline glyph.");
+    }
+    glyphs_[slot] = glyph;
+    if (depthCompositing_ && visible_(slot)) {
+        markDirty_(index_.bounds(slot));
+    }
+    return;
+}
+
+char Scene::glyph(int slot) const {
+    if (slot < 0 || slot >= size()) {
+        throw out_of_range("no shape in slot.");
+    }
+    return glyphs_[slot];
+}
+
+void Scene::setDepthCompositing(bool on) {
+    if (on != depthCompositing_) {
+        depthCompositing_ = on;
+        invalidate();
+    }
+    return;
+}
+
+bool Scene::depthCompositing() const {
+    return depthCompositing_;
+}
+
+int Scene::pick(int x, int y) const {
+    return pickBuffer().at(x, y);
+}
+
+const PickBuffer& Scene::pickBuffer() const {
+    if (!pick_) {
+        pick_.reset(new PickBuffer(width_, height_));
+        redrawAll_ = true;
+        dirty_.clear();
+    }
+    render_();
+    return *pick_;
+}
+
+void Scene::setValue(int slot, const ShapeValue& v) {
+    if (slot < 0 || slot >= size()) {
+        throw out_of_range("no shape in slot.");
+    }
+    if (shapePtr_[slot]) {
+        throw invalid_argument("shape in slot is not held by value.");
+    }
+    store_(slot, v);
+    return;
+}
+
+void Scene::translate(const vector<int>& slots, float x, float y) {
+    transform_(slots, [x, y](ShapeValue& v) { v.translate(x, y); });
+    return;
+}
+
+void Scene::scale(const vector<int>& slots, float f) {
+    if (f <= 0) {
+        throw invalid_argument("zero or negative factor.");
+    }
+    transform_(slots, [f](ShapeValue& v) { v.scale(f); });
+    return;
+}
+
+void Scene::rotate(const vector<int>& slots) {
+    transform_(slots, [](ShapeValue& v) { v.rotate(); });
+    return;
+}
+
+void Scene::transform(const vector<int>& slots, const ShapeTransform& t) {
+    transform_(slots, [&t](ShapeValue& v) { v = t.apply(v); });
+    return;
+}
+
+template <class Op>
+void Scene::transform_(const vector<int>& slots, Op op) {
+
+    /* Check every slot first, so that a bad one changes nothing */
+    for (int slot : slots) {
+        if (slot < 0 || slot >= size()) {
+            throw out_of_range("no shape in slot.");
+        }
+        if (shapePtr_[slot]) {
+            throw invalid_argument("shape in slot is not held by value.");
+        }
+    }
+    BoundingBox before { 0, 0, 0, 0 };
+    bool anyVisible = false;
+    for (int slot : slots) {
+        if (visible_(slot)) {
+            before = anyVisible ? before.united(index_.bounds(slot)) : index_.bounds(slot);
+            anyVisible = true;
+        }
+    }
+
+    /*
+     * The values are changed in one tight loop over the list, inlined for
+     * Op. A large batch is shared out by slot number rather than by list
+     * position, so a slot listed twice is always changed by one thread,
+     * in list order. Each thread takes a contiguous range of slots, so
+     * threads share no cache line of values_ but at the range ends, and
+     * the list is bucketed by range once, stably, rather than scanned by
+     * every thread.
+     */
+    const size_t minPerThread = 16384;
+    int threads = max<int>(1, min<size_t>(renderThreads_, slots.size() / minPerThread));
+    if (threads == 1) {
+        for (int slot : slots) {
+            op(values_[slot]);
+        }
+    } else {
+        int range = (size() + threads - 1) / threads;
+        vector<size_t> start(threads + 1, 0);
+        for (int slot : slots) {
+            start[slot / range + 1]++;
+        }
+        for (int thread = 0; thread < threads; thread++) {
+            start[thread + 1] += start[thread];
+        }
+        vector<int> bucketed(slots.size());
+        vector<size_t> next(start.begin(), start.end() - 1);
+        for (int slot : slots) {
+            bucketed[next[slot / range]++] = slot;
+        }
+        auto worker = [&](int thread) {
+            for (size_t i = start[thread]; i < start[thread + 1]; i++) {
+                op(values_[bucketed[i]]);
+            }
+        };
+        vector<std::thread> pool;
+        for (int thread = 1; thread < threads; thread++) {
+            pool.emplace_back(worker, thread);
+        }
+        worker(0);
+        for (auto& t : pool) {
+            t.join();
+        }
+    }
+
+    /* One index update and at most two dirty regions for the batch */
+    batchBounds_.resize(slots.size());
+    BoundingBox after = before;
+    bool first = true;
+    for (size_t i = 0; i < slots.size(); i++) {
+        batchBounds_[i] = values_[slots[i]].bounds();
+        if (visible_(slots[i])) {
+            after = first ? batchBounds_[i] : after.united(batchBounds_[i]);
+            first = false;
+        }
+    }
+    index_.update(slots.data(), batchBounds_.data(), slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        sweep_.update(slots[i], batchBounds_[i]);
+    }
+    rtreeMoved_ = true;
+    if (anyVisible) {
+        markDirty_(before);
+        markDirty_(after);
+    }
     return;
 }
 
 void Scene::setDrawDepth(int depth) {
+
+    /*
+     * Only the layers between the old and the new drawing depth appear
+     * or disappear, so only their shapes' regions need redrawing. Layers
+     * that stay hidden are never looked at.
+     */
+    const int all = numeric_limits<int>::max();
+    int before = (sceneDepth_ == 0) ? all : sceneDepth_;
+    int after = (depth == 0) ? all : depth;
     sceneDepth_ = depth;
+    auto first = layers_.upper_bound(min(before, after));
+    auto last = (max(before, after) == all) ? layers_.end() : layers_.upper_bound(max(before, after));
+    for (auto layer = first; layer != last && !redrawAll_; layer++) {
+        for (int slot : layer->second) {
+            markDirty_(index_.bounds(slot));
+        }
+    }
+    return;
+}
+
+void Scene::setBackground(const FrameBuffer& page) {
+    if (page.width() != width_ || page.height() != height_) {
+        throw invalid_argument("background is not the size of the drawing area.");
+    }
+    background_.reset(new FrameBuffer(page));
+    background_->setOrigin(0, 0);
+    /* Marked once here, so that render(BitCanvas&) unites whole words */
+    backgroundBits_.reset(new BitCanvas(width_, height_));
+    for (int y = 0; y < height_; y++) {
+        int x = 0;
+        while (x < width_) {
+            if (background_->at(x, y) == FrameBuffer::blank) {
+                x++;
+                continue;
+            }
+            int start = x;
+            while (x < width_ && background_->at(x, y) != FrameBuffer::blank) {
+                x++;
+            }
+            backgroundBits_->fillSpan(y, start, x - 1);
+        }
+    }
+    invalidate();
+    return;
+}
+
+void Scene::clearBackground() {
+    if (background_) {
+        background_.reset();
+        backgroundBits_.reset();
+        invalidate();
+    }
+    return;
+}
+
+void Scene::invalidate() {
+    redrawAll_ = true;
+    dirty_.clear();
+    return;
+}
+
+vector<Shape*> Scene::query(const Point& p) const {
+    vector<Shape*> hits;
+    query(p, hits);
+    return hits;
+}
+
+void Scene::query(const Point& p, vector<Shape*>& hits) const {
+    /* The index narrows the search to one cell, contains() decides */
+    index_.visit(p.getX(), p.getY(), [&](int slot) {
+        if (shapePtr_[slot] && values_[slot].contains(p.getX(), p.getY())) {
+            hits.push_back(shapePtr_[slot].get());
+        }
+    });
+    return;
+}
+
+void Scene::querySlots(float x, float y, vector<int>& slots) const {
+    index_.visit(x, y, [&](int slot) {
+        if (values_[slot].contains(x, y)) {
+            slots.push_back(slot);
+        }
+    });
+    return;
+}
+
+void Scene::queryRange(float xMin, float yMin, float xMax, float yMax,
+        vector<int>& slots) const {
+    queryRange(xMin, yMin, xMax, yMax, [&slots](int slot) { slots.push_back(slot); });
+    return;
+}
+
+void Scene::updateRTree_() const {
+    bool added = rtree_.size() != values_.size();
+    if (!added && !rtreeMoved_) {
+        return;
+    }
+    rtreeBounds_.resize(values_.size());
+    for (size_t slot = 0; slot < values_.size(); slot++) {
+        rtreeBounds_[slot] = index_.bounds(slot);
+    }
+    if (added) {
+        rtree_.build(rtreeBounds_.data(), rtreeBounds_.size());
+    } else {
+        rtree_.refit(rtreeBounds_.data(), rtreeBounds_.size());
+    }
+    rtreeMoved_ = false;
+    return;
+}
+
+void Scene::overlaps(vector<pair<int, int>>& pairs) const {
+    /* The sweep pairs up bounds, the values decide */
+    size_t first = pairs.size();
+    sweep_.pairs(pairs);
+    auto apart = [this](const pair<int, int>& p) {
+        return !values_[p.first].intersects(values_[p.second]);
+    };
+    pairs.erase(remove_if(pairs.begin() + first, pairs.end(), apart), pairs.end());
+    return;
+}
+
+void Scene::nearest(float x, float y, int k, vector<int>& slots) const {
+    if (k <= 0) {
+        throw invalid_argument("zero or negative number of shapes.");
+    }
+    updateRTree_();
+    nearFound_.clear();
+    rtree_.nearest(x, y, k, [&](int slot) { return values_[slot].distance(x, y); },
+            nearFound_, nearQueue_);
+    for (const PackedRTree::Neighbour& n : nearFound_) {
+        slots.push_back(n.id);
+    }
+    return;
+}
+
+void Scene::nearest(const float* xs, const float* ys, size_t n, int k,
+        vector<int>& slots) const {
+
+    if (k <= 0) {
+        throw invalid_argument("zero or negative number of shapes.");
+    }
+    updateRTree_();
+    slots.assign(n * k, -1);
+
+    /* Points are shared out in runs; the tree is only read */
+    auto worker = [&](size_t first, size_t last) {
+        vector<PackedRTree::Neighbour> found;
+        vector<PackedRTree::Candidate> queue;
+        for (size_t i = first; i < last; i++) {
+            float x = xs[i], y = ys[i];
+            found.clear();
+            rtree_.nearest(x, y, k, [&](int slot) { return values_[slot].distance(x, y); },
+                    found, queue);
+            for (size_t j = 0; j < found.size(); j++) {
+                slots[i * k + j] = found[j].id;
+            }
+        }
+    };
+    const size_t minPerThread = 1024;
+    int threads = max<int>(1, min<size_t>(renderThreads_, n / minPerThread));
+    size_t perThread = (n + threads - 1) / threads;
+    vector<std::thread> pool;
+    for (int thread = 1; thread < threads; thread++) {
+        pool.emplace_back(worker, min(n, thread * perThread), min(n, (thread + 1) * perThread));
+    }
+    worker(0, min(n, perThread));
+    for (auto& t : pool) {
+        t.join();
+    }
+    return;
+}
+
+void Scene::setIndexCellSize(float f) {
+    index_.setCellSize(f);
+    return;
+}
+
+void Scene::setRenderThreads(int n) {
+    if (n <= 0) {
+        throw invalid_argument("zero or negative number of threads.");
+    }
+    renderThreads_ = n;
+    return;
+}
+
+int Scene::renderThreads() const {
+    return renderThreads_;
+}
+
+const vector<TileTiming>& Scene::tileTimings() const {
+    return tileTimings_;
+}
+
+int Scene::width() const {
+    return width_;
+}
+
+int Scene::height() const {
+    return height_;
+}
+
+void Scene::shapeChanged(int slot) {
+    store_(slot, shapePtr_[slot]->value());
+    return;
+}
+
+void Scene::store_(int slot, const ShapeValue& v) {
+
+    /* The shape has to be cleared where it was and drawn where it is */
+    if (visible_(slot)) {
+        markDirty_(index_.bounds(slot));
+    }
+    if (v.depth() != values_[slot].depth()) {
+        moveLayer_(slot, values_[slot].depth(), v.depth());
+    }
+    values_[slot] = v;
+    index_.update(slot, v.bounds());
+    sweep_.update(slot, v.bounds());
+    rtreeMoved_ = true;
+    if (visible_(slot)) {
+        markDirty_(index_.bounds(slot));
+    }
+    return;
+}
+
+void Scene::moveLayer_(int slot, int from, int to) {
+
+    /* Swap the last slot of the old layer into the hole left behind */
+    auto layer = layers_.find(from);
+    vector<int>& slots = layer->second;
+    int last = slots.back();
+    slots[layerPos_[slot]] = last;
+    layerPos_[last] = layerPos_[slot];
+    slots.pop_back();
+    if (slots.empty()) {
+        layers_.erase(layer);
+    }
+    vector<int>& target = layers_[to];
+    layerPos_[slot] = target.size();
+    target.push_back(slot);
+    return;
+}
+
+bool Scene::visible_(int slot) const {
+    return sceneDepth_ == 0 || values_[slot].depth() <= sceneDepth_;
+}
+
+void Scene::markDirty_(const BoundingBox& b) {
+
+    if (redrawAll_) {
+        return;
+    }
+    BoundingBox page { 0, 0, static_cast<float>(width_ - 1),
+        static_cast<float>(height_ - 1) };
+    if (!b.intersects(page)) {
+        /* Nothing off the page is ever drawn */
+        return;
+    }
+    if (dirty_.size() >= MAX_DIRTY) {
+        redrawAll_ = true;
+        dirty_.clear();
+        return;
+    }
+    /* Clipped, so that render_() can round every region to int */
+    dirty_.push_back(b.intersected(page));
+    return;
+}
+
+int Scene::drawTile_(FrameBuffer& fb, const CellRect& tile, TileScratch& scratch,
+        PickBuffer* pick) const {
+
+    if (depthCompositing_ || pick) {
+        return compositeTile_(fb, tile, scratch, pick);
+    }
+    if (background_) {
+        fb.copyRect(*background_, tile);
+    } else {
+        fb.clearRect(tile);
+    }
+    fb.setClip(tile);
+    int drawn = drawShapes_(fb, tile, scratch.slots);
+    fb.resetClip();
+    return drawn;
+}
+
+int Scene::compositeTile_(FrameBuffer& fb, const CellRect& tile, TileScratch& scratch,
+        PickBuffer* pick) const {
+
+    CellRect all = fb.page();
+    CellRect cells { max(tile.x0, all.x0), max(tile.y0, all.y0),
+        min(tile.x1, all.x1), min(tile.y1, all.y1) };
+    if (!scratch.depth) {
+        scratch.depth.reset(new DepthBuffer(TILE, TILE));
+    }
+    DepthBuffer& depth = *scratch.depth;
+
+    /*
+     * Shapes are offered to the depth buffer one TILE * TILE chunk at a
+     * time, in any order, and the cells they win are then painted with
+     * their glyphs, or just ink when not compositing by depth. The
+     * buffer is reused for every chunk of every frame.
+     */
+    int drawn = 0;
+    for (int y0 = cells.y0; y0 <= cells.y1; y0 += TILE) {
+        for (int x0 = cells.x0; x0 <= cells.x1; x0 += TILE) {
+            CellRect chunk { x0, y0, min(x0 + TILE - 1, cells.x1), min(y0 + TILE - 1, cells.y1) };
+            depth.setOrigin(x0, y0);
+            depth.clear();
+            depth.setClip(chunk);
+            drawn += drawShapes_(depth, chunk, scratch.slots);
+            if (depthCompositing_) {
+                fb.paint(depth, chunk, glyphs_, background_.get());
+            } else {
+                fb.paint(depth, chunk, background_.get());
+            }
+            if (pick) {
+                pick->copyRect(depth, chunk);
+            }
+        }
+    }
+    return drawn;
+}
+
+template <class Target>
+int Scene::drawShapes_(Target& target, const CellRect& cells, vector<int>& slots) const {
+
+    int drawn = 0;
+    if (cells.x0 <= 0 && cells.y0 <= 0 && cells.x1 >= width_ - 1 && cells.y1 >= height_ - 1) {
+        /* The whole page: every shape of the visible layers is a candidate */
+        auto last = (sceneDepth_ == 0) ? layers_.end() : layers_.upper_bound(sceneDepth_);
+        for (auto layer = layers_.begin(); layer != last; layer++) {
+            for (int slot : layer->second) {
+                setSource(target, slot, layer->first);
+                values_[slot].draw(target);
+            }
+            drawn += layer->second.size();
+        }
+        return drawn;
+    }
+    slots.clear();
+    index_.query(BoundingBox { static_cast<float>(cells.x0), static_cast<float>(cells.y0),
+            static_cast<float>(cells.x1), static_cast<float>(cells.y1) }, slots);
+    for (int slot : slots) {
+        if (visible_(slot)) {
+            setSource(target, slot, values_[slot].depth());
+            values_[slot].draw(target);
+            drawn++;
+        }
+    }
+    return drawn;
+}
+
+void Scene::drawAll_() const {
+
+    vector<CellRect> tiles;
+    for (int y0 = 0; y0 < height_; y0 += TILE) {
+        for (int x0 = 0; x0 < width_; x0 += TILE) {
+            tiles.push_back(CellRect { x0, y0, min(x0 + TILE, width_) - 1,
+                    min(y0 + TILE, height_) - 1 });
+        }
+    }
+    tileTimings_.resize(tiles.size());
+
+    int threads = min<int>(renderThreads_, tiles.size());
+    if (threads <= 1) {
+        for (size_t t = 0; t < tiles.size(); t++) {
+            auto start = chrono::steady_clock::now();
+            int drawn = drawTile_(*frame_, tiles[t], scratch_, pick_.get());
+            chrono::duration<double> took = chrono::steady_clock::now() - start;
+            tileTimings_[t] = TileTiming { tiles[t], 0, drawn, took.count() };
+        }
+        return;
+    }
+
+    /*
+     * Workers take the next tile from a shared counter and draw it into
+     * a private tile-sized buffer, which is then copied into its own
+     * cells of the page. Tiles never overlap and every tile is drawn
+     * exactly as the serial loop would, so the page does not depend on
+     * the scheduling.
+     */
+    atomic<size_t> next(0);
+    auto worker = [&](int thread) {
+        FrameBuffer local(TILE, TILE);
+        TileScratch scratch;
+        for (size_t t = next++; t < tiles.size(); t = next++) {
+            auto start = chrono::steady_clock::now();
+            local.setOrigin(tiles[t].x0, tiles[t].y0);
+            int drawn = drawTile_(local, tiles[t], scratch, pick_.get());
+            frame_->copyRect(local, tiles[t]);
+            chrono::duration<double> took = chrono::steady_clock::now() - start;
+            tileTimings_[t] = TileTiming { tiles[t], thread, drawn, took.count() };
+        }
+    };
+    vector<thread> pool;
+    for (int thread = 1; thread < threads; thread++) {
+        pool.emplace_back(worker, thread);
+    }
+    worker(0);
+    for (auto& t : pool) {
+        t.join();
+    }
+    return;
+}
+
+void Scene::render_() const {
+
+    if (!frame_) {
+        frame_.reset(new FrameBuffer(width_, height_));
+        redrawAll_ = true;
+    }
+
+    /*
+     * Every shape draws inside its own bounds, so a part of the page can
+     * be cleared and redrawn from just the shapes the index finds
+     * overlapping it. A full redraw goes tile by tile to stay in cache;
+     * otherwise only the regions changed since the last frame are
+     * redrawn.
+     */
+    if (redrawAll_) {
+        drawAll_();
+        redrawAll_ = false;
+        dirty_.clear();
+        return;
+    }
+
+    for (const BoundingBox& b : dirty_) {
+        CellRect cells { static_cast<int>(floor(b.xMin)), static_cast<int>(floor(b.yMin)),
+            static_cast<int>(ceil(b.xMax)), static_cast<int>(ceil(b.yMax)) };
+        drawTile_(*frame_, cells, scratch_, pick_.get());
+    }
+    dirty_.clear();
+    return;
+}
+
+void Scene::renderTiled(ostream& out) const {
+
+    TileScratch scratch;
+
+    /* Bands run from the top of the page down, as they are written */
+    for (int yTop = height_ - 1; yTop >= 0; yTop -= TILE) {
+        int yBottom = max(yTop - TILE + 1, 0);
+        FrameBuffer band(width_, yTop - yBottom + 1, 0, yBottom);
+        for (int x0 = 0; x0 < width_; x0 += TILE) {
+            CellRect tile { x0, yBottom, min(x0 + TILE, width_) - 1, yTop };
+            drawTile_(band, tile, scratch, nullptr);
+        }
+        band.write(out);
+    }
+    return;
+}
+
+void Scene::render(BitCanvas& canvas) const {
+
+    canvas.clear();
+    canvas.setClip(CellRect { 0, 0, width_ - 1, height_ - 1 });
+    if (backgroundBits_) {
+        canvas.uniteOverlap(*backgroundBits_);
+    }
+    auto last = (sceneDepth_ == 0) ? layers_.end() : layers_.upper_bound(sceneDepth_);
+    for (auto layer = layers_.begin(); layer != last; layer++) {
+        for (int slot : layer->second) {
+            values_[slot].draw(canvas);
+        }
+    }
+    canvas.resetClip();
     return;
 }
 
 ostream& operator<<(ostream& out, const Scene& s) {
 
-    /* Pointer will not point anything initially. */
-    if (s.shapePtr_.empty()) {
-        out << s.scenePage_;
-        return out;
-    }
-    string buffer(""), eachLine("");
-    stringstream blankline(s.scenePage_);
-
-    for (auto vectIter = s.shapePtr_.begin();
-            vectIter != s.shapePtr_.end(); vectIter++) {
-        /* Clear the eachLine after each iteration. */
-        eachLine = "";
-        /* Line will be incremented upto s.HEIGHT */
-        int line = 0;
-
-        /* Clear the flag to reach the beginning of the stringstream. */
-        blankline.clear();
-        blankline.seekg(0);
-
-        /* When the drawing depth is less, store the streams into buffer */
-        if (s.sceneDepth_ != 0 && s.sceneDepth_ < (*vectIter)->getDepth()) {
-            buffer = blankline.str();
-            break; 
-        }
-        /*
-         * Buffer will be cleared after storing into stringstream(blankline)
-         * in each iteration.
-         */
-        buffer = "";
-
-        switch ((*vectIter)->dim())
-        {
-            case 0:
-                {
-                    while (getline(blankline, eachLine, '\n')) {
-                        line++;
-                        if (line != ((s.HEIGHT) - (*vectIter)->getYmin())) {
-                            buffer += eachLine + '\n';
-                            continue;
-                        }
-                        for(int index = 0; index < s.WIDTH; index++) {
-                            if (eachLine[(*vectIter)->getXmin()] == ' ') {
-                                eachLine[(*vectIter)->getXmin()] = '*';
-                                buffer += eachLine + '\n';
-                            }
-                        }
-                    }
-                }
-                break;
-            case 1:
-                {
-                    while (getline(blankline, eachLine, '\n')) {
-                        line++;
-                        if ((*vectIter)->getXmin() == (*vectIter)->getXmax()) {
-                            //Vertical line
-                            if (line > ((s.HEIGHT) - (*vectIter)->getYmin()) &&
-                                    line < ((s.HEIGHT) - (*vectIter)->getYmax())) {
-                                buffer += eachLine + '\n';
-                                continue;
-                            }
-                            for(int index = 0; index < s.WIDTH; index++) {
-                                if (eachLine[(*vectIter)->getXmin()] == ' ') {
-                                    eachLine[(*vectIter)->getXmin()] = '*';
-                                }
-                            }
-                            buffer += eachLine + '\n';
-                        } else if ((*vectIter)->getYmin() == (*vectIter)->getYmax()) {
-                            //Horizontal line
-                            if (line != ((s.HEIGHT) - (*vectIter)->getYmin())) {
-                                buffer += eachLine + '\n';
-                                continue;
-                            }
-                            for(int index = (*vectIter)->getXmin();
-                                    index <= (*vectIter)->getXmax(); index++) {
-                                if (eachLine[index] == ' ') {
-                                    eachLine[index] = '*';
-                                }
-                            }
-                            buffer += eachLine + '\n';
-                        }  // else if
-                    } // while
-                } // case 1
-                break;
-            case 2:
-                {
-                    if ((*vectIter)->getYmax() != 0 && (*vectIter)->getXmax() != 0) {
-                        // Rectangle Class
-                        while (getline(blankline, eachLine, '\n')) {
-                            line++;
-                            if (line > ((s.HEIGHT) - (*vectIter)->getYmin())) {
-                                buffer += eachLine + '\n';
-                                continue;
-                            }
-                            for(int index = (*vectIter)->getXmin();
-                                    index <= (*vectIter)->getXmax(); index++) {
-                                if (eachLine[index] == ' ') {
-                                    eachLine[index] = '*';
-                                }
-                            }
-                            buffer += eachLine + '\n';
-                        } // while
-                    } else if ((*vectIter)->getYmax() == 0 && (*vectIter)->getXmax() == 0) {
-                        float radius = sqrt((*vectIter)->area()/(*vectIter)->PI);
-                        int plane = s.HEIGHT;
-
-                        while (getline(blankline, eachLine, '\n')) {
-                            line++;
-                            plane--;
-                            if ((line < (s.HEIGHT - (*vectIter)->getYmin() - radius)) ||
-                                    (line > (s.HEIGHT - (*vectIter)->getYmin() + radius))) {
-                                buffer += eachLine + '\n';
-                                continue;
-                            }
-
-                            float yDiff = pow(abs(plane - (*vectIter)->getYmin()), 2);
-                            for (float index = (*vectIter)->getXmin() - radius;
-                                    index <= (*vectIter)->getXmin() + radius; index++) {
-
-                                float xDiff = pow((abs((*vectIter)->getXmin() - index)), 2);
-                                float rootAns = sqrt(xDiff + yDiff);
-
-                                if (radius >= rootAns) {
-                                    if (eachLine[index] = ' ') {
-                                        eachLine[index] = '*';
-                                    }
-                                }
-                            }
-                            buffer += eachLine + '\n';
-                        } // while
-                    } // else if
-                } // case 2
-                break;
-        } // Switch Case
-        /* All the collection of pointers should keep adding on the same stringstream */
-        blankline.str(buffer);
-    } // for loop
-    out << buffer;
+    /*
+     * Every shape marks only the cells it covers on the scene's own
+     * framebuffer, which is kept from the previous frame and only
+     * touched where something changed. The finished page goes out in a
+     * single write.
+     */
+    s.render_();
+    s.frame_->write(out);
     return out;
 }
@@ -1,14 +1,36 @@
 #ifndef GEOMETRY_H_
 #define GEOMETRY_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <vector>
+#include "BoundingBox.h"
+#include "Raster.h"
+#include "ShapeArena.h"
+#include "ShapeTransform.h"
+#include "ShapeValue.h"
+#include "SpatialIndex.h"
+
+class SceneFile; // forward declaration
 
 using namespace std;
 
 class Point; // forward declaration
 
+// Interface for objects that keep derived data about shapes, such as a
+// Scene's spatial index, and need to hear when a shape moves or changes.
+class ShapeObserver {
+    public:
+        // Called after the shape registered under slot has changed
+        virtual void shapeChanged(int slot) = 0;
+
+    protected:
+        ~ShapeObserver() = default;
+};
+
 class Shape {
     public:
         // Default constructor, just to make this release version compilable.
@@ -19,6 +41,15 @@ class Shape {
         // If d is negative, throw a std::invalid_argument exception.
         Shape(int d);
 
+        // Copy constructor. Observers of other are not carried over.
+        Shape(const Shape& other);
+
+        // Copy assignment. The observers of this object are kept and told
+        // about the change.
+        Shape& operator=(const Shape& other);
+
+        virtual ~Shape() = default;
+
         // Set depth of object to d. If d is negative, return false and
         // do not update depth. Otherwise return true
         bool setDepth(int d);
@@ -50,6 +81,9 @@ class Shape {
         // Return the area of the object
         float area() const;
 
+        // Return the axis-aligned bounds of the object
+        virtual BoundingBox bounds() const;
+
         // Translate the object horizontally by x and vertically by y
         virtual void translate(float x, float y) final;
 
@@ -64,6 +98,38 @@ class Shape {
         // Depths are ignored for purpose of comparison
         virtual bool contains(const Point& p) const = 0;
 
+        // Test the n points (xs[i], ys[i]) in one pass, with the same answers
+        // as contains(). Set bit i % 64 of mask[i / 64] if the object
+        // contains point i and clear it otherwise. mask must hold at least
+        // (n + 63) / 64 words.
+        void containsMany(const float* xs, const float* ys, size_t n,
+                uint64_t* mask) const;
+
+        // As above, but append to indices the i of every contained point
+        void containsMany(const float* xs, const float* ys, size_t n,
+                vector<size_t>& indices) const;
+
+        // Return the object as a plain value of the matching kind
+        virtual ShapeValue value() const = 0;
+
+        // Return true if the object and other share a point, each being
+        // the set of points its contains() accepts. Depths are ignored.
+        bool intersects(const Shape& other) const;
+
+        // Return the distance from p to the nearest point of the object, or
+        // zero if the object contains p. Depths are ignored.
+        float distance(const Point& p) const;
+
+        // Mark the cells of fb covered by the object
+        void draw(FrameBuffer& fb) const;
+
+        // Ask to be told through o->shapeChanged(slot) whenever the object
+        // is translated, rotated or scaled
+        void attach(ShapeObserver* o, int slot);
+
+        // Stop telling o about changes made under slot
+        void detach(ShapeObserver* o, int slot);
+
         // the constant pi
         static constexpr double PI = 3.1415926;
         // The constant value for 1D & 2D
@@ -85,8 +151,21 @@ class Shape {
         float yMaxCoord_;
         float area_;
 
+        // Tell every attached observer that the object has changed
+        void notifyChanged_() const;
+
+        // Batch test behind containsMany(). Points, line segments and
+        // rectangles all contain exactly the points of their bounds.
+        virtual void containsMany_(const float* xs, const float* ys, size_t n,
+                uint64_t* mask) const;
+
     private:
         int shapeDepth_;
+        // First observer attached to this object, with its slot. Kept
+        // inline because objects are rarely in more than one scene.
+        pair<ShapeObserver*, int> observer_ { nullptr, 0 };
+        // Any further observers, with their slots
+        vector<pair<ShapeObserver*, int>> observers_;
 };
 
 class Point : public Shape {
@@ -98,6 +177,12 @@ class Point : public Shape {
         // Return true if point contains p and false otherwise.
         // Depths are ignored for purpose of comparison
         bool contains(const Point&) const override;
+
+        // Return the degenerate box holding only the point
+        BoundingBox bounds() const override;
+
+        // Return the point as a PointValue
+        ShapeValue value() const override;
 };
 
 class LineSegment : public Shape {
@@ -116,6 +201,9 @@ class LineSegment : public Shape {
         // Depths are ignored for purpose of comparison
         bool contains(const Point& p) const override;
 
+        // Return the line segment as a SegmentValue
+        ShapeValue value() const override;
+
         // Scale the object by a factor f relative to its centre.
         // If f is zero or negative, throw a std::invalid-argument exception.
         void scale(float f);
@@ -156,6 +244,9 @@ class Rectangle : public TwoDShape {
         // Depths are ignored for purpose of comparison
         bool contains(const Point& p) const override;
 
+        // Return the rectangle as a RectangleValue
+        ShapeValue value() const override;
+
         // Rotate the object 90 degrees around its centre
         void rotate();
 
@@ -175,46 +266,422 @@ class Circle : public TwoDShape {
         // Returns the radius
         float getR() const;
 
+        // Return the square enclosing the circle
+        BoundingBox bounds() const override;
+
         // Return true if circle contains p and false otherwise.
         // Depths are ignored for purpose of comparison
         bool contains(const Point& p) const override;
 
+        // Return the circle as a CircleValue
+        ShapeValue value() const override;
+
         // Scale the Circle by a factor f relative to its centre.
         // If f is zero or negative, throw a std::invalid-argument exception.
         void scale(float f) override;
 
+    protected:
+        // Batch test against the circle, on squared distances
+        void containsMany_(const float* xs, const float* ys, size_t n,
+                uint64_t* mask) const override;
+
     private:
         // Circle's Radius
         float radCircle_;
 };
 
 
-class Scene {
+// Time spent on one tile of a frame drawn from scratch
+struct TileTiming {
+    // Cells of the tile
+    CellRect tile;
+    // Worker that drew the tile, from 0
+    int thread;
+    // Number of shapes drawn into the tile
+    int shapes;
+    // Wall-clock time taken by the tile
+    double seconds;
+};
+
+class Scene : private ShapeObserver {
 
     public:
-        // Constructor
+        // Constructor for a WIDTH * HEIGHT drawing area
         Scene();
 
-        // Add the pointer to the collection of pointers stored
-        void addObject(std::shared_ptr<Shape> ptr);
-
-        // Set the drawing depth to d
+        // Constructor for a width * height drawing area.
+        // If either is zero or negative, throw a std::invalid_argument exception.
+        Scene(int width, int height);
+
+        // Constructor for the drawing area saved in file, holding each of
+        // its shapes by value in the slot it was saved from. Shapes are
+        // copied out of the file's columns and indexed, one add() per
+        // shape, without being checked or allocated one at a time; the
+        // scene does not read the mapping afterwards. To test points
+        // against the columns in place, see SceneFile::containing().
+        // If file holds a shape of unknown kind, throw a std::invalid_argument
+        // exception.
+        explicit Scene(const SceneFile& file);
+
+        // A scene registers itself with its shapes, so it is not copied
+        Scene(const Scene&) = delete;
+        Scene& operator=(const Scene&) = delete;
+
+        // Destructor. Detach from every shape still held.
+        ~Scene();
+
+        // Add the pointer to the collection of pointers stored and return
+        // its slot
+        int addObject(std::shared_ptr<Shape> ptr);
+
+        // Add a shape held by value in the scene itself and return its
+        // slot, which stays valid for the life of the scene
+        int add(const ShapeValue& v);
+
+        // Add the n shapes of shapes in order, as add() would one at a
+        // time, and return the slot of the first. A table of values
+        // written as a constant can be checked when compiling, with
+        // validShapes() of ShapeFactory.h.
+        int add(const ShapeValue* shapes, size_t n);
+
+        // As above, for the whole of the array shapes
+        template <size_t N>
+        int add(const ShapeValue (&shapes)[N]);
+
+        // Return the number of shapes in the scene
+        int size() const;
+
+        // Return the shape in slot as a value. For shapes added through a
+        // pointer, this is a copy kept up to date as the shape changes.
+        // If slot is out of range, throw a std::out_of_range exception.
+        const ShapeValue& value(int slot) const;
+
+        // Replace the shape held by value in slot with v.
+        // If slot is out of range, throw a std::out_of_range exception; if
+        // it holds a shape added through a pointer, throw a
+        // std::invalid_argument exception.
+        void setValue(int slot, const ShapeValue& v);
+
+        // Translate each shape held by value in slots horizontally by x and
+        // vertically by y, as ShapeValue::translate() does. The index and
+        // the page are brought up to date once for the whole batch, and a
+        // large batch is split across renderThreads() threads. A slot
+        // listed twice is moved twice.
+        // If a slot is out of range, throw a std::out_of_range exception; if
+        // it holds a shape added through a pointer, throw a
+        // std::invalid_argument exception. Nothing is changed then.
+        void translate(const vector<int>& slots, float x, float y);
+
+        // As translate(), scaling each shape by a factor f relative to its
+        // centre.
+        // If f is zero or negative, throw a std::invalid_argument exception.
+        void scale(const vector<int>& slots, float f);
+
+        // As translate(), rotating each shape 90 degrees around its centre
+        void rotate(const vector<int>& slots);
+
+        // As translate(), moving each shape by the whole chain t at once,
+        // without rounding anything to an integer on the way
+        void transform(const vector<int>& slots, const ShapeTransform& t);
+
+        // Composite by depth when on: each cell shows the glyph of the
+        // nearest shape covering it, the one of smallest depth and, between
+        // equal depths, the one added last, whatever order shapes are drawn
+        // in. When off, the default, covered cells show FrameBuffer::ink.
+        void setDepthCompositing(bool on);
+
+        // Return true if the scene composites by depth
+        bool depthCompositing() const;
+
+        // Show the shape in slot as glyph when compositing by depth. Every
+        // shape starts as FrameBuffer::ink.
+        // If slot is out of range, throw a std::out_of_range exception; if
+        // glyph is a newline, throw a std::invalid_argument exception.
+        void setGlyph(int slot, char glyph);
+
+        // Return the glyph of the shape in slot.
+        // If slot is out of range, throw a std::out_of_range exception.
+        char glyph(int slot) const;
+
+        // Return the slot of the shape shown in cell (x, y), the nearest one
+        // drawn over it as depth compositing would show, or -1 if the cell
+        // is empty or off the page. The first call starts keeping a pick
+        // buffer, drawn along with every later frame by the same code and
+        // updated only where the scene changed; each call brings it up to
+        // date and then looks the cell up.
+        int pick(int x, int y) const;
+
+        // Return the pick buffer, up to date, starting it if needed
+        const PickBuffer& pickBuffer() const;
+
+        // Construct a T from args in storage owned by the scene and add it.
+        // The returned pointer is a non-owning handle, valid until the
+        // scene is destroyed, when every shape made this way is released
+        // at once. No reference count is kept for such shapes.
+        template <class T, class... Args>
+        T* emplace(Args&&... args);
+
+        // Show page beneath every shape: cells that no shape drawn covers
+        // show the same cell of page instead of blank, in every frame and
+        // in renderTiled(), and render(BitCanvas&) sets the cells of page
+        // that are not blank. Shapes that never move can be drawn into page
+        // once, when compiling through StaticPage, rather than added.
+        // If page is not the size of the drawing area, throw a
+        // std::invalid_argument exception.
+        void setBackground(const FrameBuffer& page);
+
+        // Show blank beneath every shape again
+        void clearBackground();
+
+        // Set the drawing depth to d: only shapes of depth at most d are
+        // drawn, or every shape if d is 0. The cost depends only on the
+        // shapes of the layers shown or hidden by the change.
         void setDrawDepth(int d);
 
-        // Constants specifying the size of the drawing area
+        // Forget the frame kept between outputs, so that the next one is
+        // drawn from scratch
+        void invalidate();
+
+        // Return the shapes containing p, in no particular order.
+        // Depths are ignored for purpose of comparison
+        vector<Shape*> query(const Point& p) const;
+
+        // As above, but append the shapes to hits so that a caller
+        // running many queries can reuse one vector. Shapes held by value
+        // have no Shape object and are left out.
+        void query(const Point& p, vector<Shape*>& hits) const;
+
+        // Append to slots the slot of every shape containing (x, y), held
+        // by value or not, in no particular order
+        void querySlots(float x, float y, vector<int>& slots) const;
+
+        // Call visit(slot) for every shape that intersects the window
+        // xMin..xMax by yMin..yMax, edges included, as
+        // ShapeValue::intersects() decides, whatever its depth and in no
+        // particular order. Nothing is found if xMin > xMax or yMin > yMax.
+        // Shapes are found through a packed R-tree, brought up to date
+        // first if shapes have been added or moved since the last query.
+        template <class Visitor>
+        void queryRange(float xMin, float yMin, float xMax, float yMax, Visitor visit) const;
+
+        // As above, appending the slots found to slots
+        void queryRange(float xMin, float yMin, float xMax, float yMax, vector<int>& slots) const;
+
+        // Append to pairs every pair of slots whose shapes intersect, as
+        // ShapeValue::intersects() decides, whatever their depth. Each pair
+        // comes once, the smaller slot first, in no particular order.
+        // Candidates come from sweeping bounds kept sorted along x, so the
+        // cost is about n log n, or n after small moves, plus the pairs
+        // whose bounds overlap in x.
+        void overlaps(vector<pair<int, int>>& pairs) const;
+
+        // Append to slots the slots of the k shapes nearest (x, y), nearest
+        // first, as ShapeValue::distance() measures and whatever their
+        // depth, or of every shape if there are fewer. Shapes at the same
+        // distance come in no particular order. The search is best first
+        // through the packed R-tree of queryRange().
+        // If k is zero or negative, throw a std::invalid_argument exception.
+        void nearest(float x, float y, int k, vector<int>& slots) const;
+
+        // As above for the n points (xs[i], ys[i]), shared out among up to
+        // renderThreads() threads. Set slots to n rows of k, row i holding
+        // the slots nearest point i, padded with -1 if there are fewer than
+        // k shapes.
+        void nearest(const float* xs, const float* ys, size_t n, int k,
+                vector<int>& slots) const;
+
+        // Set the side of the spatial index cells to f and rebuild it.
+        // If f is zero or negative, throw a std::invalid_argument exception.
+        void setIndexCellSize(float f);
+
+        // Return the number of columns of the drawing area
+        int width() const;
+
+        // Return the number of rows of the drawing area
+        int height() const;
+
+        // Draw the scene to out exactly as operator<< does, but one band of
+        // TILE rows at a time, TILE * TILE cells per tile, so that memory
+        // use stays bounded however large the drawing area is. The frame
+        // kept by operator<< is neither used nor updated.
+        void renderTiled(std::ostream& out) const;
+
+        // Clear canvas and set the cells of every shape drawn at the
+        // drawing depth. Cells of canvas are the cells of the scene with
+        // the same co-ordinates; any outside the drawing area stay clear.
+        void render(BitCanvas& canvas) const;
+
+        // Draw frames that start from scratch with n threads, which take
+        // tiles from a shared queue. The output does not depend on n.
+        // The default, 1, draws on the calling thread.
+        // If n is zero or negative, throw a std::invalid_argument exception.
+        void setRenderThreads(int n);
+
+        // Return the number of threads frames are drawn with
+        int renderThreads() const;
+
+        // Return one entry per tile of the last frame drawn from scratch,
+        // in tile order (left to right, bottom to top)
+        const vector<TileTiming>& tileTimings() const;
+
+        // Default size of the drawing area
         static constexpr int WIDTH = 60;
         static constexpr int HEIGHT = 20;
 
+        // Side of the square tiles pages are drawn in
+        static constexpr int TILE = 64;
+
+        // Default side of the spatial index cells
+        static constexpr float INDEX_CELL = 8;
+
+        // Above this many changed regions a frame is redrawn from scratch
+        static constexpr size_t MAX_DIRTY = 64;
+
     private:
-        // Empty page of WIDTH * HEIGHT
-        string scenePage_;
+        // Re-index the shape stored under slot and mark the page under
+        // its old and new bounds for redrawing
+        void shapeChanged(int slot) override;
+
+        // Replace the value in slot with v, re-index it and mark the page
+        // under its old and new bounds for redrawing
+        void store_(int slot, const ShapeValue& v);
+
+        // Apply op to the value of every shape in slots, then re-index them
+        // and mark the page under their old and new bounds, all at once
+        template <class Op>
+        void transform_(const vector<int>& slots, Op op);
+
+        // Remember that the cells under b must be redrawn
+        void markDirty_(const BoundingBox& b);
+
+        // Bring rtree_ up to date: rebuild it if shapes have been added
+        // since, and refit it if they have only moved
+        void updateRTree_() const;
+
+        // Bring frame_ up to date, redrawing only the changed regions
+        // unless the whole page is invalid
+        void render_() const;
+
+        // Move slot from the layer of depth from to the layer of depth to
+        void moveLayer_(int slot, int from, int to);
+
+        // Return true if the shape in slot is drawn at the drawing depth
+        bool visible_(int slot) const;
+
+        // Scratch space of one thread drawing tiles
+        struct TileScratch {
+            // Index lookups
+            vector<int> slots;
+            // Depth buffer of one TILE * TILE chunk, allocated on first use
+            unique_ptr<DepthBuffer> depth;
+        };
+
+        // Clear the cells of fb in tile and draw every visible shape that
+        // overlaps them, and update their ids in pick unless it is null.
+        // Return the number of shapes drawn.
+        int drawTile_(FrameBuffer& fb, const CellRect& tile, TileScratch& scratch,
+                PickBuffer* pick) const;
+
+        // As drawTile_(), through a depth buffer
+        int compositeTile_(FrameBuffer& fb, const CellRect& tile, TileScratch& scratch,
+                PickBuffer* pick) const;
+
+        // Draw every visible shape overlapping cells on target, which is
+        // already clipped to them. Return the number of shapes drawn.
+        template <class Target>
+        int drawShapes_(Target& target, const CellRect& cells, vector<int>& slots) const;
+
+        // Draw the whole of frame_ from scratch, tile by tile
+        void drawAll_() const;
+
+        // Size of the drawing area
+        int width_;
+        int height_;
         // Depth of the drawing
         int sceneDepth_;
-        // Collection of Shape pointers
+        // Page the shapes are rasterized into, reused from frame to frame.
+        // Allocated by the first frame.
+        mutable unique_ptr<FrameBuffer> frame_;
+        // Storage of the shapes made by emplace()
+        ShapeArena arena_;
+        // Collection of Shape pointers, null for shapes held by value
         vector<std::shared_ptr<Shape>> shapePtr_;
+        // Every shape as a value, indexed like shapePtr_. Drawing and
+        // queries work on these, so they never call virtual functions.
+        vector<ShapeValue> values_;
+        // Glyph of every shape when compositing by depth
+        vector<char> glyphs_;
+        // Slots of the shapes of each depth, shallowest layer first
+        map<int, vector<int>> layers_;
+        // Position of every slot within its layer
+        vector<int> layerPos_;
+        // Bounds of every shape, bucketed by position. Ids are indices
+        // into shapePtr_
+        UniformGrid index_;
+        // Bounds of every shape again, sorted along x for overlaps()
+        mutable SweepAndPrune sweep_;
+        // Bounds of every shape packed for queryRange(), whether any shape
+        // has moved since it was built, and the bounds it is built from
+        mutable PackedRTree rtree_;
+        mutable bool rtreeMoved_;
+        mutable vector<BoundingBox> rtreeBounds_;
+        // Scratch space of nearest(), kept to avoid reallocating each query
+        mutable vector<PackedRTree::Neighbour> nearFound_;
+        mutable vector<PackedRTree::Candidate> nearQueue_;
+        // Regions changed since frame_ was last drawn, clipped to the page
+        mutable vector<BoundingBox> dirty_;
+        // Whether frame_ has to be drawn again from scratch
+        mutable bool redrawAll_;
+        // Scratch space of render_(), kept to avoid reallocating each frame
+        mutable TileScratch scratch_;
+        // New bounds of the shapes of a batch transform, kept to avoid
+        // reallocating each batch
+        vector<BoundingBox> batchBounds_;
+        // Threads used for full redraws and large batch transforms
+        int renderThreads_;
+        // Per tile timings of the last full redraw
+        mutable vector<TileTiming> tileTimings_;
+        // Whether cells are composited by depth
+        bool depthCompositing_;
+        // Slot shown in every cell of frame_, kept once pick() is first used
+        mutable unique_ptr<PickBuffer> pick_;
+        // Cells shown beneath the shapes, or null for blank, with its
+        // bottom-left cell at (0, 0), and the cells of it that are not
+        // blank, for render(BitCanvas&)
+        unique_ptr<FrameBuffer> background_;
+        unique_ptr<BitCanvas> backgroundBits_;
 
         // Draw objects as specified in the assignment page
         friend std::ostream& operator<<(std::ostream& out, const Scene& s);
 };
 
+template <class T, class... Args>
+T* Scene::emplace(Args&&... args) {
+    T* shape = arena_.make<T>(std::forward<Args>(args)...);
+    /* Aliasing an empty shared_ptr: no control block, so nothing is counted */
+    addObject(shared_ptr<Shape>(shared_ptr<Shape>(), shape));
+    return shape;
+}
+
+template <size_t N>
+int Scene::add(const ShapeValue (&shapes)[N]) {
+    return add(shapes, N);
+}
+
+template <class Visitor>
+void Scene::queryRange(float xMin, float yMin, float xMax, float yMax, Visitor visit) const {
+    if (xMin > xMax || yMin > yMax) {
+        return;
+    }
+    updateRTree_();
+    /* The tree narrows the search to overlapping bounds, the values decide */
+    ShapeValue window(RectangleValue { xMin, yMin, xMax, yMax });
+    rtree_.visit(BoundingBox { xMin, yMin, xMax, yMax }, [&](int slot) {
+        if (values_[slot].intersects(window)) {
+            visit(slot);
+        }
+    });
+    return;
+}
+
 #endif /* GEOMETRY_H_ */